@@ -0,0 +1,186 @@
+package penguin.opencore.tester;
+
+import android.content.Context;
+import android.os.Bundle;
+import android.util.Log;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import androidx.test.platform.app.InstrumentationRegistry;
+
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+import java.util.Random;
+import java.util.concurrent.CountDownLatch;
+
+import penguin.opencore.sdk.Coredump;
+
+import static org.junit.Assert.*;
+
+/**
+ * Dump benchmark on the device, the instrumentation twin of opencore-bench.
+ * Each scenario loads this process with parked threads, anonymous vmas
+ * (zero and paged out shares) and a mapped file, dumps it repeat times and
+ * reports Coredump.getLastDumpStats() of every run as json.
+ *
+ *   adb shell am instrument -w -e class penguin.opencore.tester.DumpBenchmark \
+ *       -e repeat 3 penguin.opencore.tester.test/androidx.test.runner.AndroidJUnitRunner
+ *
+ * The json goes to logcat, the instrumentation status and
+ * files/opencore-bench.json of the app.
+ */
+@RunWith(AndroidJUnit4.class)
+public class DumpBenchmark {
+    private static final String TAG = "OpencoreBench";
+    private static final long MB = 1 << 20;
+
+    static {
+        System.loadLibrary("native-lib");
+    }
+
+    private static class Scenario {
+        final String name;
+        final int threads;
+        final int vmas;
+        final long rss;
+        final float zero;
+        final float swap;
+        final long file;
+
+        Scenario(String name, int threads, int vmas, long rss, float zero, float swap, long file) {
+            this.name = name;
+            this.threads = threads;
+            this.vmas = vmas;
+            this.rss = rss;
+            this.zero = zero;
+            this.swap = swap;
+            this.file = file;
+        }
+    }
+
+    // smaller than the host set, apps live with tighter memory
+    private static final Scenario[] SCENARIOS = {
+        new Scenario("baseline", 1, 16, 32 * MB, 0f, 0f, 0),
+        new Scenario("threads", 64, 16, 32 * MB, 0f, 0f, 0),
+        new Scenario("vmas", 1, 2048, 32 * MB, 0f, 0f, 0),
+        new Scenario("large", 8, 64, 256 * MB, 0f, 0f, 0),
+        new Scenario("zero", 1, 16, 128 * MB, 0.75f, 0f, 0),
+        new Scenario("swap", 1, 16, 128 * MB, 0f, 0.5f, 0),
+        new Scenario("file", 1, 16, 32 * MB, 0f, 0f, 128 * MB),
+    };
+
+    @Test
+    public void benchmark() throws Exception {
+        Context context = InstrumentationRegistry.getInstrumentation().getTargetContext();
+        Bundle args = InstrumentationRegistry.getArguments();
+        int repeat = Integer.parseInt(args.getString("repeat", "3"));
+
+        Coredump coredump = Coredump.getInstance();
+        assertTrue(coredump.init());
+        File dir = context.getCacheDir();
+        String savedDir = coredump.getCoreDir();
+        coredump.setCoreDir(dir.getAbsolutePath());
+
+        StringBuilder json = new StringBuilder();
+        json.append("{\"version\":\"").append(coredump.getVersion())
+            .append("\",\"repeat\":").append(repeat).append(",\"scenarios\":[");
+        try {
+            for (int s = 0; s < SCENARIOS.length; s++) {
+                if (s > 0)
+                    json.append(',');
+                runScenario(coredump, dir, SCENARIOS[s], repeat, json);
+            }
+        } finally {
+            coredump.setCoreDir(savedDir);
+        }
+        json.append("]}");
+
+        String result = json.toString();
+        Log.i(TAG, result);
+        FileOutputStream out = new FileOutputStream(new File(context.getFilesDir(), "opencore-bench.json"));
+        try {
+            out.write(result.getBytes());
+        } finally {
+            out.close();
+        }
+        Bundle status = new Bundle();
+        status.putString("opencore-bench", result);
+        InstrumentationRegistry.getInstrumentation().sendStatus(0, status);
+    }
+
+    private void runScenario(Coredump coredump, File dir, Scenario scenario, int repeat,
+                             StringBuilder json) throws IOException, InterruptedException {
+        final CountDownLatch release = new CountDownLatch(1);
+        Runnable park = new Runnable() {
+            @Override
+            public void run() {
+                try {
+                    release.await();
+                } catch (InterruptedException e) {
+                    // leaving anyway
+                }
+            }
+        };
+        Thread[] threads = new Thread[scenario.threads - 1];
+        for (int i = 0; i < threads.length; i++) {
+            threads[i] = new Thread(park, "bench-" + i);
+            threads[i].start();
+        }
+
+        File data = new File(dir, "bench." + scenario.name + ".data");
+        RandomAccessFile file = null;
+        try {
+            nativeMapAnon(scenario.vmas, scenario.rss, scenario.zero, scenario.swap);
+            if (scenario.file > 0) {
+                file = new RandomAccessFile(data, "rw");
+                // written like opencore-bench, incompressible pages rather than a sparse file
+                byte[] chunk = new byte[(int) MB];
+                Random random = new Random(1);
+                for (long off = 0; off < scenario.file; off += chunk.length) {
+                    random.nextBytes(chunk);
+                    file.write(chunk, 0, (int) Math.min(chunk.length, scenario.file - off));
+                }
+                MappedByteBuffer map = file.getChannel().map(FileChannel.MapMode.READ_ONLY, 0, scenario.file);
+                map.load();
+            }
+
+            json.append("{\"name\":\"").append(scenario.name)
+                .append("\",\"threads\":").append(scenario.threads)
+                .append(",\"vmas\":").append(scenario.vmas)
+                .append(",\"rss\":").append(scenario.rss)
+                .append(",\"zero\":").append(scenario.zero)
+                .append(",\"swap\":").append(scenario.swap)
+                .append(",\"file\":").append(scenario.file)
+                .append(",\"filter\":").append(coredump.getCoreFilter())
+                .append(",\"runs\":[");
+            String core = "bench." + scenario.name + ".core";
+            for (int r = 0; r < repeat; r++) {
+                assertTrue(coredump.doCoredump(core));
+                String stats = coredump.getLastDumpStats();
+                assertNotNull(stats);
+                if (r > 0)
+                    json.append(',');
+                json.append(stats);
+                new File(dir, core).delete();
+            }
+            json.append("]}");
+        } finally {
+            release.countDown();
+            for (Thread thread : threads)
+                thread.join();
+            nativeUnmapAll();
+            if (file != null)
+                file.close();
+            data.delete();
+        }
+    }
+
+    private static native long nativeMapAnon(int vmas, long rss, float zero, float swap);
+    private static native void nativeUnmapAll();
+}
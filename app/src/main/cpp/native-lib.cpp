@@ -17,6 +17,10 @@
 #include <jni.h>
 #include <string>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <vector>
 
 extern "C"
 JNIEXPORT void JNICALL
@@ -30,3 +34,74 @@ JNIEXPORT void JNICALL
 Java_penguin_opencore_tester_MainActivity_nativeAbortJNI(JNIEnv *env, jobject thiz) {
     abort();
 }
+
+/*
+ * Synthetic memory for the DumpBenchmark instrumentation test, the same
+ * layout opencore-bench builds in its host targets.
+ */
+
+// linux/mman.h of older sysroots lacks it
+static constexpr int kMadvPageout = 21;
+
+struct BenchRegion {
+    void* base;
+    size_t size;
+};
+
+static std::vector<BenchRegion> gBenchRegions;
+
+// incompressible and never a duplicate page, so dedup and gzip can't cheat
+static void FillPage(uint8_t* page, size_t size, uint64_t seed) {
+    uint64_t x = seed * 0x9e3779b97f4a7c15ULL + 1;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        memcpy(page + i, &x, 8);
+    }
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_penguin_opencore_tester_DumpBenchmark_nativeMapAnon(JNIEnv *env, jclass clazz,
+        jint vmas, jlong rss, jfloat zero, jfloat swap) {
+    size_t page = sysconf(_SC_PAGE_SIZE);
+    size_t per_vma = rss / vmas / page * page;
+    if (per_vma < page)
+        per_vma = page;
+
+    jlong mapped = 0;
+    uint64_t seed = 1;
+    for (int i = 0; i < vmas; ++i) {
+        // one guard page behind each, neighbours never merge into one vma
+        uint8_t* base = (uint8_t *)mmap(nullptr, per_vma + page, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            break;
+        mprotect(base + per_vma, page, PROT_NONE);
+        gBenchRegions.push_back({ base, per_vma + page });
+
+        size_t pages = per_vma / page;
+        size_t zeros = pages * zero;
+        for (size_t k = 0; k < pages; ++k) {
+            if (k < zeros)
+                base[k * page] = 0;
+            else
+                FillPage(base + k * page, page, seed++);
+        }
+
+        size_t swapped = (size_t)(pages * swap) * page;
+        if (swapped)
+            madvise(base + per_vma - swapped, swapped, kMadvPageout);
+        mapped += per_vma;
+    }
+    return mapped;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_penguin_opencore_tester_DumpBenchmark_nativeUnmapAll(JNIEnv *env, jclass clazz) {
+    for (BenchRegion& region : gBenchRegions)
+        munmap(region.base, region.size);
+    gBenchRegions.clear();
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <eajnis/Log.h>
+
+#ifndef __ANDROID__
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+
+static int g_backend = JNI_LOG_STDERR;
+static int g_priority = ANDROID_LOG_INFO;
+
+void jni_log_set_backend(int backend) {
+    __atomic_store_n(&g_backend, backend, __ATOMIC_RELEASE);
+}
+
+void jni_log_set_priority(int prio) {
+    __atomic_store_n(&g_priority, prio, __ATOMIC_RELEASE);
+}
+
+static int SyslogPriority(int prio) {
+    switch (prio) {
+        case ANDROID_LOG_VERBOSE:
+        case ANDROID_LOG_DEBUG:
+            return LOG_DEBUG;
+        case ANDROID_LOG_INFO:
+            return LOG_INFO;
+        case ANDROID_LOG_WARN:
+            return LOG_WARNING;
+        case ANDROID_LOG_ERROR:
+            return LOG_ERR;
+        default:
+            return LOG_CRIT;
+    }
+}
+
+int jni_log_print(int prio, const char* tag, const char* fmt, ...) {
+    if (prio < __atomic_load_n(&g_priority, __ATOMIC_ACQUIRE))
+        return 0;
+
+    // also called from the dumper child and the crash path, so one
+    // stack buffer and a single write, no stdio locks
+    static const char kLevels[] = "??VDIWEF";
+    char line[1024];
+    int saved = errno;
+    int len = snprintf(line, sizeof(line), "%c/%s(%d): ",
+                       kLevels[prio & 7], tag, getpid());
+    int head = len;
+    va_list ap;
+    va_start(ap, fmt);
+    len += vsnprintf(line + len, sizeof(line) - len, fmt, ap);
+    va_end(ap);
+    if (len > (int)sizeof(line) - 2)
+        len = sizeof(line) - 2;
+
+    if (__atomic_load_n(&g_backend, __ATOMIC_ACQUIRE) == JNI_LOG_SYSLOG) {
+        syslog(SyslogPriority(prio), "%s: %s", tag, line + head);
+    } else {
+        line[len++] = '\n';
+        write(STDERR_FILENO, line, len);
+    }
+    errno = saved;
+    return len;
+}
+#endif //__ANDROID__
@@ -17,7 +17,9 @@
 #ifndef EAJNI_LOG_H
 #define EAJNI_LOG_H
 
+#ifdef __ANDROID__
 #include <android/log.h>
+#endif
 
 #ifndef LOG_TAG
 #define LOG_TAG "JNI"
@@ -27,12 +29,38 @@
 extern "C" {
 #endif //__cplusplus
 
-#define JNI_LOGV(...) __android_log_print(ANDROID_LOG_VERBOSE, LOG_TAG, __VA_ARGS__)
-#define JNI_LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-#define JNI_LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
-#define JNI_LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define JNI_LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define JNI_LOGF(...) __android_log_print(ANDROID_LOG_FATAL, LOG_TAG, __VA_ARGS__)
+#ifdef __ANDROID__
+#define JNI_LOG_PRINT __android_log_print
+#else
+/*
+ * Host builds, same priorities as android/log.h. Lines go to stderr by
+ * default, or to syslog once a daemon picks that backend.
+ */
+enum {
+    ANDROID_LOG_VERBOSE = 2,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+};
+
+#define JNI_LOG_STDERR 0
+#define JNI_LOG_SYSLOG 1
+
+void jni_log_set_backend(int backend);
+void jni_log_set_priority(int prio);
+int jni_log_print(int prio, const char* tag, const char* fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+#define JNI_LOG_PRINT jni_log_print
+#endif //__ANDROID__
+
+#define JNI_LOGV(...) JNI_LOG_PRINT(ANDROID_LOG_VERBOSE, LOG_TAG, __VA_ARGS__)
+#define JNI_LOGD(...) JNI_LOG_PRINT(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define JNI_LOGW(...) JNI_LOG_PRINT(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define JNI_LOGI(...) JNI_LOG_PRINT(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define JNI_LOGE(...) JNI_LOG_PRINT(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define JNI_LOGF(...) JNI_LOG_PRINT(ANDROID_LOG_FATAL, LOG_TAG, __VA_ARGS__)
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/arena.h"
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static Arena crash_arena;
+
+Arena& Arena::Crash() {
+    return crash_arena;
+}
+
+bool Arena::Reserve(uint64_t bytes) {
+    if (base)
+        return true;
+
+    uint64_t page = sysconf(_SC_PAGE_SIZE);
+    bytes = (bytes + page - 1) & ~(page - 1);
+    // untouched pages cost nothing until a crash actually uses them
+    uint8_t* map = (uint8_t *)mmap(NULL, bytes + 2 * page, PROT_NONE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) {
+        JNI_LOGE("reserve arena %" PRIu64 ": %s", bytes, strerror(errno));
+        return false;
+    }
+
+    if (mprotect(map + page, bytes, PROT_READ | PROT_WRITE) < 0) {
+        JNI_LOGE("mprotect arena: %s", strerror(errno));
+        munmap(map, bytes + 2 * page);
+        return false;
+    }
+
+    base = map + page;
+    size = bytes;
+    used = 0;
+    return true;
+}
+
+void Arena::Release() {
+    if (!base)
+        return;
+
+    uint64_t page = sysconf(_SC_PAGE_SIZE);
+    munmap(base - page, size + 2 * page);
+    base = nullptr;
+    size = 0;
+    used = 0;
+    active = false;
+}
+
+void Arena::Activate(bool on) {
+    owner = pthread_self();
+    active = on;
+}
+
+void* Arena::Allocate(uint64_t bytes) {
+    uint64_t need = (bytes + 15) & ~15ULL;
+    uint64_t offset = __atomic_fetch_add(&used, need, __ATOMIC_RELAXED);
+    if (offset + need > size) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            JNI_LOGW("arena exhausted at %" PRIu64 " bytes, heap fallback.", size);
+        }
+        return nullptr;
+    }
+    return base + offset;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_ARENA_H_
+#define OPENCORE_ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+ * Crash path arena. Opencore::Enable() reserves it up front between two
+ * PROT_NONE guard pages and the signal handler switches it on, so every
+ * per-dump container bump-allocates from it instead of a heap that may be
+ * the very thing that broke. Frees of arena memory are dropped, the dumper
+ * is a short lived child. Running out falls back to the heap.
+ *
+ * Only the thread that activated it allocates from it (and the dumper it
+ * forks, which keeps that pthread_t); on demand dumps running on other
+ * threads at the same time stay on the heap and never eat into it.
+ */
+class Arena {
+public:
+    constexpr Arena() : base(nullptr), size(0), used(0), active(false), owner() {}
+
+    bool Reserve(uint64_t bytes);
+    void Release();
+    void Activate(bool on);
+    bool IsActive() { return active && base && pthread_equal(owner, pthread_self()); }
+    bool Contains(const void* p) { return (uintptr_t)p - (uintptr_t)base < size; }
+    void* Allocate(uint64_t bytes);
+    uint64_t getUsed() { return used; }
+    uint64_t getSize() { return size; }
+
+    static Arena& Crash();
+private:
+    uint8_t* base;
+    uint64_t size;
+    uint64_t used;
+    bool active;
+    pthread_t owner;
+};
+
+template <class T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator() noexcept {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        Arena& arena = Arena::Crash();
+        if (arena.IsActive()) {
+            void* p = arena.Allocate(n * sizeof(T));
+            if (p) return static_cast<T*>(p);
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        if (!Arena::Crash().Contains(p))
+            ::operator delete(p);
+    }
+
+    template <class U> bool operator==(const ArenaAllocator<U>&) const noexcept { return true; }
+    template <class U> bool operator!=(const ArenaAllocator<U>&) const noexcept { return false; }
+};
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+#endif // OPENCORE_ARENA_H_
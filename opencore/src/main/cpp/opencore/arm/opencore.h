@@ -17,7 +17,7 @@
 #ifndef OPENCORE_ARM_OPENCORE_IMPL_H_
 #define OPENCORE_ARM_OPENCORE_IMPL_H_
 
-#include "opencore/lp32/opencore.h"
+#include "opencore/elfcore.h"
 
 namespace arm {
 
@@ -50,18 +50,21 @@ typedef struct elf32_prstatus {
     uint32_t             __padding2;
 } __attribute__((packed, aligned(1))) Elf32_prstatus;
 
-class Opencore : public lp32::OpencoreImpl {
-public:
-    Opencore() : lp32::OpencoreImpl() {}
-    void Finish();
-    void CreateCorePrStatus(int pid);
-    void WriteCorePrStatus(FILE* fp);
-    int IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma);
-    int getMachine() { return EM_ARM; }
-private:
-    std::vector<Elf32_prstatus> prstatus;
+struct Arch {
+    typedef arm::pt_regs Regs;
+    typedef Elf32_prstatus Prstatus;
+    static constexpr int MACHINE = EM_ARM;
+    static void ContextRegs(void* ucontext, Regs* regs);
+    static int ListRegs(Prstatus& prstatus, uint64_t* out);
+    static uint64_t ProgramCounter(Prstatus& prstatus) { return prstatus.pr_reg.pc; }
+    static uint64_t StackPointer(Prstatus& prstatus) { return prstatus.pr_reg.sp; }
+    static void BuildThreadNotes(NoteBuilder& notes, int tid) {}
 };
 
+typedef ElfCoreWriter<Elf32Class, Arch> Opencore;
+
 } // namespace arm
 
+extern template class ElfCoreWriter<Elf32Class, arm::Arch>;
+
 #endif // OPENCORE_ARM_OPENCORE_IMPL_H_
@@ -20,6 +20,7 @@
 
 #include "eajnis/Log.h"
 #include "opencore/arm64/opencore.h"
+#include "opencore/elfcore-inl.h"
 #include <sys/ptrace.h>
 #include <sys/uio.h>
 #include <errno.h>
@@ -47,136 +48,15 @@ struct user_pac_mask {
     uint64_t insn_mask;
 };
 
-void Opencore::CreateCorePrStatus(int pid) {
-    if (!threads.size()) return;
-
-    prstatus.assign(threads.size(), {});
-    int prnum = (int)prstatus.size();
-
-    int cur = 1;
-    for (int index = 0; index < prnum; index++) {
-        pid_t tid = threads[index].pid;
-        int idx;
-        if (tid == getTid()) {
-            idx = 0;
-            prstatus[idx].pr_pid = tid;
-            // top thread maybe use ucontext prs
-            if (getContext()) {
-                struct ucontext *context = (struct ucontext *) getContext();
-                memcpy(&prstatus[idx].pr_reg, &context->uc_mcontext.regs, sizeof(arm64::pt_regs));
-                continue;
-            }
-        } else {
-            // 0 top thread was truncated
-            idx = (cur >= prnum) ? 0 : cur;
-            ++cur;
-            prstatus[idx].pr_pid = tid;
-        }
-
-        struct iovec ioVec = {
-            &prstatus[idx].pr_reg,
-            sizeof(arm64::pt_regs),
-        };
-
-        if (ptrace(PTRACE_GETREGSET, tid, NT_PRSTATUS, &ioVec) < 0)
-            continue;
-    }
-
-    extra_note_filesz += (sizeof(Elf64_prstatus) + sizeof(Elf64_Nhdr) + 8) * prnum; // NT_PRSTATUS
-    extra_note_filesz += sizeof(siginfo_t) + sizeof(Elf64_Nhdr) + 8;      // NT_SIGINFO
-    extra_note_filesz += (sizeof(Elf64_fpregset) + sizeof(Elf64_Nhdr) + 8) * prnum; // NT_FPREGSET
-    extra_note_filesz += (sizeof(Elf64_tls) + sizeof(Elf64_Nhdr) + 8) * prnum; // NT_ARM_TLS
-    extra_note_filesz += ((sizeof(struct user_pac_mask) + sizeof(Elf64_Nhdr) + 8)  // NT_ARM_PAC_MASK
-                      + (sizeof(uint64_t) + sizeof(Elf64_Nhdr) + 8)       // NT_ARM_PAC_ENABLED_KEYS
-                      ) * prnum;
-    extra_note_filesz += (sizeof(uint64_t) + sizeof(Elf64_Nhdr) + 8) * prnum;  // NT_ARM_TAGGED_ADDR_CTRL
+void Arch::BuildThreadNotes(NoteBuilder& notes, int tid) {
+    BuildCoreFpRegs(notes, tid);
+    BuildCoreTLS(notes, tid);
+    BuildCorePAC(notes, tid);
+    BuildCoreMTE(notes, tid);
 }
 
-void Opencore::WriteCorePrStatus(FILE* fp) {
-    Elf64_Nhdr elf_nhdr;
-    elf_nhdr.n_namesz = NOTE_CORE_NAME_SZ;
-    elf_nhdr.n_descsz = sizeof(Elf64_prstatus);
-    elf_nhdr.n_type = NT_PRSTATUS;
-
-    char magic[8];
-    memset(magic, 0, sizeof(magic));
-    snprintf(magic, NOTE_CORE_NAME_SZ, ELFCOREMAGIC);
-
-    int prnum = (int)prstatus.size();
-    for (int index = 0; index < prnum; index++) {
-        fwrite(&elf_nhdr, sizeof(Elf64_Nhdr), 1, fp);
-        fwrite(magic, sizeof(magic), 1, fp);
-        fwrite(&prstatus[index], sizeof(Elf64_prstatus), 1, fp);
-        if (!index) WriteCoreSignalInfo(fp);
-        WriteCoreFpRegs(prstatus[index].pr_pid ,fp);
-        WriteCoreTLS(prstatus[index].pr_pid, fp);
-        WriteCorePAC(prstatus[index].pr_pid ,fp);
-        WriteCoreMTE(prstatus[index].pr_pid ,fp);
-    }
-}
-
-int Opencore::IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma) {
-    int filter = getFilter();
-    if (filter & FILTER_MINIDUMP) {
-        if (prstatus.empty())
-            return VMA_NULL;
-
-        arm64::pt_regs *regs = &prstatus[0].pr_reg;
-        if (regs->pc >= vma.begin && regs->pc < vma.end
-                || regs->regs[0] >= vma.begin && regs->regs[0] < vma.end
-                || regs->regs[1] >= vma.begin && regs->regs[1] < vma.end
-                || regs->regs[2] >= vma.begin && regs->regs[2] < vma.end
-                || regs->regs[3] >= vma.begin && regs->regs[3] < vma.end
-                || regs->regs[4] >= vma.begin && regs->regs[4] < vma.end
-                || regs->regs[5] >= vma.begin && regs->regs[5] < vma.end
-                || regs->regs[6] >= vma.begin && regs->regs[6] < vma.end
-                || regs->regs[7] >= vma.begin && regs->regs[7] < vma.end
-                || regs->regs[8] >= vma.begin && regs->regs[8] < vma.end
-                || regs->regs[9] >= vma.begin && regs->regs[9] < vma.end
-                || regs->regs[10] >= vma.begin && regs->regs[10] < vma.end
-                || regs->regs[11] >= vma.begin && regs->regs[11] < vma.end
-                || regs->regs[12] >= vma.begin && regs->regs[12] < vma.end
-                || regs->regs[13] >= vma.begin && regs->regs[13] < vma.end
-                || regs->regs[14] >= vma.begin && regs->regs[14] < vma.end
-                || regs->regs[15] >= vma.begin && regs->regs[15] < vma.end
-                || regs->regs[16] >= vma.begin && regs->regs[16] < vma.end
-                || regs->regs[17] >= vma.begin && regs->regs[17] < vma.end
-                || regs->regs[18] >= vma.begin && regs->regs[18] < vma.end
-                || regs->regs[19] >= vma.begin && regs->regs[19] < vma.end
-                || regs->regs[20] >= vma.begin && regs->regs[20] < vma.end
-                || regs->regs[21] >= vma.begin && regs->regs[21] < vma.end
-                || regs->regs[22] >= vma.begin && regs->regs[22] < vma.end
-                || regs->regs[23] >= vma.begin && regs->regs[23] < vma.end
-                || regs->regs[24] >= vma.begin && regs->regs[24] < vma.end
-                || regs->regs[25] >= vma.begin && regs->regs[25] < vma.end
-                || regs->regs[26] >= vma.begin && regs->regs[26] < vma.end
-                || regs->regs[27] >= vma.begin && regs->regs[27] < vma.end
-                || regs->regs[28] >= vma.begin && regs->regs[28] < vma.end
-                || regs->regs[29] >= vma.begin && regs->regs[29] < vma.end
-                || regs->regs[30] >= vma.begin && regs->regs[30] < vma.end
-                || regs->sp >= vma.begin && regs->sp < vma.end) {
-            return VMA_INCLUDE;
-        }
-
-        return VMA_NULL;
-    }
-    return VMA_NORMAL;
-}
-
-void Opencore::WriteCoreFpRegs(int tid, FILE* fp) {
+void Arch::BuildCoreFpRegs(NoteBuilder& notes, int tid) {
     // NT_FPREGSET
-    Elf64_Nhdr elf_nhdr;
-    elf_nhdr.n_namesz = NOTE_CORE_NAME_SZ;
-    elf_nhdr.n_descsz = sizeof(Elf64_fpregset);
-    elf_nhdr.n_type = NT_FPREGSET;
-
-    char magic[8];
-    memset(magic, 0, sizeof(magic));
-    snprintf(magic, NOTE_CORE_NAME_SZ, ELFCOREMAGIC);
-
-    fwrite(&elf_nhdr, sizeof(Elf64_Nhdr), 1, fp);
-    fwrite(magic, sizeof(magic), 1, fp);
-
     Elf64_fpregset fpregset;
     memset(&fpregset, 0x0, sizeof(fpregset));
     struct iovec fpregset_iov = {
@@ -189,23 +69,11 @@ void Opencore::WriteCoreFpRegs(int tid, FILE* fp) {
         memset(&fpregset, 0x0, sizeof(fpregset));
     }
 
-    fwrite(&fpregset, sizeof(Elf64_fpregset), 1, fp);
+    notes.Append(ELFCOREMAGIC, NT_FPREGSET, &fpregset, sizeof(Elf64_fpregset));
 }
 
-void Opencore::WriteCoreTLS(int tid, FILE* fp) {
+void Arch::BuildCoreTLS(NoteBuilder& notes, int tid) {
     // NT_ARM_TLS
-    Elf64_Nhdr elf_nhdr;
-    elf_nhdr.n_namesz = NOTE_LINUX_NAME_SZ;
-    elf_nhdr.n_descsz = sizeof(user_pac_mask);
-    elf_nhdr.n_type = NT_ARM_TLS;
-
-    char magic[8];
-    memset(magic, 0, sizeof(magic));
-    snprintf(magic, NOTE_LINUX_NAME_SZ, ELFLINUXMAGIC);
-
-    fwrite(&elf_nhdr, sizeof(Elf64_Nhdr), 1, fp);
-    fwrite(magic, sizeof(magic), 1, fp);
-
     Elf64_tls tls;
     struct iovec tls_iov = {
         &tls.regs,
@@ -215,23 +83,11 @@ void Opencore::WriteCoreTLS(int tid, FILE* fp) {
                 reinterpret_cast<void*>(&tls_iov)) == -1) {
         memset(&tls.regs, 0x0, sizeof(tls.regs));
     }
-    fwrite(&tls, sizeof(tls), 1, fp);
+    notes.Append(ELFLINUXMAGIC, NT_ARM_TLS, &tls, sizeof(tls));
 }
 
-void Opencore::WriteCorePAC(int tid, FILE* fp) {
+void Arch::BuildCorePAC(NoteBuilder& notes, int tid) {
     // NT_ARM_PAC_MASK
-    Elf64_Nhdr elf_nhdr;
-    elf_nhdr.n_namesz = NOTE_LINUX_NAME_SZ;
-    elf_nhdr.n_descsz = sizeof(user_pac_mask);
-    elf_nhdr.n_type = NT_ARM_PAC_MASK;
-
-    char magic[8];
-    memset(magic, 0, sizeof(magic));
-    snprintf(magic, NOTE_LINUX_NAME_SZ, ELFLINUXMAGIC);
-
-    fwrite(&elf_nhdr, sizeof(Elf64_Nhdr), 1, fp);
-    fwrite(magic, sizeof(magic), 1, fp);
-
     user_pac_mask uregs;
     struct iovec pac_mask_iov = {
         &uregs,
@@ -243,15 +99,9 @@ void Opencore::WriteCorePAC(int tid, FILE* fp) {
         uregs.data_mask = mask;
         uregs.insn_mask = mask;
     }
-    fwrite(&uregs, sizeof(user_pac_mask), 1, fp);
+    notes.Append(ELFLINUXMAGIC, NT_ARM_PAC_MASK, &uregs, sizeof(user_pac_mask));
 
     // NT_ARM_PAC_ENABLED_KEYS
-    elf_nhdr.n_descsz = sizeof(uint64_t);
-    elf_nhdr.n_type = NT_ARM_PAC_ENABLED_KEYS;
-
-    fwrite(&elf_nhdr, sizeof(Elf64_Nhdr), 1, fp);
-    fwrite(magic, sizeof(magic), 1, fp);
-
     uint64_t pac_enabled_keys;
     struct iovec pac_enabled_keys_iov = {
         &pac_enabled_keys,
@@ -261,23 +111,11 @@ void Opencore::WriteCorePAC(int tid, FILE* fp) {
                 reinterpret_cast<void*>(&pac_enabled_keys_iov)) == -1) {
         pac_enabled_keys = -1;
     }
-    fwrite(&pac_enabled_keys, sizeof(uint64_t), 1, fp);
+    notes.Append(ELFLINUXMAGIC, NT_ARM_PAC_ENABLED_KEYS, &pac_enabled_keys, sizeof(uint64_t));
 }
 
-void Opencore::WriteCoreMTE(int tid, FILE* fp) {
+void Arch::BuildCoreMTE(NoteBuilder& notes, int tid) {
     // NT_ARM_TAGGED_ADDR_CTRL
-    Elf64_Nhdr elf_nhdr;
-    elf_nhdr.n_namesz = NOTE_LINUX_NAME_SZ;
-    elf_nhdr.n_descsz = sizeof(uint64_t);
-    elf_nhdr.n_type = NT_ARM_TAGGED_ADDR_CTRL;
-
-    char magic[8];
-    memset(magic, 0, sizeof(magic));
-    snprintf(magic, NOTE_LINUX_NAME_SZ, ELFLINUXMAGIC);
-
-    fwrite(&elf_nhdr, sizeof(Elf64_Nhdr), 1, fp);
-    fwrite(magic, sizeof(magic), 1, fp);
-
     uint64_t tagged_addr_ctrl;
     struct iovec tagged_addr_ctrl_iov = {
         &tagged_addr_ctrl,
@@ -287,12 +125,23 @@ void Opencore::WriteCoreMTE(int tid, FILE* fp) {
                 reinterpret_cast<void*>(&tagged_addr_ctrl_iov)) == -1) {
         tagged_addr_ctrl = -1;
     }
-    fwrite(&tagged_addr_ctrl, sizeof(uint64_t), 1, fp);
+    notes.Append(ELFLINUXMAGIC, NT_ARM_TAGGED_ADDR_CTRL, &tagged_addr_ctrl, sizeof(uint64_t));
+}
+
+void Arch::ContextRegs(void* ucontext, Regs* regs) {
+    ucontext_t *context = (ucontext_t *) ucontext;
+    memcpy(regs, &context->uc_mcontext.regs, sizeof(arm64::pt_regs));
 }
 
-void Opencore::Finish() {
-    prstatus.clear();
-    lp64::OpencoreImpl::Finish();
+int Arch::ListRegs(Prstatus& prstatus, uint64_t* out) {
+    int num = 0;
+    for (int i = 0; i < 31; i++)
+        out[num++] = prstatus.pr_reg.regs[i];
+    out[num++] = prstatus.pr_reg.sp;
+    out[num++] = prstatus.pr_reg.pc;
+    return num;
 }
 
 } // namespace arm64
+
+template class ElfCoreWriter<Elf64Class, arm64::Arch>;
@@ -17,7 +17,7 @@
 #ifndef OPENCORE_ARM64_OPENCORE_IMPL_H_
 #define OPENCORE_ARM64_OPENCORE_IMPL_H_
 
-#include "opencore/lp64/opencore.h"
+#include "opencore/elfcore.h"
 
 namespace arm64 {
 
@@ -67,22 +67,25 @@ typedef struct elf64_tls {
     struct tls regs;
 } Elf64_tls;
 
-class Opencore : public lp64::OpencoreImpl {
-public:
-    Opencore() : lp64::OpencoreImpl() {}
-    void Finish();
-    void CreateCorePrStatus(int pid);
-    void WriteCorePrStatus(FILE* fp);
-    int IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma);
-    void WriteCoreFpRegs(int tid, FILE* fp);
-    void WriteCoreTLS(int tid, FILE* fp);
-    void WriteCorePAC(int tid, FILE* fp);
-    void WriteCoreMTE(int tid, FILE* fp);
-    int getMachine() { return EM_AARCH64; }
-private:
-    std::vector<Elf64_prstatus> prstatus;
+struct Arch {
+    typedef arm64::pt_regs Regs;
+    typedef Elf64_prstatus Prstatus;
+    static constexpr int MACHINE = EM_AARCH64;
+    static void ContextRegs(void* ucontext, Regs* regs);
+    static int ListRegs(Prstatus& prstatus, uint64_t* out);
+    static uint64_t ProgramCounter(Prstatus& prstatus) { return prstatus.pr_reg.pc; }
+    static uint64_t StackPointer(Prstatus& prstatus) { return prstatus.pr_reg.sp; }
+    static void BuildThreadNotes(NoteBuilder& notes, int tid);
+    static void BuildCoreFpRegs(NoteBuilder& notes, int tid);
+    static void BuildCoreTLS(NoteBuilder& notes, int tid);
+    static void BuildCorePAC(NoteBuilder& notes, int tid);
+    static void BuildCoreMTE(NoteBuilder& notes, int tid);
 };
 
+typedef ElfCoreWriter<Elf64Class, Arch> Opencore;
+
 } // namespace arm64
 
+extern template class ElfCoreWriter<Elf64Class, arm64::Arch>;
+
 #endif // OPENCORE_ARM64_OPENCORE_IMPL_H_
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/dedup.h"
+#include "opencore/hash.h"
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static uint64_t NowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void DedupStore::ResetStats() {
+    total = 0;
+    zeros = 0;
+    dups = 0;
+    added = 0;
+    start_us = 0;
+}
+
+static bool WriteFully(int fd, const void* data, uint64_t size) {
+    const uint8_t* p = (const uint8_t *)data;
+    while (size) {
+        ssize_t rc = write(fd, p, size);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0)
+            return false;
+        p += rc;
+        size -= rc;
+    }
+    return true;
+}
+
+static void WriteHeader(int fd, uint32_t unit, uint64_t count) {
+    DedupStore::Header header;
+    memset(&header, 0, sizeof(DedupStore::Header));
+    memcpy(header.magic, DedupStore::MAGIC, strlen(DedupStore::MAGIC));
+    header.version = DedupStore::VERSION;
+    header.unit = unit;
+    header.count = count;
+    pwrite64(fd, &header, sizeof(DedupStore::Header), 0);
+}
+
+bool DedupStore::Open(const char* filename, uint32_t size) {
+    Close();
+
+    char dir[PATH_MAX];
+    const char* split = strrchr(filename, '/');
+    if (split)
+        snprintf(dir, sizeof(dir), "%.*s", (int)(split - filename), filename);
+    else
+        snprintf(dir, sizeof(dir), ".");
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, STORE_NAME);
+    store_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (store_fd < 0) {
+        JNI_LOGE("open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    // one dump at a time may append to a store
+    if (flock(store_fd, LOCK_EX) < 0) {
+        JNI_LOGE("lock %s: %s", path, strerror(errno));
+        Close();
+        return false;
+    }
+
+    unit = size;
+    snprintf(path, sizeof(path), "%s/%s", dir, INDEX_NAME);
+    index_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (index_fd < 0 || !LoadIndex()) {
+        JNI_LOGE("open %s: %s", path, strerror(errno));
+        Close();
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "%s%s", filename, PAGES_SUFFIX);
+    pages_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (pages_fd < 0) {
+        JNI_LOGE("open %s: %s", path, strerror(errno));
+        Close();
+        return false;
+    }
+
+    WriteHeader(pages_fd, unit, 0);
+    lseek(pages_fd, sizeof(Header), SEEK_SET);
+
+    verify.assign(unit, 0);
+    zero_page.assign(unit, 0);
+    zero_hash = PageHash(zero_page.data(), unit);
+    ref_count = 0;
+    record_count = 0;
+    ResetStats();
+    start_us = NowUs();
+    return true;
+}
+
+bool DedupStore::LoadIndex() {
+    struct stat sb;
+    if (fstat(store_fd, &sb) < 0)
+        return false;
+
+    // pages past the last index record were torn by an earlier dump, reuse them
+    store_pages = sb.st_size / unit;
+    index.clear();
+
+    uint64_t last = 0;
+    uint64_t offset = 0;
+    for (;;) {
+        ssize_t ret = pread64(index_fd, records, sizeof(records), offset);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        int count = ret > 0 ? ret / sizeof(IndexRecord) : 0;
+        if (!count)
+            break;
+        offset += count * sizeof(IndexRecord);
+
+        for (int i = 0; i < count; ++i) {
+            IndexRecord& record = records[i];
+            if (record.page >= store_pages)
+                continue;
+            index[record.hash] = record.page;
+            if (record.page + 1 > last)
+                last = record.page + 1;
+        }
+    }
+    store_pages = last;
+    return true;
+}
+
+bool DedupStore::FlushRefs() {
+    bool ok = WriteFully(pages_fd, refs, ref_count * sizeof(uint64_t));
+    ref_count = 0;
+    return ok;
+}
+
+bool DedupStore::FlushRecords() {
+    bool ok = WriteFully(index_fd, records, record_count * sizeof(IndexRecord));
+    record_count = 0;
+    return ok;
+}
+
+uint64_t DedupStore::StorePage(const uint8_t* data, uint64_t hash) {
+    uint64_t page = store_pages;
+    uint64_t done = 0;
+    while (done < unit) {
+        ssize_t ret = pwrite64(store_fd, data + done, unit - done, page * unit + done);
+        if (ret <= 0)
+            return REF_ZERO;
+        done += ret;
+    }
+
+    IndexRecord& record = records[record_count++];
+    record.hash = hash;
+    record.page = page;
+    if (record_count == BATCH)
+        FlushRecords();
+    index[hash] = page;
+    store_pages++;
+    added++;
+    return page;
+}
+
+bool DedupStore::AddPage(const uint8_t* data) {
+    if (!IsOpen())
+        return false;
+
+    total++;
+    uint64_t hash = PageHash(data, unit);
+    uint64_t ref = REF_ZERO;
+    if (hash == zero_hash && !memcmp(data, zero_page.data(), unit)) {
+        zeros++;
+    } else {
+        auto it = index.find(hash);
+        if (it != index.end()) {
+            // never trust the hash alone, a collision would corrupt the core
+            if (pread64(store_fd, verify.data(), unit, it->second * unit) == unit
+                    && !memcmp(verify.data(), data, unit)) {
+                ref = it->second;
+                dups++;
+            }
+        }
+
+        if (ref == REF_ZERO) {
+            ref = StorePage(data, hash);
+            // keep the refs in step with the phdrs, the unit reads back as zero
+            if (ref == REF_ZERO)
+                JNI_LOGE("store page fail. %s", strerror(errno));
+        }
+    }
+
+    refs[ref_count++] = ref;
+    return ref_count < BATCH || FlushRefs();
+}
+
+void DedupStore::Close() {
+    if (pages_fd >= 0) {
+        FlushRefs();
+        WriteHeader(pages_fd, unit, total);
+        close(pages_fd);
+        pages_fd = -1;
+
+        uint64_t cost = NowUs() - start_us;
+        uint64_t bytes = total * unit;
+        JNI_LOGI("Dedup %" PRIu64 " pages, zero %" PRIu64 ", dup %" PRIu64 ", new %" PRIu64
+                 ", ratio %.2f, %.1f MB/s.", total, zeros, dups, added,
+                 added ? (double)total / added : 0.0,
+                 cost ? (double)bytes / cost : 0.0);
+    }
+
+    if (index_fd >= 0) {
+        FlushRecords();
+        fsync(index_fd);
+        close(index_fd);
+        index_fd = -1;
+    }
+
+    if (store_fd >= 0) {
+        fsync(store_fd);
+        flock(store_fd, LOCK_UN);
+        close(store_fd);
+        store_fd = -1;
+    }
+    index.clear();
+    verify.clear();
+    zero_page.clear();
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_DEDUP_H_
+#define OPENCORE_DEDUP_H_
+
+#include "opencore/arena.h"
+#include <stdint.h>
+#include <functional>
+#include <unordered_map>
+
+/*
+ * Content addressed page store shared by every dump of one directory.
+ *
+ *   <dir>/opencore.store      unique pages, page n at n * unit
+ *   <dir>/opencore.store.idx  { u64 hash, u64 page }[] appended per new page
+ *   <core>                    ELF header, phdrs and notes only
+ *   <core>.pages              DedupHeader, then one u64 ref per load unit,
+ *                             in phdr order, REF_ZERO for an all zero unit
+ *
+ * tools/opencore-dedup rebuilds the plain core from the three files.
+ * Everything lives in arena containers behind raw fds, the store is also
+ * written from the crash handler.
+ */
+class DedupStore {
+public:
+    static constexpr const char* STORE_NAME = "opencore.store";
+    static constexpr const char* INDEX_NAME = "opencore.store.idx";
+    static constexpr const char* PAGES_SUFFIX = ".pages";
+    static constexpr const char* MAGIC = "OCPAGES";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t REF_ZERO = ~0ULL;
+    static constexpr int BATCH = 512;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t unit;
+        uint64_t count;
+    };
+
+    struct IndexRecord {
+        uint64_t hash;
+        uint64_t page;
+    };
+
+    DedupStore()
+        : store_fd(-1), index_fd(-1), pages_fd(-1),
+          unit(0), store_pages(0), zero_hash(0),
+          ref_count(0), record_count(0) { ResetStats(); }
+    ~DedupStore() { Close(); }
+
+    bool Open(const char* filename, uint32_t unit);
+    bool IsOpen() { return pages_fd >= 0; }
+    bool AddPage(const uint8_t* data);
+    void Close();
+private:
+    void ResetStats();
+    bool LoadIndex();
+    uint64_t StorePage(const uint8_t* data, uint64_t hash);
+    bool FlushRefs();
+    bool FlushRecords();
+
+    int store_fd;
+    int index_fd;
+    int pages_fd;
+    uint32_t unit;
+    uint64_t store_pages;
+    uint64_t zero_hash;
+    std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                       ArenaAllocator<std::pair<const uint64_t, uint64_t>>> index;
+    ArenaVector<uint8_t> verify;
+    ArenaVector<uint8_t> zero_page;
+    // refs and index records go out in batches, not one syscall per page
+    uint64_t refs[BATCH];
+    IndexRecord records[BATCH];
+    int ref_count;
+    int record_count;
+
+    uint64_t total;
+    uint64_t zeros;
+    uint64_t dups;
+    uint64_t added;
+    uint64_t start_us;
+};
+
+#endif // OPENCORE_DEDUP_H_
@@ -0,0 +1,683 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_ELFCORE_INL_H_
+#define OPENCORE_ELFCORE_INL_H_
+
+#include "eajnis/Log.h"
+#include "opencore/elfcore.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::ParserPhdr(int index, Opencore::VirtualMemoryArea& vma) {
+    phdr[index].p_type = PT_LOAD;
+
+    phdr[index].p_vaddr = (Addr)vma.begin;
+    phdr[index].p_paddr = 0x0;
+    phdr[index].p_memsz = (Addr)vma.end-(Addr)vma.begin;
+
+    if (vma.flags[0] == 'r' || vma.flags[0] == 'R')
+        phdr[index].p_flags = phdr[index].p_flags | PF_R;
+
+    if (vma.flags[1] == 'w' || vma.flags[1] == 'W')
+        phdr[index].p_flags = phdr[index].p_flags | PF_W;
+
+    if (vma.flags[2] == 'x' || vma.flags[2] == 'X')
+        phdr[index].p_flags = phdr[index].p_flags | PF_X;
+
+    phdr[index].p_filesz = phdr[index].p_memsz;
+    phdr[index].p_align = align_size;
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::ParserNtFile(int index, Opencore::VirtualMemoryArea& vma) {
+    file[index].begin = (Addr)vma.begin;
+    file[index].end = (Addr)vma.end;
+    file[index].offset = vma.offset >> 12;
+    fileslen += vma.file.length() + 1;
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::ParseProcessMapsVma(int pid) {
+    ParseMaps(pid, maps);
+    if (!maps.size())
+        return;
+
+    phdr.assign(maps.size(), {});
+    file.assign(maps.size(), {});
+
+    for (int index = 0; index < maps.size(); ++index) {
+        Opencore::VirtualMemoryArea& vma = maps[index];
+        ParserPhdr(index, vma);
+        ParserNtFile(index, vma);
+    }
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::CreateCoreHeader() {
+    snprintf((char *)ehdr.e_ident, 5, ELFMAG);
+    ehdr.e_ident[EI_CLASS] = ElfClass::CLASS;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+
+    ehdr.e_type = ET_CORE;
+    ehdr.e_machine = getMachine();
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_entry = 0x0;
+    ehdr.e_phoff = sizeof(Ehdr);
+    ehdr.e_shoff = 0x0;
+    ehdr.e_flags = 0x0;
+    ehdr.e_ehsize = sizeof(Ehdr);
+    ehdr.e_phentsize = sizeof(Phdr);
+    ehdr.e_phnum = (int)phdr.size() + 1;
+    ehdr.e_shentsize = 0x0;
+    ehdr.e_shnum = 0x0;
+    ehdr.e_shstrndx = 0x0;
+
+    // per page segments may overflow e_phnum, the real count then lives in
+    // sh_info of a single section header placed right after the phdr table.
+    if (phdr.size() + 1 >= PN_XNUM) {
+        ehdr.e_phnum = PN_XNUM;
+        ehdr.e_shoff = sizeof(Ehdr) + (phdr.size() + 1) * sizeof(Phdr);
+        ehdr.e_shentsize = sizeof(Shdr);
+        ehdr.e_shnum = 1;
+    }
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::CreateCoreNoteHeader() {
+    note.p_type = PT_NOTE;
+    note.p_offset = sizeof(Ehdr) + (phdr.size() + 1) * sizeof(Phdr);
+    if (ehdr.e_shoff)
+        note.p_offset += sizeof(Shdr);
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::CreateCorePrStatus(int pid) {
+    if (!threads.size()) return;
+
+    prstatus.assign(threads.size(), {});
+    int prnum = (int)prstatus.size();
+
+    int cur = 1;
+    for (int index = 0; index < prnum; index++) {
+        pid_t tid = threads[index].pid;
+        int idx;
+        if (tid == getTid()) {
+            idx = 0;
+            prstatus[idx].pr_pid = tid;
+            // top thread maybe use ucontext prs
+            if (getContext()) {
+                Arch::ContextRegs(getContext(), &prstatus[idx].pr_reg);
+                continue;
+            }
+        } else {
+            // 0 top thread was truncated
+            idx = (cur >= prnum) ? 0 : cur;
+            ++cur;
+            prstatus[idx].pr_pid = tid;
+        }
+
+        struct iovec ioVec = {
+            &prstatus[idx].pr_reg,
+            sizeof(typename Arch::Regs),
+        };
+
+        if (ptrace(PTRACE_GETREGSET, tid, NT_PRSTATUS, &ioVec) < 0)
+            continue;
+    }
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::CreateCoreAUXV(int pid) {
+    char filename[32];
+    Auxv vec;
+    snprintf(filename, sizeof(filename), "/proc/%d/auxv", pid);
+
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    while (read(fd, &vec, sizeof(vec)) == sizeof(vec)) {
+        auxv.push_back(vec);
+        auxvnum++;
+    }
+    close(fd);
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::SpecialCoreFilter() {
+    int filter = getFilter();
+    if ((filter & FILTER_MINIDUMP) && (filter & FILTER_MINIDUMP_WINDOW))
+        CreateMinidumpWindow();
+
+    if ((filter & FILTER_MINIDUMP) && (filter & FILTER_MINIDUMP_REACHABLE))
+        CreateMinidumpReachable();
+
+    if (filter & FILTER_JIT_CACHE_PC)
+        CreateJitRetention();
+
+    for (int index = 0; index < maps.size(); ++index) {
+        Opencore::VirtualMemoryArea& vma = maps[index];
+        int vma_flag = IsRuleFilterSegment(index);
+        if (vma_flag == VMA_NORMAL) {
+            vma_flag = IsFilterSegment(vma) | IsSpecialFilterSegment(vma);
+            // selected pages are kept like a minidump referenced vma
+            if (!vma.pages.empty())
+                vma_flag |= VMA_INCLUDE;
+        }
+
+        // no rule, register or selected page brings a driver or dontdump vma back
+        if (IsExcludedSegment(vma))
+            vma_flag = VMA_NULL;
+
+        if (vma_flag & VMA_NULL)
+            phdr[index].p_filesz = 0x0;
+
+        if (vma_flag & VMA_INCLUDE)
+            phdr[index].p_filesz = phdr[index].p_memsz;
+
+        if (phdr[index].p_filesz)
+            FilterPages(index);
+    }
+    CreatePageFilterNote();
+}
+
+template <class ElfClass, class Arch>
+int ElfCoreWriter<ElfClass, Arch>::IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma) {
+    int filter = getFilter();
+    if (filter & FILTER_MINIDUMP) {
+        // window and reachable select pages, a register never pulls in a whole vma
+        if (prstatus.empty() || (filter & (FILTER_MINIDUMP_WINDOW | FILTER_MINIDUMP_REACHABLE)))
+            return VMA_NULL;
+
+        uint64_t regs[64];
+        int num = Arch::ListRegs(prstatus[0], regs);
+        for (int i = 0; i < num; ++i) {
+            if (regs[i] >= vma.begin && regs[i] < vma.end)
+                return VMA_INCLUDE;
+        }
+        return VMA_NULL;
+    }
+    return VMA_NORMAL;
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::SplitLoadSegments() {
+    bool need_split = false;
+    for (int index = 0; index < maps.size(); ++index) {
+        if (!maps[index].pages.empty() && phdr[index].p_filesz) {
+            need_split = true;
+            break;
+        }
+    }
+
+    if (!need_split)
+        return;
+
+    ArenaVector<Phdr> segments;
+    for (int index = 0; index < maps.size(); ++index) {
+        Opencore::VirtualMemoryArea& vma = maps[index];
+        if (vma.pages.empty() || !phdr[index].p_filesz) {
+            segments.push_back(phdr[index]);
+            continue;
+        }
+
+        // one segment per run of equally selected pages
+        int count = (int)vma.pages.size();
+        int begin = 0;
+        while (begin < count) {
+            int end = begin + 1;
+            while (end < count && vma.pages[end] == vma.pages[begin])
+                end++;
+
+            Phdr segment = phdr[index];
+            segment.p_vaddr = (Addr)(vma.begin + (uint64_t)begin * page_size);
+            segment.p_memsz = (Addr)((uint64_t)(end - begin) * page_size);
+            segment.p_filesz = vma.pages[begin] ? segment.p_memsz : 0x0;
+            segments.push_back(segment);
+            begin = end;
+        }
+    }
+    phdr.swap(segments);
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::WriteCoreHeader(OutputSink* sink) {
+    sink->Write(&ehdr, sizeof(Ehdr));
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::BuildCoreNoteSegment() {
+    // per thread notes dominate, a couple of KB each covers every arch
+    uint64_t capacity = (uint64_t)getPrNum() * 2048 + sizeof(File) * file.size() + fileslen;
+    note_arena.Reset(RoundUp(capacity, page_size) + page_size);
+
+    BuildCorePrStatus();
+    BuildCoreAUXV();
+    BuildExtraNotes();
+    BuildNtFile();
+
+    note.p_filesz = note_arena.Size();
+    // zero tail up to the first load segment
+    note_arena.PadTo(RoundUp(note.p_offset + note.p_filesz, align_size) - note.p_offset);
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::WriteCoreNoteHeader(OutputSink* sink) {
+    sink->Write(&note, sizeof(Phdr));
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::WriteCoreProgramHeaders(OutputSink* sink) {
+    if (phdr.empty())
+        return;
+
+    int phnum = (int)phdr.size();
+    uint64_t offset = RoundUp(note.p_offset + note.p_filesz, align_size);
+    phdr[0].p_offset = offset;
+    sink->Write(&phdr[0], sizeof(Phdr));
+
+    int index = 1;
+    while (index < phnum) {
+        phdr[index].p_offset = phdr[index - 1].p_offset + phdr[index-1].p_filesz;
+        sink->Write(&phdr[index], sizeof(Phdr));
+        index++;
+    }
+
+    if (ehdr.e_shoff) {
+        Shdr extnum;
+        memset(&extnum, 0, sizeof(Shdr));
+        extnum.sh_type = SHT_NULL;
+        extnum.sh_size = ehdr.e_shnum;
+        extnum.sh_link = ehdr.e_shstrndx;
+        extnum.sh_info = phnum + 1;
+        sink->Write(&extnum, sizeof(Shdr));
+    }
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::BuildCorePrStatus() {
+    int prnum = (int)prstatus.size();
+    for (int index = 0; index < prnum; index++) {
+        note_arena.Append(ELFCOREMAGIC, NT_PRSTATUS, &prstatus[index], sizeof(typename Arch::Prstatus));
+        if (!index) BuildCoreSignalInfo();
+        Arch::BuildThreadNotes(note_arena, prstatus[index].pr_pid);
+    }
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::BuildCoreSignalInfo() {
+    siginfo_t info;
+    memset(&info, 0x0, sizeof(siginfo_t));
+    if (getSignalInfo())
+        memcpy(&info, getSignalInfo(), sizeof(siginfo_t));
+    note_arena.Append(ELFCOREMAGIC, NT_SIGINFO, &info, sizeof(siginfo_t));
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::BuildCoreAUXV() {
+    note_arena.Append(ELFCOREMAGIC, NT_AUXV, auxv.data(), sizeof(Auxv) * auxvnum);
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::BuildNtFile() {
+    int phnum = (int)file.size();
+    Word head[2] = { (Word)phnum, (Word)page_size };
+    uint32_t descsz = sizeof(head) + sizeof(File) * phnum + RoundUp(fileslen, 4);
+    uint8_t* desc = note_arena.Append(ELFCOREMAGIC, NT_FILE, descsz);
+
+    memcpy(desc, head, sizeof(head));
+    desc += sizeof(head);
+    memcpy(desc, file.data(), sizeof(File) * phnum);
+    desc += sizeof(File) * phnum;
+
+    for (int index = 0; index < phnum; ++index) {
+        memcpy(desc, maps[index].file.data(), maps[index].file.length() + 1);
+        desc += maps[index].file.length() + 1;
+    }
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::WriteCoreNoteSegment(OutputSink* sink) {
+    // the padded arena ends where the first load segment starts
+    sink->Skip(note.p_offset);
+    note_arena.Write(sink);
+    sink->Skip(RoundUp(note.p_offset + note.p_filesz, align_size));
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::WriteCoreLoadSegment(int pid, OutputSink* sink) {
+    char filename[32];
+    int fd;
+    int index = 0;
+    int phnum = (int)phdr.size();
+    memset(zero.data(), 0x0, align_size);
+
+    snprintf(filename, sizeof(filename), "/proc/%d/mem", pid);
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        JNI_LOGE("open %s fail.", filename);
+        return;
+    }
+
+    uint64_t total = 0;
+    for (int i = 0; i < phnum; ++i)
+        total += phdr[i].p_filesz;
+    BeginLoadDeadline(total);
+
+    while(index < phnum) {
+        if (phdr[index].p_filesz > 0 && IsPastDeadline())
+            DegradeLoadSegments(sink, index, 0);
+
+        if (phdr[index].p_filesz > 0) {
+            uint64_t current_pos = sink->Offset();
+            bool need_padd_zero = false;
+            int count = phdr[index].p_filesz / align_size;
+            for (int i = 0; i < count; i++) {
+                if (i && !(i % DEADLINE_CHECK_PAGES) && IsPastDeadline()) {
+                    // keep the pages already written of this segment
+                    DegradeLoadSegments(sink, index, (uint64_t)i * align_size);
+                    if (sink->IsSeekable())
+                        break;
+                }
+
+                if (IsStreamFill(index)) {
+                    memset(zero.data(), 0x0, align_size);
+                    if (!sink->Write(zero.data(), align_size))
+                        return;
+                    continue;
+                }
+
+                // clean file pages go disk to disk, skipping /proc/pid/mem
+                uint64_t copied = CopyFilePages(sink, phdr[index].p_vaddr + ((uint64_t)i * align_size),
+                                                (uint64_t)(count - i) * align_size);
+                if (copied) {
+                    i += copied / align_size - 1;
+                    AddLoadBytes(copied);
+                    continue;
+                }
+
+                memset(zero.data(), 0x0, align_size);
+                pread64(fd, zero.data(), phdr[index].p_align, phdr[index].p_vaddr + (i * align_size));
+                AddLoadBytes(align_size);
+                if (dedup_store.IsOpen()) {
+                    dedup_store.AddPage(zero.data());
+                    continue;
+                }
+
+                if (!sink->Write(zero.data(), align_size)) {
+                    int vma_index = FindVma(phdr[index].p_vaddr);
+                    JNI_LOGE("[%" PRIx64 "] write load segment fail. %s %s",
+                            (uint64_t)phdr[index].p_vaddr, strerror(errno),
+                            vma_index >= 0 ? maps[vma_index].file.c_str() : "");
+                    // a stream can't go back and pad
+                    if (errno == ENOSPC || !sink->IsSeekable())
+                        return;
+
+                    need_padd_zero = true;
+                    break;
+                }
+            }
+            if (need_padd_zero && current_pos > 0) {
+                memset(zero.data(), 0x0, align_size);
+                sink->Seek(current_pos);
+                int count = phdr[index].p_memsz / align_size;
+                for (int i = 0; i < count; i++)
+                    sink->Write(zero.data(), align_size);
+            }
+        }
+        index++;
+    }
+    close(fd);
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::RewriteProgramHeaders(int fd) {
+    // phdr table follows the ELF header and the note program header
+    uint64_t size = phdr.size() * sizeof(Phdr);
+    pwrite64(fd, phdr.data(), size, ehdr.e_phoff + sizeof(Phdr));
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::DegradeLoadSegments(OutputSink* sink, int index, uint64_t written) {
+    degraded = true;
+    // tripped before this segment started, a stack still goes in whole
+    bool keep = !written && IsDegradeKeep(phdr[index].p_vaddr, phdr[index].p_vaddr + phdr[index].p_memsz);
+    if (!sink->IsSeekable()) {
+        fill_from = index;
+        fill_current = !keep;
+        JNI_LOGW("Degrade to stacks only from segment %d, the rest zero filled.", index);
+        return;
+    }
+
+    int phnum = (int)phdr.size();
+    int kept = 0;
+    if (keep)
+        kept++;
+    else
+        phdr[index].p_filesz = written;
+    for (int i = index + 1; i < phnum; ++i) {
+        if (!phdr[i].p_filesz)
+            continue;
+        if (IsDegradeKeep(phdr[i].p_vaddr, phdr[i].p_vaddr + phdr[i].p_memsz))
+            kept++;
+        else
+            phdr[i].p_filesz = 0x0;
+    }
+
+    for (int i = index + 1; i < phnum; ++i)
+        phdr[i].p_offset = phdr[i - 1].p_offset + phdr[i - 1].p_filesz;
+
+    // phdr table follows the ELF header and the note program header
+    sink->WriteAt(phdr.data(), phdr.size() * sizeof(Phdr), ehdr.e_phoff + sizeof(Phdr));
+    JNI_LOGW("Degrade to stacks only from segment %d, %d segments kept.", index, kept);
+}
+
+template <class ElfClass, class Arch>
+bool ElfCoreWriter<ElfClass, Arch>::IsStreamFill(int index) {
+    if (fill_from < 0 || index < fill_from)
+        return false;
+    return (index == fill_from && fill_current)
+            || !IsDegradeKeep(phdr[index].p_vaddr, phdr[index].p_vaddr + phdr[index].p_memsz);
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::TruncateOnTimeout() {
+    // signal context: only what already reached the file counts, no stdio
+    if (core_fd < 0 || !IsLoadWriting() || phdr.empty() || dedup_store.IsOpen())
+        return;
+
+    struct stat sb;
+    if (fstat(core_fd, &sb) < 0)
+        return;
+
+    uint64_t size = sb.st_size;
+    int phnum = (int)phdr.size();
+    for (int i = 0; i < phnum; ++i) {
+        if (i)
+            phdr[i].p_offset = phdr[i - 1].p_offset + phdr[i - 1].p_filesz;
+        if (phdr[i].p_offset + phdr[i].p_filesz <= size)
+            continue;
+        uint64_t avail = size > phdr[i].p_offset ? size - phdr[i].p_offset : 0;
+        phdr[i].p_filesz = RoundDown(avail, (uint64_t)align_size);
+    }
+    RewriteProgramHeaders(core_fd);
+}
+
+template <class ElfClass, class Arch>
+bool ElfCoreWriter<ElfClass, Arch>::PlanCoredump() {
+    // smaps walks page tables, keep it out of the stopped window
+    ParseProcessSmaps(getPid());
+    if (!StopTheWorld(getPid()))
+        return false;
+
+    ParseProcessMapsVma(getPid());
+    MergeSmaps();
+    CreateCorePrStatus(getPid());
+    CreateCrashNote();
+    CreateCoreAUXV(getPid());
+    SpecialCoreFilter();
+    SplitLoadSegments();
+    CreateCoreHeader();
+    CreateCoreNoteHeader();
+    BuildCoreNoteSegment();
+    return true;
+}
+
+template <class ElfClass, class Arch>
+bool ElfCoreWriter<ElfClass, Arch>::DoPlan(std::string& json, bool measure) {
+    Prepare(nullptr);
+    if (!PlanCoredump())
+        return false;
+    // layout is known, nothing below needs the threads stopped
+    Continue();
+
+    std::vector<Opencore::PlanSegment> segments(phdr.size());
+    for (int index = 0; index < phdr.size(); ++index) {
+        segments[index].vaddr = phdr[index].p_vaddr;
+        segments[index].memsz = phdr[index].p_memsz;
+        segments[index].filesz = phdr[index].p_filesz;
+    }
+    uint64_t head = RoundUp(note.p_offset + note.p_filesz, align_size);
+    BuildPlan(segments, head, note.p_filesz, json, measure);
+    return true;
+}
+
+template <class ElfClass, class Arch>
+bool ElfCoreWriter<ElfClass, Arch>::DoCoredump(const char* filename) {
+    Prepare(filename);
+
+    OutputSink* sink = getSink();
+    if (!sink || !sink->Open()) {
+        JNI_LOGE("%s %s: %s", __func__, filename, strerror(errno));
+        return false;
+    }
+    // the timeout handler rewrites headers straight on the fd
+    core_fd = sink->IsSeekable() ? sink->Fd() : -1;
+    fill_from = -1;
+    fill_current = false;
+    // page store names its files after the core
+    if (sink->Path())
+        BeginDedup(sink->Path());
+    if (!PlanCoredump()) {
+        // never a core with threads missing their registers
+        JNI_LOGE("%s %s: threads not stopped, dump dropped.", __func__, filename);
+        core_fd = -1;
+        dedup_store.Close();
+        sink->Close();
+        if (sink->Path())
+            unlink(sink->Path());
+        return false;
+    }
+
+    // ELF Header
+    WriteCoreHeader(sink);
+    MarkFirstByte(phdr.size());
+
+    // Program Headers
+    WriteCoreNoteHeader(sink);
+    WriteCoreProgramHeaders(sink);
+
+    // Segments
+    WriteCoreNoteSegment(sink);
+    WriteCoreLoadSegment(getPid(), sink);
+    dedup_store.Close();
+
+    core_fd = -1;
+    MarkWritten(sink->Offset());
+    sink->Close();
+    return true;
+}
+
+template <class ElfClass, class Arch>
+int ElfCoreWriter<ElfClass, Arch>::NeedFilterFile(Opencore::VirtualMemoryArea& vma) {
+    struct stat sb;
+    int fd = open(vma.file.c_str(), O_RDONLY);
+    if (fd < 0)
+        return VMA_NULL;
+
+    if (fstat(fd, &sb) < 0) {
+        close(fd);
+        return VMA_NULL;
+    }
+
+    char* mem = (char *)mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0x0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return VMA_NULL;
+
+    Ehdr* ehdr = (Ehdr*)mem;
+    if (strncmp(mem, ELFMAG, 4) || ehdr->e_machine != getMachine()) {
+        munmap(mem, sb.st_size);
+        return VMA_NULL;
+    }
+
+    int ret = VMA_NULL;
+    Phdr* phdr = (Phdr *)(mem + sizeof(Ehdr));
+    for (int index = 0; index < ehdr->e_phnum; index++) {
+        if (phdr[index].p_type != PT_LOAD)
+            continue;
+
+        uint64_t pos = RoundDown((uint64_t)phdr[index].p_offset, (uint64_t)page_size);
+        uint64_t end = pos + phdr[index].p_memsz;
+        if (pos <= vma.offset && vma.offset < end) {
+            if ((phdr[index].p_flags & PF_W))
+                ret = VMA_NORMAL;
+        }
+    }
+
+    munmap(mem, sb.st_size);
+    return ret;
+}
+
+template <class ElfClass, class Arch>
+uint64_t ElfCoreWriter<ElfClass, Arch>::FindAuxv(uint64_t type) {
+    for (int idx = 0; idx < auxvnum; ++idx) {
+        if (auxv[idx].type == type)
+            return auxv[idx].value;
+    }
+    return 0;
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::Prepare(const char* filename) {
+    if (filename)
+        JNI_LOGI("Coredump %s ...", filename);
+    zero.assign(align_size, 0);
+    memset(&ehdr, 0, sizeof(Ehdr));
+    memset(&note, 0, sizeof(Phdr));
+}
+
+template <class ElfClass, class Arch>
+void ElfCoreWriter<ElfClass, Arch>::Finish() {
+    prstatus.clear();
+    auxv.clear();
+    phdr.clear();
+    file.clear();
+    zero.clear();
+    Opencore::Finish();
+    JNI_LOGI("Finish done.");
+}
+
+#endif // OPENCORE_ELFCORE_INL_H_
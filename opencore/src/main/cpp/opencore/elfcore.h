@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_ELFCORE_H_
+#define OPENCORE_ELFCORE_H_
+
+#include "opencore/opencore.h"
+#include <linux/elf.h>
+
+struct Elf32Class {
+    typedef Elf32_Ehdr Ehdr;
+    typedef Elf32_Phdr Phdr;
+    typedef Elf32_Shdr Shdr;
+    typedef Elf32_Nhdr Nhdr;
+    typedef Elf32_Addr Addr;
+    typedef uint32_t Word;
+    static constexpr int CLASS = ELFCLASS32;
+};
+
+struct Elf64Class {
+    typedef Elf64_Ehdr Ehdr;
+    typedef Elf64_Phdr Phdr;
+    typedef Elf64_Shdr Shdr;
+    typedef Elf64_Nhdr Nhdr;
+    typedef Elf64_Addr Addr;
+    typedef uint64_t Word;
+    static constexpr int CLASS = ELFCLASS64;
+};
+
+// NT_AUXV entry
+template <class Word>
+struct ElfAuxv {
+    Word type;
+    Word value;
+};
+
+// NT_FILE entry, offset in pages
+template <class Word>
+struct ElfFile {
+    Word begin;
+    Word end;
+    Word offset;
+};
+
+/*
+ * Core writer of one ELF class and one register layout. ElfClass gives
+ * the header types, Arch the per-target registers:
+ *
+ *   typedef ... Regs;       // NT_PRSTATUS pr_reg
+ *   typedef ... Prstatus;   // NT_PRSTATUS desc, pr_reg inside
+ *   static constexpr int MACHINE;
+ *   static void ContextRegs(void* ucontext, Regs* regs);
+ *   static int ListRegs(Prstatus& prstatus, uint64_t* out);
+ *   static uint64_t ProgramCounter(Prstatus& prstatus);
+ *   static uint64_t StackPointer(Prstatus& prstatus);
+ *   static void BuildThreadNotes(NoteBuilder& notes, int tid);
+ *
+ * Member definitions live in elfcore-inl.h, each arch translation unit
+ * instantiates its own writer.
+ */
+template <class ElfClass, class Arch>
+class ElfCoreWriter : public Opencore {
+public:
+    typedef typename ElfClass::Ehdr Ehdr;
+    typedef typename ElfClass::Phdr Phdr;
+    typedef typename ElfClass::Shdr Shdr;
+    typedef typename ElfClass::Addr Addr;
+    typedef typename ElfClass::Word Word;
+    typedef ElfAuxv<Word> Auxv;
+    typedef ElfFile<Word> File;
+
+    ElfCoreWriter() : Opencore(), auxvnum(0), fileslen(0), fill_from(-1), fill_current(false) {}
+    void Finish();
+    bool DoCoredump(const char* filename);
+    bool DoPlan(std::string& json, bool measure);
+    bool PlanCoredump();
+    int NeedFilterFile(Opencore::VirtualMemoryArea& vma);
+    void Prepare(const char* filename);
+    void ParseProcessMapsVma(int pid);
+    void ParserPhdr(int index, Opencore::VirtualMemoryArea& vma);
+    void ParserNtFile(int index, Opencore::VirtualMemoryArea& vma);
+    void CreateCoreHeader();
+    void CreateCoreNoteHeader();
+    void CreateCorePrStatus(int pid);
+    void CreateCoreAUXV(int pid);
+    void SpecialCoreFilter();
+    int IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma);
+    void SplitLoadSegments();
+
+    // ELF Header
+    void WriteCoreHeader(OutputSink* sink);
+
+    // Program Headers
+    void BuildCoreNoteSegment();
+    void WriteCoreNoteHeader(OutputSink* sink);
+    void WriteCoreProgramHeaders(OutputSink* sink);
+
+    // Segments
+    void BuildCorePrStatus();
+    void BuildCoreSignalInfo();
+    void BuildCoreAUXV();
+    void BuildNtFile();
+    void WriteCoreNoteSegment(OutputSink* sink);
+    void WriteCoreLoadSegment(int pid, OutputSink* sink);
+    void RewriteProgramHeaders(int fd);
+    void DegradeLoadSegments(OutputSink* sink, int index, uint64_t written);
+    bool IsStreamFill(int index);
+    void TruncateOnTimeout();
+
+    uint64_t FindAuxv(uint64_t type);
+
+    int getMachine() { return Arch::MACHINE; }
+    int getPrNum() { return prstatus.size(); }
+    int getPrRegs(int index, uint64_t* regs) { return Arch::ListRegs(prstatus[index], regs); }
+    uint64_t getPrSp(int index) { return Arch::StackPointer(prstatus[index]); }
+    bool getContextPcSp(void* ucontext, uint64_t* pc, uint64_t* sp) {
+        typename Arch::Prstatus status = {};
+        Arch::ContextRegs(ucontext, &status.pr_reg);
+        *pc = Arch::ProgramCounter(status);
+        *sp = Arch::StackPointer(status);
+        return true;
+    }
+protected:
+    Ehdr ehdr;
+    ArenaVector<Phdr> phdr;
+    Phdr note;
+    ArenaVector<Auxv> auxv;
+    int auxvnum;
+    ArenaVector<File> file;
+    int fileslen;
+    ArenaVector<typename Arch::Prstatus> prstatus;
+    // streams can't shrink segments already announced, from this one on
+    // the degraded ones are zero filled instead
+    int fill_from;
+    // fill_from itself is zero filled too, not a kept stack
+    bool fill_current;
+};
+
+#endif // OPENCORE_ELFCORE_H_
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "opencore/gzip.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void PutLe32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static bool WriteFully(int fd, const uint8_t* data, uint64_t size) {
+    while (size) {
+        ssize_t rc = write(fd, data, size);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0)
+            return false;
+        data += rc;
+        size -= rc;
+    }
+    return true;
+}
+
+static uint64_t ReadFully(int fd, uint8_t* data, uint64_t size) {
+    uint64_t total = 0;
+    while (total < size) {
+        ssize_t rc = read(fd, data + total, size - total);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0)
+            break;
+        total += rc;
+    }
+    return total;
+}
+
+// one gzip member holding size bytes of in, into out
+static uint32_t CompressMember(z_stream& zs, const uint8_t* in, uint32_t size,
+                               std::vector<uint8_t>& out) {
+    uint8_t* header = out.data();
+    uint8_t* body = header + SeekableGzip::HEADER_SIZE;
+    uint32_t room = out.size() - SeekableGzip::HEADER_SIZE - SeekableGzip::TRAILER_SIZE;
+
+    deflateReset(&zs);
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = size;
+    zs.next_out = body;
+    zs.avail_out = room;
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END)
+        return 0;
+
+    uint32_t deflated = room - zs.avail_out;
+    uint32_t member = SeekableGzip::HEADER_SIZE + deflated + SeekableGzip::TRAILER_SIZE;
+
+    memset(header, 0, SeekableGzip::HEADER_SIZE);
+    header[0] = 0x1f;
+    header[1] = 0x8b;
+    header[2] = Z_DEFLATED;
+    header[3] = 0x04;   // FEXTRA
+    header[9] = 0x03;   // unix
+    header[10] = 12;
+    header[12] = 'O';
+    header[13] = 'C';
+    header[14] = 8;
+    PutLe32(header + 16, member);
+    PutLe32(header + 20, size);
+
+    uint8_t* trailer = body + deflated;
+    PutLe32(trailer, crc32(crc32(0, Z_NULL, 0), in, size));
+    PutLe32(trailer + 4, size);
+    return member;
+}
+
+bool SeekableGzipWriter::Begin(int out) {
+    End();
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, SeekableGzip::LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    fd = out;
+    ready = true;
+    chunk.clear();
+    chunk.reserve(SeekableGzip::CHUNK);
+    member.resize(SeekableGzip::HEADER_SIZE + deflateBound(&zs, SeekableGzip::CHUNK)
+                  + SeekableGzip::TRAILER_SIZE);
+    return true;
+}
+
+bool SeekableGzipWriter::FlushMember() {
+    if (chunk.empty())
+        return true;
+    uint32_t length = CompressMember(zs, chunk.data(), chunk.size(), member);
+    chunk.clear();
+    if (!length) {
+        errno = EIO;
+        return false;
+    }
+    return WriteFully(fd, member.data(), length);
+}
+
+bool SeekableGzipWriter::Write(const void* data, uint64_t size) {
+    if (!ready)
+        return false;
+    const uint8_t* pos = (const uint8_t *)data;
+    while (size) {
+        uint64_t room = SeekableGzip::CHUNK - chunk.size();
+        uint64_t take = size < room ? size : room;
+        chunk.insert(chunk.end(), pos, pos + take);
+        pos += take;
+        size -= take;
+        if (chunk.size() == SeekableGzip::CHUNK && !FlushMember())
+            return false;
+    }
+    return true;
+}
+
+bool SeekableGzipWriter::Finish() {
+    return ready && FlushMember();
+}
+
+void SeekableGzipWriter::End() {
+    if (!ready)
+        return;
+    deflateEnd(&zs);
+    ready = false;
+    fd = -1;
+}
+
+bool SeekableGzip::Compress(const char* input, const char* output) {
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", output);
+
+    int in = open(input, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+
+    int out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    SeekableGzipWriter writer;
+    std::vector<uint8_t> buffer(CHUNK);
+    bool ok = writer.Begin(out);
+    uint64_t size;
+    while (ok && (size = ReadFully(in, buffer.data(), CHUNK)) > 0)
+        ok = writer.Write(buffer.data(), size);
+    ok = ok && writer.Finish();
+    writer.End();
+
+    close(in);
+    if (close(out) || !ok || rename(tmp, output)) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        return false;
+    }
+    return true;
+}
+
+bool SeekableGzip::IsSeekable(const uint8_t* header, int size) {
+    return size >= HEADER_SIZE
+            && header[0] == 0x1f && header[1] == 0x8b
+            && header[2] == Z_DEFLATED && (header[3] & 0x04)
+            && header[12] == 'O' && header[13] == 'C';
+}
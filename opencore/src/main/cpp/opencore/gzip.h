@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_GZIP_H_
+#define OPENCORE_GZIP_H_
+
+#include <stdint.h>
+#include <zlib.h>
+#include <vector>
+
+/*
+ * Seekable gzip. The core is cut into CHUNK sized pieces and each piece is
+ * a complete gzip member, so plain gunzip still reads the whole file:
+ *
+ *   1f 8b 08 04 <mtime 0> 00 03   FEXTRA set
+ *   <xlen 12> 'O' 'C' <len 8>     u32 member size, u32 piece size
+ *   raw deflate, crc32, isize
+ *
+ * A reader hops member to member on the sizes and inflates only the piece
+ * holding the core offset it wants. No logging here, the host tools build
+ * it too; failures come back as false with errno.
+ */
+class SeekableGzip {
+public:
+    static constexpr const char* SUFFIX = ".gz";
+    static constexpr uint32_t CHUNK = 1 << 20;
+    static constexpr int HEADER_SIZE = 24;
+    static constexpr int TRAILER_SIZE = 8;
+    static constexpr int LEVEL = 6;
+
+    // output is written beside as <output>.tmp and renamed when complete
+    static bool Compress(const char* input, const char* output);
+    static bool IsSeekable(const uint8_t* header, int size);
+};
+
+// streaming side, emits a member every CHUNK bytes written
+class SeekableGzipWriter {
+public:
+    SeekableGzipWriter() : fd(-1), ready(false) {}
+    ~SeekableGzipWriter() { End(); }
+
+    bool Begin(int fd);
+    bool Write(const void* data, uint64_t size);
+    // last partial member
+    bool Finish();
+    void End();
+private:
+    bool FlushMember();
+
+    int fd;
+    bool ready;
+    z_stream zs;
+    std::vector<uint8_t> chunk;
+    std::vector<uint8_t> member;
+};
+
+#endif // OPENCORE_GZIP_H_
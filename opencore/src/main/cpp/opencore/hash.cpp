@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "opencore/hash.h"
+#include <string.h>
+
+#if defined(__aarch64__) || defined(__arm64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static constexpr uint64_t PRIME32_1 = 0x9E3779B1U;
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+
+static constexpr int STRIPE_LEN = 64;
+static constexpr int LANES = 8;
+static constexpr int STRIPES_PER_BLOCK = 16;
+static constexpr int SECRET_WORDS = 16;
+
+static constexpr uint64_t SplitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+struct Secret {
+    uint64_t words[SECRET_WORDS];
+    constexpr Secret() : words() {
+        for (int i = 0; i < SECRET_WORDS; ++i)
+            words[i] = SplitMix64(PRIME64_3 + i);
+    }
+};
+
+static constexpr Secret kSecret;
+
+static inline uint64_t Mul128Fold64(uint64_t lhs, uint64_t rhs) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)lhs * rhs;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    uint64_t lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+    uint64_t hi_lo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+    uint64_t lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+    uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t Avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t ReadU64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void Accumulate(uint64_t* acc, const uint8_t* data, const uint64_t* key) {
+#if defined(__aarch64__) || defined(__arm64__) || defined(__ARM_NEON)
+    for (int i = 0; i < LANES; i += 2) {
+        uint64x2_t v = vreinterpretq_u64_u8(vld1q_u8(data + i * 8));
+        uint64x2_t k = vld1q_u64(key + i);
+        uint64x2_t dk = veorq_u64(v, k);
+        uint64x2_t product = vmull_u32(vmovn_u64(dk), vshrn_n_u64(dk, 32));
+        uint64x2_t a = vld1q_u64(acc + i);
+        a = vaddq_u64(a, vextq_u64(v, v, 1));
+        vst1q_u64(acc + i, vaddq_u64(a, product));
+    }
+#elif defined(__x86_64__) || defined(__SSE2__)
+    for (int i = 0; i < LANES; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i * 8));
+        __m128i k = _mm_loadu_si128((const __m128i *)(key + i));
+        __m128i dk = _mm_xor_si128(v, k);
+        __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        a = _mm_add_epi64(a, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi64(a, product));
+    }
+#else
+    for (int i = 0; i < LANES; ++i) {
+        uint64_t v = ReadU64(data + i * 8);
+        uint64_t dk = v ^ key[i];
+        acc[i ^ 1] += v;
+        acc[i] += (dk & 0xFFFFFFFF) * (dk >> 32);
+    }
+#endif
+}
+
+static void Scramble(uint64_t* acc, const uint64_t* key) {
+#if defined(__aarch64__) || defined(__arm64__) || defined(__ARM_NEON)
+    uint32x2_t prime = vdup_n_u32(PRIME32_1);
+    for (int i = 0; i < LANES; i += 2) {
+        uint64x2_t a = vld1q_u64(acc + i);
+        a = veorq_u64(a, vshrq_n_u64(a, 47));
+        a = veorq_u64(a, vld1q_u64(key + i));
+        uint64x2_t lo = vmull_u32(vmovn_u64(a), prime);
+        uint64x2_t hi = vshlq_n_u64(vmull_u32(vshrn_n_u64(a, 32), prime), 32);
+        vst1q_u64(acc + i, vaddq_u64(lo, hi));
+    }
+#elif defined(__x86_64__) || defined(__SSE2__)
+    __m128i prime = _mm_set1_epi32(PRIME32_1);
+    for (int i = 0; i < LANES; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)(key + i)));
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_slli_epi64(_mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime), 32);
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi64(lo, hi));
+    }
+#else
+    for (int i = 0; i < LANES; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * PRIME32_1;
+    }
+#endif
+}
+
+uint64_t PageHash(const void* data, uint32_t size) {
+    alignas(16) uint64_t acc[LANES] = {
+        PRIME32_1, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_1 ^ PRIME64_2, PRIME32_1 ^ PRIME64_3, PRIME64_2 + 1, PRIME64_3 + 1,
+    };
+
+    const uint8_t* input = (const uint8_t *)data;
+    uint32_t stripes = size / STRIPE_LEN;
+    for (uint32_t s = 0; s < stripes; ++s) {
+        Accumulate(acc, input + s * STRIPE_LEN, kSecret.words + (s % LANES));
+        if ((s + 1) % STRIPES_PER_BLOCK == 0)
+            Scramble(acc, kSecret.words + LANES);
+    }
+
+    uint64_t result = size * PRIME64_1;
+    for (int i = 0; i < LANES; i += 2)
+        result += Mul128Fold64(acc[i] ^ kSecret.words[i + 1], acc[i + 1] ^ kSecret.words[i + 2]);
+    return Avalanche(result);
+}
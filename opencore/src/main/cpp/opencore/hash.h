@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_HASH_H_
+#define OPENCORE_HASH_H_
+
+#include <stdint.h>
+
+/*
+ * 64-bit page hash in the xxh3 long-input style: eight 64-bit lanes fed
+ * 64-byte stripes as (data ^ key).lo32 * (data ^ key).hi32, scrambled
+ * every 1KB. NEON and SSE2 paths produce the same value as the scalar one.
+ * size must be a multiple of 64.
+ */
+uint64_t PageHash(const void* data, uint32_t size);
+
+#endif // OPENCORE_HASH_H_
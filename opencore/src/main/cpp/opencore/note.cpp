@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/note.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+static inline uint64_t Align4(uint64_t value) {
+    return (value + 3) & ~3ULL;
+}
+
+void NoteBuilder::Reset(uint64_t capacity) {
+    arena.clear();
+    arena.reserve(capacity);
+    size = 0;
+}
+
+void NoteBuilder::Clear() {
+    ArenaVector<uint8_t>().swap(arena);
+    size = 0;
+}
+
+uint8_t* NoteBuilder::Grow(uint64_t bytes) {
+    uint64_t pos = arena.size();
+    // resize zero fills, padding comes for free
+    arena.resize(pos + bytes);
+    return arena.data() + pos;
+}
+
+uint8_t* NoteBuilder::Append(const char* name, uint32_t type, uint32_t descsz) {
+    uint32_t namesz = strlen(name) + 1;
+    uint32_t nhdr[3] = { namesz, descsz, type };
+    uint64_t total = sizeof(nhdr) + Align4(namesz) + Align4(descsz);
+
+    uint8_t* pos = Grow(total);
+    memcpy(pos, nhdr, sizeof(nhdr));
+    memcpy(pos + sizeof(nhdr), name, namesz);
+    size = arena.size();
+    return pos + sizeof(nhdr) + Align4(namesz);
+}
+
+void NoteBuilder::Append(const char* name, uint32_t type, const void* desc, uint32_t descsz) {
+    uint8_t* pos = Append(name, type, descsz);
+    if (descsz)
+        memcpy(pos, desc, descsz);
+}
+
+void NoteBuilder::PadTo(uint64_t total) {
+    if (total > arena.size())
+        Grow(total - arena.size());
+}
+
+bool NoteBuilder::Write(OutputSink* sink) {
+    if (!sink->Write(arena.data(), arena.size())) {
+        JNI_LOGE("write note segment: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
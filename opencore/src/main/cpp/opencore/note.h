@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_NOTE_H_
+#define OPENCORE_NOTE_H_
+
+#include <stdint.h>
+#include "opencore/arena.h"
+#include "opencore/sink.h"
+
+/*
+ * PT_NOTE segment arena. Every note is serialized in file order with
+ * its name and desc padded to 4 bytes, Elf32_Nhdr and Elf64_Nhdr share
+ * one layout, so the arena size is the segment p_filesz by construction.
+ */
+class NoteBuilder {
+public:
+    NoteBuilder() : size(0) {}
+
+    void Reset(uint64_t capacity);
+    void Clear();
+    uint64_t Size() { return size; }
+    // zero filled desc of descsz, valid until the next Append
+    uint8_t* Append(const char* name, uint32_t type, uint32_t descsz);
+    void Append(const char* name, uint32_t type, const void* desc, uint32_t descsz);
+    // zero tail up to total bytes, not part of the segment
+    void PadTo(uint64_t total);
+    bool Write(OutputSink* sink);
+private:
+    uint8_t* Grow(uint64_t bytes);
+
+    ArenaVector<uint8_t> arena;
+    uint64_t size;
+};
+
+#endif // OPENCORE_NOTE_H_
@@ -20,55 +20,254 @@
 
 #include "eajnis/Log.h"
 #include "opencore/opencore.h"
+#include "opencore/scanner.h"
+#include "opencore/reader.h"
 #include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <time.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/ptrace.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
+#include <algorithm>
 
 #if defined(__aarch64__) || defined(__arm64__)
 #include "opencore/arm64/opencore.h"
-Opencore* opencore = new arm64::Opencore();
+typedef arm64::Opencore OpencoreArch;
 #elif defined(__arm__)
 #include "opencore/arm/opencore.h"
-Opencore* opencore = new arm::Opencore();
+typedef arm::Opencore OpencoreArch;
 #elif defined(__x86_64__)
 #include "opencore/x86_64/opencore.h"
-Opencore* opencore = new x86_64::Opencore();
+typedef x86_64::Opencore OpencoreArch;
 #elif defined(__i386__) || defined(__x86__)
 #include "opencore/x86/opencore.h"
-Opencore* opencore = new x86::Opencore();
+typedef x86::Opencore OpencoreArch;
 #elif defined(__riscv64__)
 #include "opencore/riscv64/opencore.h"
-Opencore* opencore = new riscv64::Opencore();
+typedef riscv64::Opencore OpencoreArch;
 #else
-Opencore* opencore = new Opencore();
+typedef Opencore OpencoreArch;
 #endif
 
+Opencore* opencore = new OpencoreArch();
+// dump or plan child of this process, for the alarm handler
+static Opencore* running = nullptr;
+
 Opencore* Opencore::GetInstance() {
     return opencore;
 }
 
+// the static setters write strings and rules a session may be copying
+static pthread_mutex_t g_config_lock = PTHREAD_MUTEX_INITIALIZER;
+
+Opencore* Opencore::NewSession() {
+    Opencore* session = new OpencoreArch();
+    if (opencore) {
+        pthread_mutex_lock(&g_config_lock);
+        session->CopyConfig(opencore);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+    return session;
+}
+
+void Opencore::CopyConfig(Opencore* from) {
+    dir = from->dir;
+    flag = from->flag;
+    filter = from->filter;
+    cb = from->cb;
+    timeout = from->timeout;
+    window = from->window;
+    reach_depth = from->reach_depth;
+    reach_budget = from->reach_budget;
+    reach_roots = from->reach_roots;
+    rules = from->rules;
+    swap_policy = from->swap_policy;
+    swap_budget = from->swap_budget;
+    copy_flags = from->copy_flags;
+    dedup = from->dedup;
+    baseline_pid = from->baseline_pid;
+    baseline_core = from->baseline_core;
+    working_set = from->working_set;
+    repeat_policy = from->repeat_policy;
+    signature_limit = from->signature_limit;
+    global_limit = from->global_limit;
+    quota = from->quota;
+    max_files = from->max_files;
+    max_age = from->max_age;
+    compact = from->compact;
+    CopyChain(from);
+}
+
+void Opencore::CopyChain(Opencore* from) {
+    incremental = from->incremental;
+    incr_base = from->incr_base;
+    incr_last = from->incr_last;
+    incr_links = from->incr_links;
+    incr_seq = from->incr_seq;
+}
+
 static pthread_mutex_t g_handle_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t g_switch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_chain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static Opencore::DumpStats g_last_stats;
+static bool g_has_stats = false;
+static int g_trace_users = 0;
+static int g_ori_dumpable = 0;
+static bool g_restore_dumpable = false;
+static bool g_restore_ptrace = false;
 static constexpr int kExceptionSignals[] = {
     SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS, SIGTRAP
 };
 static constexpr int kNumHandledSignals = sizeof(kExceptionSignals) / sizeof(kExceptionSignals[0]);
 static struct sigaction g_restore_action[kNumHandledSignals] = {0};
 static bool handlers_installed = false;
+// the first faulting thread owns the crash dump, faults of other threads
+// until it is done are recorded here and read back by the dumper
+static pid_t g_crash_owner = 0;
+static bool g_crash_done = false;
+static uint32_t g_crash_count = 0;
+static uint32_t g_crash_ready[Opencore::MAX_CRASH_RECORDS] = {0};
+static Opencore::CrashRecord g_crash_records[Opencore::MAX_CRASH_RECORDS];
+// dumps in flight hold off compaction, one compaction job at a time
+static int g_dumps_running = 0;
+static bool g_compacting = false;
+// pids whose threads a session of this process is stopping or dumping
+static pthread_mutex_t g_target_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_target_cond = PTHREAD_COND_INITIALIZER;
+static int g_targets[Opencore::MAX_DUMP_TARGETS] = {0};
+
+// two dumpers can not both ptrace one thread, the later session waits for
+// the target instead of writing threads it could not stop
+static void LockTarget(int pid) {
+    pthread_mutex_lock(&g_target_lock);
+    while (true) {
+        int slot = -1;
+        bool busy = false;
+        for (int i = 0; i < Opencore::MAX_DUMP_TARGETS; ++i) {
+            if (g_targets[i] == pid)
+                busy = true;
+            else if (!g_targets[i] && slot < 0)
+                slot = i;
+        }
+        if (!busy && slot >= 0) {
+            g_targets[slot] = pid;
+            break;
+        }
+        pthread_cond_wait(&g_target_cond, &g_target_lock);
+    }
+    pthread_mutex_unlock(&g_target_lock);
+}
+
+static void UnlockTarget(int pid) {
+    pthread_mutex_lock(&g_target_lock);
+    for (int i = 0; i < Opencore::MAX_DUMP_TARGETS; ++i) {
+        if (g_targets[i] == pid) {
+            g_targets[i] = 0;
+            break;
+        }
+    }
+    pthread_cond_broadcast(&g_target_cond);
+    pthread_mutex_unlock(&g_target_lock);
+}
 
 void Opencore::HandleSignal(int signal, siginfo_t* siginfo, void* ucontext_raw) {
+    pid_t self = gettid();
+    pid_t owner = 0;
+    if (!__atomic_compare_exchange_n(&g_crash_owner, &owner, self, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // coalesce into the running dump, never start a second one
+        if (owner != self)
+            RecordCrash(signal, siginfo, ucontext_raw);
+        while (!__atomic_load_n(&g_crash_done, __ATOMIC_ACQUIRE))
+            usleep(CRASH_WAIT_US);
+        raise(signal);
+        return;
+    }
+
+    // handlers stay installed while dumping so late faults still coalesce
     pthread_mutex_lock(&g_handle_lock);
-    Disable();
+    Arena::Crash().Activate(true);
     Dump(siginfo, ucontext_raw);
+    Arena::Crash().Activate(false);
+    Disable();
+    __atomic_store_n(&g_crash_done, true, __ATOMIC_RELEASE);
     raise(signal);
     pthread_mutex_unlock(&g_handle_lock);
 }
 
+void Opencore::RecordCrash(int signal, siginfo_t* siginfo, void* ucontext_raw) {
+    uint32_t slot = __atomic_fetch_add(&g_crash_count, 1, __ATOMIC_RELAXED);
+    if (slot >= MAX_CRASH_RECORDS)
+        return;
+
+    CrashRecord& record = g_crash_records[slot];
+    record.tid = gettid();
+    record.signo = signal;
+    record.ucontext = (uint64_t)ucontext_raw;
+    if (siginfo)
+        memcpy(&record.info, siginfo, sizeof(siginfo_t));
+    __atomic_store_n(&g_crash_ready[slot], 1, __ATOMIC_RELEASE);
+}
+
+std::string Opencore::Plan(bool measure) {
+    return Plan(getpid(), gettid(), measure);
+}
+
+std::string Opencore::Plan(int pid, int tid, bool measure) {
+    std::string json;
+    if (!GetInstance())
+        return json;
+
+    Opencore* impl = NewSession();
+    impl->setPid(pid);
+    impl->setTid(tid);
+    impl->setSignalInfo(nullptr);
+
+    // same ptrace permission as a real dump
+    BeginTraceable();
+    impl->Coreplan(json, measure);
+    EndTraceable();
+    delete impl;
+    return json;
+}
+
+void Opencore::BeginTraceable() {
+    // first session in opens ptrace to the dumper, last one out restores
+    pthread_mutex_lock(&g_trace_lock);
+    if (!g_trace_users++) {
+        g_ori_dumpable = prctl(PR_GET_DUMPABLE);
+        g_restore_dumpable = !prctl(PR_SET_DUMPABLE, 1);
+        g_restore_ptrace = !prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY);
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+}
+
+void Opencore::EndTraceable() {
+    pthread_mutex_lock(&g_trace_lock);
+    if (!--g_trace_users) {
+        if (g_restore_dumpable) prctl(PR_SET_DUMPABLE, g_ori_dumpable);
+        if (g_restore_ptrace) prctl(PR_SET_PTRACER, 0);
+        g_restore_dumpable = false;
+        g_restore_ptrace = false;
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+}
+
 bool Opencore::Enable() {
     pthread_mutex_lock(&g_switch_lock);
     if (handlers_installed) {
@@ -77,6 +276,20 @@ bool Opencore::Enable() {
         return false;
     }
 
+    // kept across Disable(), a handler may still be running on it
+    if (!Arena::Crash().Reserve(DEF_ARENA_SIZE))
+        JNI_LOGW("crash arena unavailable, crash dump falls back to heap.");
+
+    // the process lived through an earlier crash dump, the next fault
+    // must own a dump of its own instead of waiting on that one
+    if (__atomic_load_n(&g_crash_done, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&g_crash_count, 0, __ATOMIC_RELAXED);
+        for (int i = 0; i < MAX_CRASH_RECORDS; ++i)
+            __atomic_store_n(&g_crash_ready[i], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_crash_owner, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_crash_done, false, __ATOMIC_RELEASE);
+    }
+
     for (int i = 0; i < kNumHandledSignals; ++i) {
         if (sigaction(kExceptionSignals[i], NULL, &g_restore_action[i]) == -1) {
             JNI_LOGE("signal %d unable to store old handler", kExceptionSignals[i]);
@@ -100,6 +313,9 @@ bool Opencore::Enable() {
 
     handlers_installed = true;
     pthread_mutex_unlock(&g_switch_lock);
+
+    // cores left behind by the previous crash
+    StartCompact();
     return true;
 }
 
@@ -143,34 +359,213 @@ void Opencore::IgnoreHandler() {
 
 void Opencore::SetDir(const char *dir) {
     Opencore* impl = GetInstance();
-    if (impl) impl->setDir(dir);
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setDir(dir);
+        pthread_mutex_unlock(&g_config_lock);
+    }
 }
 
 void Opencore::SetCallback(DumpCallback cb) {
     Opencore* impl = GetInstance();
-    if (impl) impl->setCallback(cb);
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setCallback(cb);
+        pthread_mutex_unlock(&g_config_lock);
+    }
 }
 
 void Opencore::SetFlag(int flag) {
     Opencore* impl = GetInstance();
-    if (impl) impl->setFlag(flag);
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setFlag(flag);
+        pthread_mutex_unlock(&g_config_lock);
+    }
 }
 
 void Opencore::SetTimeout(int sec) {
     Opencore* impl = GetInstance();
-    if (impl && sec > 0)
+    if (impl && sec > 0) {
+        pthread_mutex_lock(&g_config_lock);
         impl->setTimeout(sec);
+        pthread_mutex_unlock(&g_config_lock);
+    }
 }
 
 void Opencore::SetFilter(int filter) {
     Opencore* impl = GetInstance();
-    if (impl) impl->setFilter(filter);
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setFilter(filter);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetPageWindow(int pages) {
+    Opencore* impl = GetInstance();
+    if (impl && pages >= 0) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setPageWindow(pages);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetReachDepth(int depth) {
+    Opencore* impl = GetInstance();
+    if (impl && depth >= 0) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setReachDepth(depth);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetReachBudget(uint64_t budget) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setReachBudget(budget);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetReachRoots(const char* libs) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setReachRoots(libs ? libs : "");
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+bool Opencore::SetRules(const char* rules) {
+    Opencore* impl = GetInstance();
+    if (!impl)
+        return false;
+    pthread_mutex_lock(&g_config_lock);
+    bool ret = impl->setRules(rules);
+    pthread_mutex_unlock(&g_config_lock);
+    return ret;
+}
+
+void Opencore::SetSwapPolicy(int policy) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setSwapPolicy(policy);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetSwapBudget(uint64_t budget) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setSwapBudget(budget);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetDedup(bool enable) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setDedup(enable);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetIncremental(bool enable) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        // restarts the chain a running dump copies back under g_chain_lock
+        pthread_mutex_lock(&g_chain_lock);
+        pthread_mutex_lock(&g_config_lock);
+        impl->setIncremental(enable);
+        pthread_mutex_unlock(&g_config_lock);
+        pthread_mutex_unlock(&g_chain_lock);
+    }
+}
+
+void Opencore::SetBaseline(int pid, const char* core) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setBaseline(pid, core);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetWorkingSet(int ms) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setWorkingSet(ms);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetRepeatPolicy(int policy) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setRepeatPolicy(policy);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetRateLimit(int per_signature, int global) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setRateLimit(per_signature, global);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetQuota(uint64_t bytes) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setQuota(bytes);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetMaxFiles(int count) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setMaxFiles(count);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetMaxAge(int sec) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setMaxAge(sec);
+        pthread_mutex_unlock(&g_config_lock);
+    }
+}
+
+void Opencore::SetCompact(bool enable) {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        pthread_mutex_lock(&g_config_lock);
+        impl->setCompact(enable);
+        pthread_mutex_unlock(&g_config_lock);
+    }
 }
 
 void Opencore::TimeoutHandle(int) {
     JNI_LOGI("Coredump timeout.");
-    Opencore* impl = GetInstance();
-    if (impl) impl->Finish();
+    Opencore* impl = running ? running : GetInstance();
+    if (impl) {
+        impl->TruncateOnTimeout();
+        impl->Finish();
+    }
     _exit(0);
 }
 
@@ -204,6 +599,143 @@ int Opencore::GetFilter() {
     return FILTER_NONE;
 }
 
+int Opencore::GetPageWindow() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getPageWindow();
+    return DEF_PAGE_WINDOW;
+}
+
+int Opencore::GetReachDepth() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getReachDepth();
+    return DEF_REACH_DEPTH;
+}
+
+uint64_t Opencore::GetReachBudget() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getReachBudget();
+    return DEF_REACH_BUDGET;
+}
+
+const char* Opencore::GetReachRoots() {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        std::string& roots = impl->getReachRoots();
+        return roots.c_str();
+    }
+    return "";
+}
+
+const char* Opencore::GetRules() {
+    Opencore* impl = GetInstance();
+    if (impl) {
+        std::string& rules = impl->getRules().getSource();
+        return rules.c_str();
+    }
+    return "";
+}
+
+int Opencore::GetSwapPolicy() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getSwapPolicy();
+    return SWAP_INCLUDE;
+}
+
+uint64_t Opencore::GetSwapBudget() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getSwapBudget();
+    return DEF_SWAP_BUDGET;
+}
+
+bool Opencore::GetDedup() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getDedup();
+    return false;
+}
+
+bool Opencore::GetIncremental() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getIncremental();
+    return false;
+}
+
+int Opencore::GetBaselinePid() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getBaselinePid();
+    return 0;
+}
+
+const char* Opencore::GetBaselineCore() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getBaselineCore().c_str();
+    return "";
+}
+
+int Opencore::GetWorkingSet() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getWorkingSet();
+    return 0;
+}
+
+int Opencore::GetRepeatPolicy() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getRepeatPolicy();
+    return REPEAT_FULL;
+}
+
+int Opencore::GetSignatureLimit() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getSignatureLimit();
+    return 0;
+}
+
+int Opencore::GetGlobalLimit() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getGlobalLimit();
+    return 0;
+}
+
+uint64_t Opencore::GetQuota() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getQuota();
+    return 0;
+}
+
+int Opencore::GetMaxFiles() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getMaxFiles();
+    return 0;
+}
+
+int Opencore::GetMaxAge() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getMaxAge();
+    return 0;
+}
+
+bool Opencore::GetCompact() {
+    Opencore* impl = GetInstance();
+    if (impl)
+        return impl->getCompact();
+    return false;
+}
+
 void Opencore::Dump() {
     Opencore::DumpOption option;
     option.pid = getpid();
@@ -227,6 +759,14 @@ void Opencore::Dump(const char* filename, int tid) {
     Opencore::Dump(&option);
 }
 
+void Opencore::Dump(OutputSink* sink, int tid) {
+    Opencore::DumpOption option;
+    option.pid = getpid();
+    option.tid = tid;
+    option.sink = sink;
+    Opencore::Dump(&option);
+}
+
 void Opencore::Dump(siginfo_t* siginfo, void* ucontext_raw) {
     Opencore::DumpOption option;
     option.pid = getpid();
@@ -242,44 +782,153 @@ void Opencore::Dump(Opencore::DumpOption* option) {
         return;
     }
 
-    int ori_dumpable;
-    int flag, pid, tid;
-    char comm[16];
-    bool need_split = false;
-    bool need_restore_dumpable = false;
-    bool need_restore_ptrace = false;
-    std::string output;
-
     Opencore* impl = GetInstance();
-    if (impl) {
-        impl->setPid(option->pid);
-        impl->setTid(option->tid);
-        impl->setSignalInfo(option->siginfo);
+    if (!impl) {
+        JNI_LOGI("Not support coredump!!");
+        return;
+    }
 
-        if (impl->getFilter() & FILTER_SIGNAL_CONTEXT)
-            impl->setContext(option->context);
+    // crash path stays on the default instance, HandleSignal serializes
+    // it and nothing there should allocate
+    if (option->siginfo) {
+        impl->RunDump(option);
+        return;
+    }
 
-        pid = impl->getPid();
-        tid = impl->getTid();
-        flag = impl->getFlag();
+    // the incremental chain is one per process, its dumps take turns
+    bool chain = impl->getIncremental();
+    if (chain) pthread_mutex_lock(&g_chain_lock);
 
-        if (impl->getDir().length() > 0) {
-            output.append(impl->getDir()).append("/");
-        }
-        if (!option->filename) {
-            if (!(flag & FLAG_ALL)) {
-                flag |= FLAG_CORE;
-                flag |= FLAG_TID;
-            }
+    Opencore* session = NewSession();
+    session->RunDump(option);
+    if (chain) {
+        impl->CopyChain(session);
+        pthread_mutex_unlock(&g_chain_lock);
+    }
+    delete session;
+    StartCompact();
+}
 
-            if (flag & FLAG_CORE)
-                output.append("core.");
+bool Opencore::IsDumping() {
+    return __atomic_load_n(&g_dumps_running, __ATOMIC_ACQUIRE) > 0;
+}
 
-            if (flag & FLAG_PROCESS_COMM) {
-                char comm_path[32];
-                snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-                int fd = open(comm_path, O_RDONLY);
-                if (fd > 0) {
+// linux/ioprio.h of older sysroots lacks these
+static constexpr int kIoprioWhoProcess = 1;
+static constexpr int kIoprioIdle = 3 << 13;
+
+struct CompactJob {
+    std::string dir;
+    ArenaVector<ArenaString> keep;
+};
+
+static void* CompactThread(void* arg) {
+    CompactJob* job = (CompactJob *)arg;
+    // background work, stay out of the app's way on cpu and disk
+    setpriority(PRIO_PROCESS, gettid(), 19);
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, gettid(), kIoprioIdle);
+    Retention::Compact(job->dir.c_str(), Opencore::IsDumping, job->keep);
+    delete job;
+    __atomic_store_n(&g_compacting, false, __ATOMIC_RELEASE);
+    return nullptr;
+}
+
+void Opencore::StartCompact() {
+    Opencore* impl = GetInstance();
+    if (!impl || !impl->getCompact())
+        return;
+
+    bool idle = false;
+    if (!__atomic_compare_exchange_n(&g_compacting, &idle, true, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return;
+
+    CompactJob* job = new CompactJob;
+    job->dir = impl->getDir().length() > 0 ? impl->getDir().c_str() : ".";
+    // the chain only changes under g_chain_lock
+    pthread_mutex_lock(&g_chain_lock);
+    impl->ListKeptCores(job->keep);
+    pthread_mutex_unlock(&g_chain_lock);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, CompactThread, job)) {
+        delete job;
+        __atomic_store_n(&g_compacting, false, __ATOMIC_RELEASE);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+bool Opencore::RunDump(Opencore::DumpOption* option) {
+    int flag, pid, tid;
+    char comm[16];
+    char number[24];
+    bool need_split = false;
+    ArenaString output;
+
+    stats_start = NowUs();
+    setPid(option->pid);
+    setTid(option->tid);
+    setSignalInfo(option->siginfo);
+
+    // a crash seen before may only get a minidump, or nothing at all
+    int saved_filter = getFilter();
+    if (option->siginfo) {
+        int action = CheckCrashRepeat(option);
+        if (action == REPEAT_SKIP)
+            return false;
+        if (action == REPEAT_MINIDUMP)
+            setFilter(saved_filter | FILTER_MINIDUMP);
+    }
+
+    // make room first, so the dump starts with a known budget
+    if (!option->sink) {
+        ArenaVector<ArenaString> keep;
+        ListKeptCores(keep);
+        uint64_t left = Retention::Enforce(getDir().length() > 0 ? getDir().c_str() : ".",
+                                           getQuota(), getMaxFiles(), getMaxAge(), keep);
+        if (getQuota() && !left) {
+            JNI_LOGW("Quota %" PRIu64 " used up by kept cores, skip dump.", getQuota());
+            setFilter(saved_filter);
+            return false;
+        }
+        if (getQuota() && left < MIN_FULL_BUDGET && !(getFilter() & FILTER_MINIDUMP)) {
+            JNI_LOGW("Only %" PRIu64 " bytes left under quota, minidump.", left);
+            setFilter(getFilter() | FILTER_MINIDUMP);
+        }
+    }
+
+    if (getFilter() & FILTER_SIGNAL_CONTEXT)
+        setContext(option->context);
+
+    pid = getPid();
+    tid = getTid();
+    flag = getFlag();
+
+    if (option->sink) {
+        // named by the sink, it is not a file of dir
+        output.append(option->sink->Name());
+    } else {
+        // an absolute filename is taken as given
+        bool absolute = option->filename && option->filename[0] == '/';
+        if (getDir().length() > 0 && !absolute) {
+            output.append(getDir()).append("/");
+        }
+        if (!option->filename) {
+            if (!(flag & FLAG_ALL)) {
+                flag |= FLAG_CORE;
+                flag |= FLAG_TID;
+            }
+
+            if (flag & FLAG_CORE)
+                output.append("core.");
+
+            if (flag & FLAG_PROCESS_COMM) {
+                char comm_path[32];
+                snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
+                int fd = open(comm_path, O_RDONLY);
+                if (fd > 0) {
                     memset(&comm, 0x0, sizeof(comm));
                     int rc = read(fd, &comm, sizeof(comm) - 1);
                     if (rc > 0) {
@@ -302,7 +951,8 @@ void Opencore::Dump(Opencore::DumpOption* option) {
             if (flag & FLAG_PID) {
                 if (need_split)
                     output.append("_");
-                output.append(std::to_string(pid));
+                snprintf(number, sizeof(number), "%d", pid);
+                output.append(number);
                 need_split = true;
             }
 
@@ -336,7 +986,8 @@ void Opencore::Dump(Opencore::DumpOption* option) {
             if (flag & FLAG_TID) {
                 if (need_split)
                     output.append("_");
-                output.append(std::to_string(tid));
+                snprintf(number, sizeof(number), "%d", tid);
+                output.append(number);
                 need_split = true;
             }
 
@@ -345,66 +996,407 @@ void Opencore::Dump(Opencore::DumpOption* option) {
                 gettimeofday(&tv, NULL);
                 if (need_split)
                     output.append("_");
-                output.append(std::to_string(tv.tv_sec));
+                snprintf(number, sizeof(number), "%" PRId64, (int64_t)tv.tv_sec);
+                output.append(number);
             }
         } else {
             output.append(option->filename);
         }
+    }
 
-        ori_dumpable = prctl(PR_GET_DUMPABLE);
-        if (!prctl(PR_SET_DUMPABLE, 1))
-            need_restore_dumpable = true;
+    FileSink file(output.c_str());
+    setSink(option->sink ? option->sink : &file);
 
-        if (!prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY))
-            need_restore_ptrace = true;
+    __atomic_fetch_add(&g_dumps_running, 1, __ATOMIC_ACQ_REL);
+    BeginTraceable();
+    bool done = Coredump(output.c_str());
+    EndTraceable();
+    __atomic_fetch_sub(&g_dumps_running, 1, __ATOMIC_ACQ_REL);
+    setSink(nullptr);
+    setFilter(saved_filter);
 
-        impl->Coredump(output.c_str());
+    DumpCallback callback = getCallback();
+    if (callback) callback(output.c_str());
+    return done;
+}
 
-        if (need_restore_dumpable) prctl(PR_SET_DUMPABLE, ori_dumpable);
-        if (need_restore_ptrace) prctl(PR_SET_PTRACER, 0);
+// module basename and file offset of addr, so ASLR does not split signatures
+static uint64_t HashModuleOffset(uint64_t hash, Opencore::VirtualMemoryArea& vma, uint64_t addr) {
+    const char* file = vma.file.c_str();
+    const char* name = strrchr(file, '/');
+    name = name ? name + 1 : file;
+    uint64_t offset = addr - vma.begin + vma.offset;
+    hash = SignatureHash(hash, name, strlen(name));
+    return SignatureHash(hash, &offset, sizeof(offset));
+}
 
-        DumpCallback callback = impl->getCallback();
-        if (callback) callback(output.c_str());
-    } else {
-        JNI_LOGI("Not support coredump!!");
+/*
+ * Signal number, fault page and the faulting module offset, followed by
+ * the first return addresses found on the stack. No unwinder here, any
+ * stack word landing in an executable mapping counts as a frame, which
+ * is stable enough to tell one crash from another.
+ */
+uint64_t Opencore::CrashSignature(Opencore::DumpOption* option) {
+    siginfo_t* info = (siginfo_t *)option->siginfo;
+    uint64_t hash = SIGNATURE_SEED;
+    uint32_t signo = info->si_signo;
+    hash = SignatureHash(hash, &signo, sizeof(signo));
+    if (info->si_code > 0) {
+        uint64_t page = (uint64_t)info->si_addr & ~((uint64_t)sysconf(_SC_PAGE_SIZE) - 1);
+        hash = SignatureHash(hash, &page, sizeof(page));
+    }
+
+    uint64_t pc, sp;
+    if (!option->context || !getContextPcSp(option->context, &pc, &sp))
+        return hash;
+
+    ArenaVector<VirtualMemoryArea> vmas;
+    ParseMaps(getpid(), vmas);
+
+    int index = FindVma(vmas, pc);
+    if (index >= 0)
+        hash = HashModuleOffset(hash, vmas[index], pc);
+
+    index = FindVma(vmas, sp);
+    if (index < 0 || vmas[index].flags[0] != 'r')
+        return hash;
+
+    // the stack is our own, words are native pointers
+    uint64_t end = vmas[index].end;
+    uint64_t limit = sp + SIGNATURE_STACK_WORDS * sizeof(uintptr_t);
+    if (end > limit) end = limit;
+
+    int frames = 0;
+    for (uint64_t addr = sp & ~(sizeof(uintptr_t) - 1);
+            addr + sizeof(uintptr_t) <= end && frames < SIGNATURE_FRAMES;
+            addr += sizeof(uintptr_t)) {
+        uint64_t value = *(uintptr_t *)addr;
+        int exec = FindVma(vmas, value);
+        if (exec < 0 || vmas[exec].flags[2] != 'x')
+            continue;
+        hash = HashModuleOffset(hash, vmas[exec], value);
+        frames++;
+    }
+    return hash;
+}
+
+int Opencore::CheckCrashRepeat(Opencore::DumpOption* option) {
+    if (getRepeatPolicy() == REPEAT_FULL
+            && !getSignatureLimit() && !getGlobalLimit())
+        return REPEAT_FULL;
+
+    CrashStore store;
+    if (!store.Open(getDir().c_str()))
+        return REPEAT_FULL;
+
+    uint64_t signature = CrashSignature(option);
+    uint64_t now = time(nullptr);
+    CrashStore::Header& header = store.getHeader();
+    CrashStore::Entry* entry = store.Find(signature);
+    bool repeat = entry != nullptr;
+    if (!entry)
+        entry = store.Add(signature, now);
+
+    entry->seen++;
+    entry->last = now;
+    if (now - entry->window_start >= DEF_RATE_WINDOW) {
+        entry->window_start = now;
+        entry->window_dumps = 0;
+    }
+    if (now - header.window_start >= DEF_RATE_WINDOW) {
+        header.window_start = now;
+        header.window_dumps = 0;
+    }
+
+    int action = repeat ? getRepeatPolicy() : REPEAT_FULL;
+    if (getSignatureLimit() && entry->window_dumps >= (uint32_t)getSignatureLimit())
+        action = REPEAT_SKIP;
+    if (getGlobalLimit() && header.window_dumps >= (uint32_t)getGlobalLimit())
+        action = REPEAT_SKIP;
+
+    if (action != REPEAT_SKIP) {
+        entry->dumps++;
+        entry->window_dumps++;
+        header.window_dumps++;
+    }
+    store.Save();
+
+    JNI_LOGI("Crash signature %016" PRIx64 ", seen %u times, action %d.",
+             signature, entry->seen, action);
+    return action;
+}
+
+// total stall time (us) of /proc/pressure/memory, zero without PSI
+static void ReadMemoryPressure(uint64_t* some, uint64_t* full) {
+    LineReader reader;
+    char* line;
+    *some = 0;
+    *full = 0;
+    if (!reader.Open("/proc/pressure/memory"))
+        return;
+
+    while ((line = reader.Next())) {
+        const char* total = strstr(line, "total=");
+        if (!total)
+            continue;
+
+        uint64_t value = strtoull(total + 6, nullptr, 10);
+        if (!strncmp(line, "some", 4)) {
+            *some = value;
+        } else if (!strncmp(line, "full", 4)) {
+            *full = value;
+        }
     }
 }
 
 bool Opencore::Coredump(const char* filename) {
+    LockTarget(getPid());
+    BeginStats();
     pid_t child = fork();
     if (child == 0) {
+        running = this;
+        BeginChildStats();
         IgnoreHandler();
         signal(SIGALRM, Opencore::TimeoutHandle);
         alarm(getTimeout());
-        DoCoredump(filename);
+        dump_start = NowMs();
+
+        struct timeval start, end;
+        uint64_t some, full, end_some, end_full;
+        ReadMemoryPressure(&some, &full);
+        gettimeofday(&start, NULL);
+        PrepareIncremental();
+        PrepareBaseline();
+        BeginWorkingSet();
+        bool done = DoCoredump(filename);
+        gettimeofday(&end, NULL);
+        ReadMemoryPressure(&end_some, &end_full);
+        JNI_LOGI("Coredump %" PRId64 " ms, swap policy %d, memory stall some %" PRIu64 " us, full %" PRIu64 " us.",
+                 (int64_t)(end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000,
+                 getSwapPolicy(), end_some - some, end_full - full);
+
+        // threads are still stopped, the next delta starts exactly here
+        int code = 0;
+        // only a named core can be the parent of the next delta
+        if (done && getIncremental() && getSink()->Path()
+                && ClearRefs(getPid(), CLEAR_REFS_SOFT_DIRTY))
+            code = incr_delta ? INCR_EXIT_DELTA : INCR_EXIT_BASE;
+
         Finish();
-        _exit(0);
+        FinishStats();
+        _exit(code);
     } else {
         JNI_LOGI("Wait (%d) coredump", child);
         int status = 0;
-        wait(&status);
+        // only our own child, other sessions may be dumping too
+        waitpid(child, &status, 0);
+        UpdateIncremental(filename, status);
+    }
+    UnlockTarget(getPid());
+
+    if (stats) {
+        stats->total = NowUs() - stats_start;
+        pthread_mutex_lock(&g_stats_lock);
+        g_last_stats = *stats;
+        g_has_stats = true;
+        pthread_mutex_unlock(&g_stats_lock);
+        munmap(stats, sizeof(DumpStats));
+        stats = nullptr;
     }
     return true;
 }
 
+void Opencore::BeginStats() {
+    // written by the dumper child, read back here after waitpid
+    void* page = mmap(nullptr, sizeof(DumpStats), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    stats = page != MAP_FAILED ? (DumpStats *)page : nullptr;
+    freeze_start = 0;
+}
+
+// kB value of a /proc/self/status field, 0 when missing
+static uint64_t ReadStatusKb(const char* field) {
+    LineReader reader;
+    char* line;
+    int len = strlen(field);
+    if (!reader.Open("/proc/self/status"))
+        return 0;
+    while ((line = reader.Next())) {
+        if (!strncmp(line, field, len))
+            return strtoull(line + len, nullptr, 10);
+    }
+    return 0;
+}
+
+void Opencore::BeginChildStats() {
+    if (!stats)
+        return;
+    // the fork starts out with the app's rss and high water mark, only
+    // growth from here on is the dumper's own
+    ClearRefs(getpid(), CLEAR_REFS_PEAK_RSS);
+    stats->peak_rss_kb = ReadStatusKb("VmRSS:");
+}
+
+void Opencore::MarkFirstByte(uint32_t segments) {
+    if (!stats)
+        return;
+    stats->first_byte = NowUs() - stats_start;
+    stats->segments = segments;
+}
+
+void Opencore::MarkWritten(uint64_t bytes) {
+    if (stats)
+        stats->bytes = bytes;
+}
+
+void Opencore::FinishStats() {
+    if (!stats)
+        return;
+
+    // syscr/syscw count every read and write family call of the dumper
+    LineReader reader;
+    char* line;
+    if (reader.Open("/proc/self/io")) {
+        while ((line = reader.Next())) {
+            if (!strncmp(line, "syscr:", 6))
+                stats->read_syscalls = strtoull(line + 6, nullptr, 10);
+            else if (!strncmp(line, "syscw:", 6))
+                stats->write_syscalls = strtoull(line + 6, nullptr, 10);
+        }
+    }
+
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+        stats->minor_faults = usage.ru_minflt;
+        stats->major_faults = usage.ru_majflt;
+    }
+
+    // ru_maxrss of a fork counts the parent's rss too
+    uint64_t base = stats->peak_rss_kb;
+    uint64_t hwm = ReadStatusKb("VmHWM:");
+    stats->peak_rss_kb = hwm > base ? hwm - base : 0;
+}
+
+bool Opencore::GetLastStats(Opencore::DumpStats* out) {
+    pthread_mutex_lock(&g_stats_lock);
+    bool has = g_has_stats;
+    if (has)
+        *out = g_last_stats;
+    pthread_mutex_unlock(&g_stats_lock);
+    return has;
+}
+
+std::string Opencore::GetLastStatsJson() {
+    std::string json;
+    DumpStats last;
+    if (!GetLastStats(&last))
+        return json;
+
+    char buf[512];
+    uint64_t mbps = last.total ? last.bytes * 1000000 / last.total / (1 << 20) : 0;
+    snprintf(buf, sizeof(buf),
+             "{\"freeze_us\":%" PRIu64 ",\"first_byte_us\":%" PRIu64 ",\"total_us\":%" PRIu64 ","
+             "\"bytes\":%" PRIu64 ",\"mb_per_s\":%" PRIu64 ",\"read_syscalls\":%" PRIu64 ","
+             "\"write_syscalls\":%" PRIu64 ",\"minor_faults\":%" PRIu64 ",\"major_faults\":%" PRIu64 ","
+             "\"peak_rss_kb\":%" PRIu64 ",\"threads\":%u,\"segments\":%u}",
+             last.freeze, last.first_byte, last.total, last.bytes, mbps,
+             last.read_syscalls, last.write_syscalls, last.minor_faults, last.major_faults,
+             last.peak_rss_kb, last.threads, last.segments);
+    json.assign(buf);
+    return json;
+}
+
+bool Opencore::Coreplan(std::string& json, bool measure) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        JNI_LOGE("pipe: %s", strerror(errno));
+        return false;
+    }
+
+    LockTarget(getPid());
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        running = this;
+        IgnoreHandler();
+        signal(SIGALRM, Opencore::TimeoutHandle);
+        alarm(getTimeout());
+
+        std::string out;
+        if (DoPlan(out, measure)) {
+            const char* pos = out.c_str();
+            uint64_t left = out.length();
+            while (left) {
+                int ret = write(fds[1], pos, left);
+                if (ret <= 0)
+                    break;
+                pos += ret;
+                left -= ret;
+            }
+        }
+        close(fds[1]);
+        Finish();
+        _exit(0);
+    } else if (child < 0) {
+        UnlockTarget(getPid());
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    close(fds[1]);
+    char buf[4096];
+    int ret;
+    while ((ret = read(fds[0], buf, sizeof(buf))) > 0)
+        json.append(buf, ret);
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    UnlockTarget(getPid());
+    return !json.empty();
+}
+
 void Opencore::Finish() {
     Continue();
     maps.clear();
+    smaps.clear();
+    notes.clear();
+    note_arena.Clear();
+    pagemap.Close();
+    swap_included = 0;
+    swap_skipped.clear();
+    file_elided = 0;
+    dirty_pages = 0;
+    incr_delta = false;
+    if (baseline_map.IsOpen())
+        JNI_LOGI("Baseline %d, %" PRIu64 " shared pages omitted.", baseline_pid, baseline_shared);
+    baseline_map.Close();
+    baseline_shared = 0;
+    ws_mode = WS_NONE;
+    ws_records.clear();
+    degraded = false;
+    load_start = 0;
+    load_total = 0;
+    load_done = 0;
+    if (idle_fd >= 0) {
+        close(idle_fd);
+        idle_fd = -1;
+    }
+    CloseCopyFile();
+    dedup_store.Close();
+    if (file_copied)
+        JNI_LOGI("Copy %" PRIu64 " bytes of clean file pages from disk.", file_copied);
+    file_copied = 0;
+    copy_flags = COPY_CLONE | COPY_RANGE;
     setContext(nullptr);
     setSignalInfo(nullptr);
 }
 
 int Opencore::IsFilterSegment(Opencore::VirtualMemoryArea& vma) {
     int filter = getFilter();
-    if (filter & FILTER_SPECIAL_VMA) {
-        if (vma.file == "/dev/binderfs/hwbinder"
-                || vma.file == "/dev/binderfs/binder"
-                || vma.file == "[vvar]"
-                || vma.file == "/dev/mali0"
-           ) {
-            return VMA_NULL;
-        }
-    }
+    if (IsExcludedSegment(vma))
+        return VMA_NULL;
 
     if (filter & FILTER_FILE_VMA) {
         if (vma.inode > 0 && vma.flags[1] == '-')
@@ -433,103 +1425,1473 @@ int Opencore::IsFilterSegment(Opencore::VirtualMemoryArea& vma) {
             return VMA_NULL;
     }
 
-    if (filter & FILTER_JIT_CACHE_VMA) {
-        if (vma.file.compare(0, 10, "/memfd:jit") == 0)
+    if (filter & (FILTER_JIT_CACHE_VMA | FILTER_JIT_CACHE_PC)) {
+        // FILTER_JIT_CACHE_PC pages were selected by CreateJitRetention
+        if (IsJitCache(vma))
+            return VMA_NULL;
+    }
+
+    if (filter & FILTER_NON_RESIDENT_VMA) {
+        if ((vma.vmflags & VMFLAG_SMAPS) && !vma.rss && !vma.swap)
             return VMA_NULL;
     }
     return VMA_NORMAL;
 }
 
-void Opencore::StopTheWorld(int pid) {
-    char task_dir[32];
-    struct dirent *entry;
-    snprintf(task_dir, sizeof(task_dir), "/proc/%d/task", pid);
-    DIR *dp = opendir(task_dir);
-    if (dp) {
-        while ((entry=readdir(dp)) != NULL) {
-            if (!strncmp(entry->d_name, ".", 1)) {
-                continue;
-            }
+/*
+ * Special and device mappings, never read through /proc/pid/mem, so
+ * minidump pages selected in them do not bring them back either.
+ */
+bool Opencore::IsExcludedSegment(Opencore::VirtualMemoryArea& vma) {
+    int filter = getFilter();
+    if (filter & FILTER_SPECIAL_VMA) {
+        if (vma.file == "/dev/binderfs/hwbinder"
+                || vma.file == "/dev/binderfs/binder"
+                || vma.file == "[vvar]"
+                || vma.file == "/dev/mali0"
+           ) {
+            return true;
+        }
+    }
+
+    if (filter & FILTER_DEVICE_VMA) {
+        // driver mappings, /proc/pid/mem can not read them sanely
+        if (vma.vmflags & (VMFLAG_IO | VMFLAG_PFNMAP | VMFLAG_MIXEDMAP | VMFLAG_DONTDUMP))
+            return true;
+    }
+    return false;
+}
+
+int Opencore::FindVma(uint64_t addr) {
+    return FindVma(maps, addr);
+}
 
-            pid_t tid = std::atoi(entry->d_name);
-            Opencore::StopTheThread(tid);
+int Opencore::FindVma(ArenaVector<VirtualMemoryArea>& vmas, uint64_t addr) {
+    int left = 0;
+    int right = (int)vmas.size() - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        if (addr < vmas[mid].begin) {
+            right = mid - 1;
+        } else if (addr >= vmas[mid].end) {
+            left = mid + 1;
+        } else {
+            return mid;
         }
-        closedir(dp);
     }
+    return -1;
 }
 
-bool Opencore::StopTheThread(int tid) {
-    ThreadRecord ts = {
-        .pid = tid,
-        .attached = false,
-    };
-    if (ptrace(PTRACE_ATTACH, tid, NULL, 0) < 0) {
-        threads.push_back(ts);
+bool Opencore::IncludePages(int index, uint64_t begin, uint64_t end) {
+    Opencore::VirtualMemoryArea& vma = maps[index];
+    if (begin < vma.begin) begin = vma.begin;
+    if (end > vma.end) end = vma.end;
+    if (begin >= end || IsExcludedSegment(vma))
         return false;
-    }
 
-    ts.attached = true;
-    threads.push_back(ts);
+    if (vma.pages.empty())
+        vma.pages.assign((vma.end - vma.begin) / page_size, 0);
 
-    int status = 0;
-    int result = waitpid(tid, &status, WUNTRACED | __WALL);
-    if (result != tid) {
-        JNI_LOGW("waitpid failed on %d while detaching", tid);
+    uint64_t first = (RoundDown(begin, (uint64_t)page_size) - vma.begin) / page_size;
+    uint64_t last = (RoundUp(end, (uint64_t)page_size) - vma.begin) / page_size;
+    for (uint64_t i = first; i < last; ++i)
+        vma.pages[i] = 1;
+    return true;
+}
+
+bool Opencore::IsIncludedPage(int index, uint64_t addr) {
+    Opencore::VirtualMemoryArea& vma = maps[index];
+    if (vma.pages.empty())
         return false;
+    return vma.pages[(addr - vma.begin) / page_size];
+}
+
+void Opencore::CreateMinidumpWindow() {
+    int prnum = getPrNum();
+    if (!prnum)
+        return;
+
+    // window pages around every address held by the top thread registers
+    uint64_t regs[MAX_PR_REGS];
+    uint64_t span = (uint64_t)getPageWindow() * page_size;
+    int regnum = getPrRegs(0, regs);
+    for (int i = 0; i < regnum; ++i) {
+        uint64_t value = regs[i] & PointerScanner::TAG_MASK;
+        int index = FindVma(value);
+        if (index < 0)
+            continue;
+
+        uint64_t addr = RoundDown(value, (uint64_t)page_size);
+        IncludePages(index, addr > span ? addr - span : 0, addr + page_size + span);
     }
-    if (WIFSTOPPED(status)) {
-        int received_signal = 0;
-        if (status >> 16 == PTRACE_EVENT_STOP) {
-            received_signal = 0;
-        } else {
-            received_signal = WSTOPSIG(status);
-        }
-        return true;
+
+    // the live range [sp, end) of every thread stack
+    for (int i = 0; i < prnum; ++i) {
+        uint64_t sp = getPrSp(i);
+        int index = FindVma(sp);
+        if (index < 0)
+            continue;
+
+        IncludePages(index, sp, maps[index].end);
     }
-    JNI_LOGW("waitpid failed on %d while non-stop, status 0x%x", tid, status);
-    return false;
 }
 
-void Opencore::Continue() {
-    for (int index = 0; index < threads.size(); index++) {
-        ThreadRecord& ts = threads[index];
-        if (!ts.attached)
+void Opencore::IncludeWindowPages(int index) {
+    if (!getPrNum())
+        return;
+
+    uint64_t regs[MAX_PR_REGS];
+    uint64_t span = (uint64_t)getPageWindow() * page_size;
+    int regnum = getPrRegs(0, regs);
+    for (int i = 0; i < regnum; ++i) {
+        uint64_t value = regs[i] & PointerScanner::TAG_MASK;
+        if (value < maps[index].begin || value >= maps[index].end)
             continue;
 
-        pid_t tid = ts.pid;
-        if (ptrace(PTRACE_DETACH, tid, NULL, 0) < 0)
+        uint64_t addr = RoundDown(value, (uint64_t)page_size);
+        IncludePages(index, addr > span ? addr - span : 0, addr + page_size + span);
+    }
+    IncludeStackPages(index);
+}
+
+void Opencore::IncludeStackPages(int index) {
+    int prnum = getPrNum();
+    for (int i = 0; i < prnum; ++i) {
+        uint64_t sp = getPrSp(i);
+        if (sp < maps[index].begin || sp >= maps[index].end)
             continue;
+
+        IncludePages(index, sp, maps[index].end);
     }
-    threads.clear();
 }
 
-void Opencore::ParseMaps(int pid, std::vector<VirtualMemoryArea>& maps) {
+int Opencore::MatchRule(Opencore::VirtualMemoryArea& vma) {
+    if (rules.empty())
+        return VmaRule::ACTION_NONE;
+    return rules.Match(vma.flags, vma.end - vma.begin, vma.inode, vma.file.c_str());
+}
+
+int Opencore::IsRuleFilterSegment(int index) {
+    Opencore::VirtualMemoryArea& vma = maps[index];
+    int action = MatchRule(vma);
+    if (action == VmaRule::ACTION_NONE)
+        return VMA_NORMAL;
+
+    // the matched rule replaces any page selection made by minidump
+    vma.pages.clear();
+    switch (action) {
+        case VmaRule::ACTION_INCLUDE:
+            return VMA_INCLUDE;
+        case VmaRule::ACTION_STACK_TRIM:
+            IncludeStackPages(index);
+            break;
+        case VmaRule::ACTION_PAGE_WINDOW:
+            IncludeWindowPages(index);
+            break;
+    }
+    return vma.pages.empty() ? VMA_NULL : VMA_INCLUDE;
+}
+
+bool Opencore::IsReachRoot(int index) {
+    std::string& roots = getReachRoots();
+    if (roots.empty())
+        return false;
+
+    Opencore::VirtualMemoryArea& vma = maps[index];
+    if (vma.flags[0] != 'r' || vma.flags[1] != 'w')
+        return false;
+
+    // .bss directly follows the writable .data of its library
+    Opencore::VirtualMemoryArea* lib = &vma;
+    if (!vma.inode && index > 0
+            && maps[index - 1].inode
+            && maps[index - 1].end == vma.begin
+            && (vma.file.empty() || vma.file == "[anon:.bss]"))
+        lib = &maps[index - 1];
+
+    if (!lib->inode || lib->flags[1] != 'w')
+        return false;
+
+    const char* name = roots.c_str();
+    while (*name) {
+        const char* split = strchr(name, ',');
+        int len = split ? split - name : strlen(name);
+        if (len > 0 && lib->file.find(name, 0, len) != std::string::npos)
+            return true;
+        if (!split)
+            break;
+        name = split + 1;
+    }
+    return false;
+}
+
+void Opencore::CreateMinidumpReachable() {
+    int prnum = getPrNum();
+    if (!prnum)
+        return;
+
     char filename[32];
-    char line[1024];
+    snprintf(filename, sizeof(filename), "/proc/%d/mem", getPid());
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        JNI_LOGE("open %s fail.", filename);
+        return;
+    }
 
-    snprintf(filename, sizeof(filename), "/proc/%d/maps", pid);
-    FILE *fp = fopen(filename, "r");
-    if (fp) {
-        while (fgets(line, sizeof(line), fp)) {
-            int m;
-            VirtualMemoryArea vma;
-            char filename[256] = {'\0'};
+    // only readable and unfiltered vma can be pointer targets
+    PointerScanner scanner;
+    for (int index = 0; index < maps.size(); ++index) {
+        Opencore::VirtualMemoryArea& vma = maps[index];
+        if (vma.flags[0] != 'r')
+            continue;
 
+        int action = MatchRule(vma);
+        if (action == VmaRule::ACTION_EXCLUDE)
+            continue;
+        if (action == VmaRule::ACTION_NONE && (IsFilterSegment(vma) & VMA_NULL))
+            continue;
+        scanner.AddRange(vma.begin, vma.end);
+    }
 
-            sscanf(line, "%" PRIx64 "-%" PRIx64 " %c%c%c%c %x %x:%x  %" PRIu64 "  %[^\n] %n",
-                   &vma.begin, &vma.end,
-                   &vma.flags[0], &vma.flags[1], &vma.flags[2], &vma.flags[3],
-                   &vma.offset, &vma.major, &vma.minor, &vma.inode, filename, &m);
+    ArenaVector<uint64_t> frontier;
+    ArenaVector<uint64_t> next;
+
+    // roots: every thread registers and live stack, library .data/.bss.
+    // register pages (with the window of the top thread) go in even in
+    // filtered vma, the walk only goes on from scannable ones
+    uint64_t regs[MAX_PR_REGS];
+    uint64_t span = (uint64_t)getPageWindow() * page_size;
+    for (int i = 0; i < prnum; ++i) {
+        int regnum = getPrRegs(i, regs);
+        for (int r = 0; r < regnum; ++r) {
+            uint64_t addr = RoundDown(regs[r] & PointerScanner::TAG_MASK, (uint64_t)page_size);
+            int index = FindVma(addr);
+            if (index < 0 || IsIncludedPage(index, addr))
+                continue;
 
-            vma.file = filename;
+            if (!i)
+                IncludePages(index, addr > span ? addr - span : 0, addr + page_size + span);
+            if (IncludePages(index, addr, addr + page_size) && scanner.Contains(addr))
+                frontier.push_back(addr);
+        }
 
-#if defined(__i386__) || defined(__x86__) || defined(__arm__)
-            // avoid compat32 bit application dump64
-            if (vma.begin > 0xFFFFFFFF)
-                break;
-#endif
-            maps.push_back(vma);
+        uint64_t sp = getPrSp(i);
+        int index = FindVma(sp);
+        if (index < 0)
+            continue;
+
+        for (uint64_t addr = RoundDown(sp, (uint64_t)page_size); addr < maps[index].end; addr += page_size) {
+            if (IsIncludedPage(index, addr))
+                continue;
+
+            if (IncludePages(index, addr, addr + page_size))
+                frontier.push_back(addr);
         }
-        fclose(fp);
     }
+
+    for (int index = 0; index < maps.size(); ++index) {
+        if (!IsReachRoot(index))
+            continue;
+
+        Opencore::VirtualMemoryArea& vma = maps[index];
+        if (!IncludePages(index, vma.begin, vma.end))
+            continue;
+        for (uint64_t addr = vma.begin; addr < vma.end; addr += page_size)
+            frontier.push_back(addr);
+    }
+
+    // breadth first, each level follows pointers found in the previous one
+    uint64_t budget = getReachBudget();
+    uint64_t reached = 0;
+    int depth = 0;
+    int num = page_size / sizeof(uintptr_t);
+    ArenaVector<uintptr_t> words(num);
+    ArenaVector<uintptr_t> found(num);
+    while (depth < getReachDepth() && !frontier.empty() && reached < budget) {
+        next.clear();
+        for (int i = 0; i < frontier.size() && reached < budget; ++i) {
+            if (pread64(fd, words.data(), page_size, frontier[i]) != page_size)
+                continue;
+
+            int count = scanner.Scan(words.data(), num, found.data());
+            for (int k = 0; k < count; ++k) {
+                uint64_t addr = RoundDown((uint64_t)found[k], (uint64_t)page_size);
+                int index = FindVma(addr);
+                if (index < 0 || IsIncludedPage(index, addr))
+                    continue;
+
+                if (reached + page_size > budget) {
+                    reached = budget;
+                    break;
+                }
+
+                if (!IncludePages(index, addr, addr + page_size))
+                    continue;
+                reached += page_size;
+                next.push_back(addr);
+            }
+        }
+        frontier.swap(next);
+        depth++;
+    }
+
+    close(fd);
+    JNI_LOGI("Minidump reachable depth %d, %" PRIu64 " bytes.", depth, reached);
+}
+
+bool Opencore::IsJitCache(Opencore::VirtualMemoryArea& vma) {
+    return vma.file.compare(0, 10, "/memfd:jit") == 0;
+}
+
+void Opencore::IncludeJitPages(int index, uint64_t addr) {
+    // the method header sits right before the code, it may be on the previous page
+    uint64_t page = RoundDown(addr, (uint64_t)page_size);
+    uint64_t begin = page > maps[index].begin ? page - page_size : page;
+    IncludePages(index, begin, page + page_size);
+}
+
+void Opencore::CreateJitRetention() {
+    int prnum = getPrNum();
+    if (!prnum)
+        return;
+
+    // only the executable view holds code addresses
+    PointerScanner scanner;
+    for (int index = 0; index < maps.size(); ++index) {
+        Opencore::VirtualMemoryArea& vma = maps[index];
+        if (vma.flags[2] == 'x' && IsJitCache(vma))
+            scanner.AddRange(vma.begin, vma.end);
+    }
+
+    if (scanner.Empty())
+        return;
+
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/proc/%d/mem", getPid());
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        JNI_LOGE("open %s fail.", filename);
+        return;
+    }
+
+    // pc, lr and any other register of every thread, then return
+    // addresses spilled on the live range [sp, end) of its stack.
+    uint64_t hits = 0;
+    uint64_t regs[MAX_PR_REGS];
+    int num = page_size / sizeof(uintptr_t);
+    ArenaVector<uintptr_t> words(num);
+    ArenaVector<uintptr_t> found(num);
+    for (int i = 0; i < prnum; ++i) {
+        int regnum = getPrRegs(i, regs);
+        for (int r = 0; r < regnum; ++r) {
+            uint64_t value = regs[r] & PointerScanner::TAG_MASK;
+            if (!scanner.Contains(value))
+                continue;
+
+            IncludeJitPages(FindVma(value), value);
+            hits++;
+        }
+
+        uint64_t sp = getPrSp(i);
+        int index = FindVma(sp);
+        if (index < 0)
+            continue;
+
+        for (uint64_t addr = RoundDown(sp, (uint64_t)page_size); addr < maps[index].end; addr += page_size) {
+            if (pread64(fd, words.data(), page_size, addr) != page_size)
+                continue;
+
+            int count = scanner.Scan(words.data(), num, found.data());
+            for (int k = 0; k < count; ++k) {
+                IncludeJitPages(FindVma(found[k]), found[k]);
+                hits++;
+            }
+        }
+    }
+
+    close(fd);
+    JNI_LOGI("Jit cache retention %" PRIu64 " code addresses.", hits);
+}
+
+bool Opencore::StopTheWorld(int pid) {
+    freeze_start = NowUs();
+    char task_dir[32];
+    snprintf(task_dir, sizeof(task_dir), "/proc/%d/task", pid);
+    DirReader reader;
+    if (!reader.Open(task_dir))
+        return false;
+
+    // a thread someone else traces has no registers for us
+    bool held = false;
+    const char* name;
+    while ((name = reader.Next())) {
+        pid_t tid = std::atoi(name);
+        if (!Opencore::StopTheThread(tid)
+                && !threads.back().attached && IsTraced(pid, tid)) {
+            JNI_LOGE("Thread %d is traced by another process.", tid);
+            held = true;
+        }
+    }
+    return !held;
+}
+
+bool Opencore::IsTraced(int pid, int tid) {
+    char filename[64];
+    LineReader reader;
+    char* line;
+    snprintf(filename, sizeof(filename), "/proc/%d/task/%d/status", pid, tid);
+    if (!reader.Open(filename))
+        return false;
+
+    int tracer = 0;
+    while ((line = reader.Next())) {
+        if (!strncmp(line, "TracerPid:", 10)) {
+            tracer = atoi(line + 10);
+            break;
+        }
+    }
+    return tracer > 0;
+}
+
+bool Opencore::StopTheThread(int tid) {
+    ThreadRecord ts = {
+        .pid = tid,
+        .attached = false,
+    };
+    // sessions of this process never overlap on a target, a tracer
+    // still in the way is another process, give it a moment to detach
+    uint64_t give_up = NowMs() + ATTACH_WAIT_MS;
+    while (ptrace(PTRACE_ATTACH, tid, NULL, 0) < 0) {
+        if (errno != EPERM || !IsTraced(getPid(), tid) || NowMs() > give_up) {
+            threads.push_back(ts);
+            return false;
+        }
+        usleep(1000);
+    }
+
+    ts.attached = true;
+    threads.push_back(ts);
+
+    int status = 0;
+    int result = waitpid(tid, &status, WUNTRACED | __WALL);
+    if (result != tid) {
+        JNI_LOGW("waitpid failed on %d while detaching", tid);
+        return false;
+    }
+    if (WIFSTOPPED(status)) {
+        int received_signal = 0;
+        if (status >> 16 == PTRACE_EVENT_STOP) {
+            received_signal = 0;
+        } else {
+            received_signal = WSTOPSIG(status);
+        }
+        return true;
+    }
+    JNI_LOGW("waitpid failed on %d while non-stop, status 0x%x", tid, status);
+    return false;
+}
+
+void Opencore::Continue() {
+    if (stats && freeze_start && threads.size()) {
+        stats->freeze = NowUs() - freeze_start;
+        stats->threads = threads.size();
+    }
+    freeze_start = 0;
+    for (int index = 0; index < threads.size(); index++) {
+        ThreadRecord& ts = threads[index];
+        if (!ts.attached)
+            continue;
+
+        pid_t tid = ts.pid;
+        if (ptrace(PTRACE_DETACH, tid, NULL, 0) < 0)
+            continue;
+    }
+    threads.clear();
+}
+
+void Opencore::ParseMaps(int pid, ArenaVector<VirtualMemoryArea>& maps) {
+    char filename[32];
+    LineReader reader;
+    char* line;
+
+    snprintf(filename, sizeof(filename), "/proc/%d/maps", pid);
+    if (reader.Open(filename)) {
+        while ((line = reader.Next())) {
+            int m;
+            VirtualMemoryArea vma;
+            char filename[256] = {'\0'};
+
+
+            sscanf(line, "%" PRIx64 "-%" PRIx64 " %c%c%c%c %" SCNx64 " %x:%x  %" PRIu64 "  %[^\n] %n",
+                   &vma.begin, &vma.end,
+                   &vma.flags[0], &vma.flags[1], &vma.flags[2], &vma.flags[3],
+                   &vma.offset, &vma.major, &vma.minor, &vma.inode, filename, &m);
+
+            vma.file = filename;
+
+#if defined(__i386__) || defined(__x86__) || defined(__arm__)
+            // avoid compat32 bit application dump64
+            if (vma.begin > 0xFFFFFFFF)
+                break;
+#endif
+            maps.push_back(vma);
+        }
+    }
+}
+
+static uint64_t ParseSmapsKb(const char* pos, const char* end) {
+    uint64_t value = 0;
+    while (pos < end && *pos == ' ')
+        pos++;
+    while (pos < end && *pos >= '0' && *pos <= '9')
+        value = value * 10 + (*pos++ - '0');
+    return value << 10;
+}
+
+static uint64_t ParseSmapsHex(const char** pos, const char* end) {
+    uint64_t value = 0;
+    const char* str = *pos;
+    for (; str < end; ++str) {
+        char c = *str;
+        if (c >= '0' && c <= '9') {
+            value = (value << 4) | (c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            value = (value << 4) | (c - 'a' + 10);
+        } else {
+            break;
+        }
+    }
+    *pos = str;
+    return value;
+}
+
+static uint32_t ParseSmapsVmFlags(const char* pos, const char* end) {
+    uint32_t vmflags = Opencore::VMFLAG_SMAPS;
+    for (; pos + 1 < end; pos += 3) {
+        while (pos < end && *pos == ' ')
+            pos++;
+        if (pos + 1 >= end)
+            break;
+
+        uint16_t name = (pos[0] << 8) | pos[1];
+        switch (name) {
+            case ('i' << 8) | 'o': vmflags |= Opencore::VMFLAG_IO; break;
+            case ('p' << 8) | 'f': vmflags |= Opencore::VMFLAG_PFNMAP; break;
+            case ('d' << 8) | 'd': vmflags |= Opencore::VMFLAG_DONTDUMP; break;
+            case ('m' << 8) | 'm': vmflags |= Opencore::VMFLAG_MIXEDMAP; break;
+        }
+    }
+    return vmflags;
+}
+
+static void ParseSmapsLine(const char* line, const char* end,
+                           ArenaVector<Opencore::VirtualMemoryArea>& smaps) {
+    char c = line[0];
+    if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')) {
+        // "begin-end perms ...", field lines always start with an upper case name
+        Opencore::VirtualMemoryArea vma;
+        const char* pos = line;
+        vma.begin = ParseSmapsHex(&pos, end);
+        if (pos < end && *pos == '-') pos++;
+        vma.end = ParseSmapsHex(&pos, end);
+        smaps.push_back(vma);
+        return;
+    }
+
+    if (smaps.empty())
+        return;
+
+    Opencore::VirtualMemoryArea& vma = smaps.back();
+    int len = end - line;
+    if (len > 4 && !memcmp(line, "Rss:", 4)) {
+        vma.rss = ParseSmapsKb(line + 4, end);
+    } else if (len > 5 && !memcmp(line, "Swap:", 5)) {
+        vma.swap = ParseSmapsKb(line + 5, end);
+    } else if (len > 11 && !memcmp(line, "Referenced:", 11)) {
+        vma.referenced = ParseSmapsKb(line + 11, end);
+    } else if (len > 8 && !memcmp(line, "VmFlags:", 8)) {
+        vma.vmflags = ParseSmapsVmFlags(line + 8, end);
+    }
+}
+
+void Opencore::ParseSmaps(int pid, ArenaVector<VirtualMemoryArea>& smaps) {
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/proc/%d/smaps", pid);
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    // one big read per syscall and hand parsing, smaps is ~20 lines per vma
+    constexpr int kBufSize = 64 * 1024;
+    ArenaVector<char> buffer(kBufSize);
+    char* buf = buffer.data();
+    int len = 0;
+    while (true) {
+        int ret = read(fd, buf + len, kBufSize - len);
+        if (ret <= 0)
+            break;
+        len += ret;
+
+        char* line = buf;
+        char* end = buf + len;
+        while (line < end) {
+            char* nl = (char *)memchr(line, '\n', end - line);
+            if (!nl)
+                break;
+            ParseSmapsLine(line, nl, smaps);
+            line = nl + 1;
+        }
+
+        len = end - line;
+        if (len == kBufSize) {
+            // never happen on sane kernels, drop the overlong line
+            len = 0;
+        } else if (len) {
+            memmove(buf, line, len);
+        }
+    }
+    close(fd);
+
+    // a vma without VmFlags line (very old kernel) is unknown, drop its stats
+    for (int index = 0; index < smaps.size(); ++index) {
+        if (!(smaps[index].vmflags & VMFLAG_SMAPS)) {
+            smaps[index].rss = 0;
+            smaps[index].swap = 0;
+            smaps[index].referenced = 0;
+        }
+    }
+}
+
+void Opencore::ParseProcessSmaps(int pid) {
+    if (!(getFilter() & (FILTER_DEVICE_VMA | FILTER_NON_RESIDENT_VMA)) && ws_mode == WS_NONE)
+        return;
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    ParseSmaps(pid, smaps);
+    gettimeofday(&end, NULL);
+    JNI_LOGI("Parse smaps %zu vma, %" PRId64 " us.", smaps.size(),
+             (int64_t)(end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec));
+}
+
+void Opencore::MergeSmaps() {
+    // both sorted by address, smaps was read before the world stopped,
+    // vma created or resized in between keep VMFLAG_SMAPS clear.
+    int pos = 0;
+    for (int index = 0; index < maps.size() && pos < smaps.size(); ++index) {
+        VirtualMemoryArea& vma = maps[index];
+        while (pos < smaps.size() && smaps[pos].begin < vma.begin)
+            pos++;
+        if (pos == smaps.size())
+            break;
+
+        VirtualMemoryArea& info = smaps[pos];
+        if (info.begin == vma.begin && info.end == vma.end) {
+            vma.rss = info.rss;
+            vma.swap = info.swap;
+            vma.referenced = info.referenced;
+            vma.vmflags = info.vmflags;
+        }
+    }
+    smaps.clear();
+}
+
+bool Opencore::IsCleanFileCandidate(VirtualMemoryArea& vma) {
+    if (!vma.inode || (vma.flags[3] != 'p' && vma.flags[3] != 'P'))
+        return false;
+
+    // the debugger must be able to open the same file again
+    if (vma.file.empty() || vma.file[0] != '/'
+            || vma.file.compare(0, 5, "/dev/") == 0
+            || vma.file.compare(0, 7, "/memfd:") == 0
+            || vma.file.find(" (deleted)") != std::string::npos)
+        return false;
+    return true;
+}
+
+void Opencore::FilterPages(int index) {
+    VirtualMemoryArea& vma = maps[index];
+    bool file_pages = (getFilter() & FILTER_CLEAN_FILE_PAGE) && IsCleanFileCandidate(vma);
+    bool swap_pages = getSwapPolicy() != SWAP_INCLUDE;
+    bool baseline_pages = baseline_map.IsOpen();
+    bool ws_pages = ws_mode != WS_NONE;
+    if (!file_pages && !swap_pages && !incr_delta && !baseline_pages && !ws_pages)
+        return;
+
+    if (!pagemap.Open(getPid()))
+        return;
+
+    ArenaVector<uint64_t> entries;
+    if (!pagemap.Read(vma.begin, vma.end, entries))
+        return;
+
+    if (file_pages)
+        FilterFilePages(index, entries);
+
+    if (incr_delta)
+        FilterDirtyPages(index, entries);
+
+    if (baseline_pages)
+        FilterBaselinePages(index, entries);
+
+    if (ws_pages)
+        FilterWorkingSetPages(index, entries);
+
+    if (swap_pages)
+        FilterSwapPages(index, entries);
+}
+
+void Opencore::FilterFilePages(int index, ArenaVector<uint64_t>& entries) {
+    VirtualMemoryArea& vma = maps[index];
+    for (uint64_t i = 0; i < entries.size(); ++i) {
+        // a cow copied page is anonymous: present without PM_FILE, or swapped.
+        // everything else still equals the file content at its NT_FILE offset.
+        uint64_t entry = entries[i];
+        if ((entry & PageMap::PM_SWAP)
+                || ((entry & PageMap::PM_PRESENT) && !(entry & PageMap::PM_FILE)))
+            continue;
+
+        if (!vma.pages.empty() && !vma.pages[i])
+            continue;
+
+        if (vma.pages.empty())
+            vma.pages.assign(entries.size(), 1);
+        vma.pages[i] = 0;
+        file_elided += page_size;
+    }
+}
+
+void Opencore::FilterSwapPages(int index, ArenaVector<uint64_t>& entries) {
+    VirtualMemoryArea& vma = maps[index];
+    int policy = getSwapPolicy();
+    for (uint64_t i = 0; i < entries.size(); ++i) {
+        if ((entries[i] & (PageMap::PM_SWAP | PageMap::PM_PRESENT)) != PageMap::PM_SWAP)
+            continue;
+
+        if (!vma.pages.empty() && !vma.pages[i])
+            continue;
+
+        // reading a swapped page faults it back in, keep it while budget left
+        if (policy == SWAP_BUDGET && swap_included + page_size <= getSwapBudget()) {
+            swap_included += page_size;
+            continue;
+        }
+
+        if (vma.pages.empty())
+            vma.pages.assign(entries.size(), 1);
+        vma.pages[i] = 0;
+
+        uint64_t addr = vma.begin + i * page_size;
+        if (!swap_skipped.empty() && swap_skipped.back() == addr) {
+            swap_skipped.back() = addr + page_size;
+        } else {
+            swap_skipped.push_back(addr);
+            swap_skipped.push_back(addr + page_size);
+        }
+    }
+}
+
+void Opencore::FilterDirtyPages(int index, ArenaVector<uint64_t>& entries) {
+    VirtualMemoryArea& vma = maps[index];
+    for (uint64_t i = 0; i < entries.size(); ++i) {
+        if (!vma.pages.empty() && !vma.pages[i])
+            continue;
+
+        if (entries[i] & PageMap::PM_SOFT_DIRTY) {
+            dirty_pages++;
+            continue;
+        }
+
+        // unchanged since the previous dump of the chain
+        if (vma.pages.empty())
+            vma.pages.assign(entries.size(), 1);
+        vma.pages[i] = 0;
+    }
+}
+
+void Opencore::CreatePageFilterNote() {
+    if (incr_delta)
+        JNI_LOGI("Incremental #%d, %" PRIu64 " dirty pages.", incr_seq + 1, dirty_pages);
+
+    if (getFilter() & FILTER_CLEAN_FILE_PAGE)
+        JNI_LOGI("Elide %" PRIu64 " bytes clean file pages.", file_elided);
+
+    if (ws_mode != WS_NONE) {
+        uint64_t resident = 0;
+        uint64_t accessed = 0;
+        for (int i = 0; i < ws_records.size(); i += 5) {
+            resident += ws_records[i + 2];
+            accessed += ws_records[i + 3];
+        }
+        JNI_LOGI("Working set mode %d, %" PRIu64 " of %" PRIu64 " resident pages accessed.",
+                 ws_mode, accessed, resident);
+
+        ArenaVector<uint8_t> desc(4 * sizeof(uint32_t) + ws_records.size() * sizeof(uint64_t));
+        uint32_t head[4] = { 1, (uint32_t)ws_mode, (uint32_t)getWorkingSet(), page_size };
+        memcpy(desc.data(), head, sizeof(head));
+        if (!ws_records.empty())
+            memcpy(desc.data() + sizeof(head), ws_records.data(), ws_records.size() * sizeof(uint64_t));
+        AddExtraNote(NT_OPENCORE_WORKINGSET, desc.data(), desc.size());
+    }
+
+    if (getSwapPolicy() == SWAP_INCLUDE)
+        return;
+
+    uint64_t skipped = 0;
+    for (int i = 0; i < swap_skipped.size(); i += 2)
+        skipped += swap_skipped[i + 1] - swap_skipped[i];
+
+    JNI_LOGI("Swap policy %d, included %" PRIu64 " bytes, skipped %zu ranges %" PRIu64 " bytes.",
+             getSwapPolicy(), swap_included, swap_skipped.size() / 2, skipped);
+
+    if (!swap_skipped.empty())
+        AddExtraNote(NT_OPENCORE_SWAP, swap_skipped.data(), swap_skipped.size() * sizeof(uint64_t));
+}
+
+void Opencore::CreateCrashNote() {
+    // records are filled by the crashing process after this child forked,
+    // read them from its memory now that every thread is stopped
+    if (!getSignalInfo())
+        return;
+
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/proc/%d/mem", getPid());
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    uint32_t count = 0;
+    uint32_t ready[MAX_CRASH_RECORDS];
+    pread64(fd, &count, sizeof(count), (uintptr_t)&g_crash_count);
+    if (count > MAX_CRASH_RECORDS)
+        count = MAX_CRASH_RECORDS;
+    if (!count || pread64(fd, ready, sizeof(ready), (uintptr_t)g_crash_ready) != sizeof(ready)) {
+        close(fd);
+        return;
+    }
+
+    uint32_t head[2] = { 1, 0 };
+    ArenaVector<uint8_t> desc(sizeof(head));
+    for (uint32_t i = 0; i < count; ++i) {
+        CrashRecord record;
+        if (!ready[i] || pread64(fd, &record, sizeof(record),
+                                 (uintptr_t)&g_crash_records[i]) != sizeof(record))
+            continue;
+        const uint8_t* p = (const uint8_t *)&record;
+        desc.insert(desc.end(), p, p + sizeof(record));
+        head[1]++;
+    }
+    close(fd);
+
+    if (!head[1])
+        return;
+
+    memcpy(desc.data(), head, sizeof(head));
+    AddExtraNote(NT_OPENCORE_CRASHES, desc.data(), desc.size());
+    JNI_LOGI("Coalesced %u faults of other threads.", head[1]);
+}
+
+void Opencore::AddExtraNote(uint32_t type, const void* desc, uint32_t size) {
+    ExtraNote note;
+    note.type = type;
+    note.desc.assign((const uint8_t *)desc, (const uint8_t *)desc + size);
+    notes.push_back(note);
+}
+
+void Opencore::BuildExtraNotes() {
+    for (int index = 0; index < notes.size(); ++index) {
+        ExtraNote& note = notes[index];
+        note_arena.Append(ELFOPENCOREMAGIC, note.type, note.desc.data(), note.desc.size());
+    }
+}
+
+void Opencore::CloseCopyFile() {
+    if (copy_fd >= 0)
+        close(copy_fd);
+    copy_fd = -1;
+    copy_index = -1;
+    copy_entries.clear();
+}
+
+uint64_t Opencore::CopyFilePages(OutputSink* sink, uint64_t addr, uint64_t size) {
+    // in kernel copies need a file to land in
+    if (!copy_flags || dedup_store.IsOpen() || !sink->IsSeekable() || sink->Fd() < 0)
+        return 0;
+
+    int index = FindVma(addr);
+    if (index < 0)
+        return 0;
+
+    VirtualMemoryArea& vma = maps[index];
+    if (index != copy_index) {
+        CloseCopyFile();
+        copy_index = index;
+        if (!IsCleanFileCandidate(vma) || !pagemap.Open(getPid()))
+            return 0;
+
+        if (!pagemap.Read(vma.begin, vma.end, copy_entries))
+            return 0;
+
+        // the path may have been replaced since it was mapped
+        int fd = open(vma.file.c_str(), O_RDONLY);
+        if (fd < 0)
+            return 0;
+
+        struct stat sb;
+        if (fstat(fd, &sb) < 0 || sb.st_ino != vma.inode
+                || major(sb.st_dev) != vma.major || minor(sb.st_dev) != vma.minor) {
+            close(fd);
+            return 0;
+        }
+        copy_fd = fd;
+    }
+
+    if (copy_fd < 0)
+        return 0;
+
+    if (addr + size > vma.end)
+        size = vma.end - addr;
+
+    // run of pages never cow copied, see FilterFilePages
+    uint64_t first = (addr - vma.begin) / page_size;
+    uint64_t last = first + size / page_size;
+    uint64_t pos = first;
+    for (; pos < last; ++pos) {
+        uint64_t entry = copy_entries[pos];
+        if ((entry & PageMap::PM_SWAP)
+                || ((entry & PageMap::PM_PRESENT) && !(entry & PageMap::PM_FILE)))
+            break;
+    }
+
+    uint64_t len = (pos - first) * page_size;
+    if (!len)
+        return 0;
+
+    if (!sink->Flush())
+        return 0;
+    int out = sink->Fd();
+    uint64_t dst = sink->Offset();
+
+    uint64_t done = 0;
+#ifdef FICLONERANGE
+    if (copy_flags & COPY_CLONE) {
+        struct file_clone_range range = {
+            .src_fd = copy_fd,
+            .src_offset = vma.offset + (addr - vma.begin),
+            .src_length = len,
+            .dest_offset = (uint64_t)dst,
+        };
+        if (!ioctl(out, FICLONERANGE, &range)) {
+            done = len;
+        } else {
+            copy_flags &= ~COPY_CLONE;
+        }
+    }
+#endif
+
+    if (!done && (copy_flags & COPY_RANGE)) {
+        loff_t src_off = vma.offset + (addr - vma.begin);
+        loff_t dst_off = dst;
+        while (done < len) {
+            long ret = syscall(__NR_copy_file_range, copy_fd, &src_off, out, &dst_off, len - done, 0);
+            if (ret < 0) {
+                // EXDEV, ENOSYS, EINVAL... not worth retrying for this dump
+                if (errno != EINTR && errno != EAGAIN)
+                    copy_flags &= ~COPY_RANGE;
+                break;
+            }
+            if (!ret)
+                break;
+            done += ret;
+        }
+    }
+
+    // a short copy at file end leaves the tail page to the memory path
+    done = RoundDown(done, (uint64_t)page_size);
+    if (done)
+        sink->Seek(dst + done);
+    file_copied += done;
+    return done;
+}
+
+void Opencore::BeginDedup(const char* filename) {
+    if (!getDedup() || !dedup_store.Open(filename, align_size))
+        return;
+
+    const char* name = strrchr(filename, '/');
+    ArenaString pages = name ? name + 1 : filename;
+    pages.append(DedupStore::PAGES_SUFFIX);
+    AddExtraNote(NT_OPENCORE_DEDUP, pages.c_str(), pages.length() + 1);
+}
+
+void Opencore::setIncremental(bool enable) {
+    // any change starts a new chain with a full base dump
+    incremental = enable;
+    incr_base.clear();
+    incr_last.clear();
+    incr_links.clear();
+    incr_seq = 0;
+}
+
+uint64_t Opencore::ProbeSelfPage() {
+    // write a page of our own and read back its pagemap entry
+    static volatile uint64_t probe;
+    probe++;
+
+    PageMap self;
+    ArenaVector<uint64_t> entries;
+    uint64_t page = RoundDown((uint64_t)(uintptr_t)&probe, (uint64_t)sysconf(_SC_PAGE_SIZE));
+    if (!self.Open(getpid()) || !self.Read(page, page + sysconf(_SC_PAGE_SIZE), entries))
+        return 0;
+    return entries[0];
+}
+
+bool Opencore::IsSoftDirtySupported() {
+    // without CONFIG_MEM_SOFT_DIRTY clear_refs 4 is accepted but bit 55
+    // never shows up, probe it on our own (forked child) page.
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0)
+        return false;
+    bool cleared = write(fd, "4", 1) == 1;
+    close(fd);
+    if (!cleared)
+        return false;
+
+    return ProbeSelfPage() & PageMap::PM_SOFT_DIRTY;
+}
+
+bool Opencore::ClearRefs(int pid, const char* mode) {
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/proc/%d/clear_refs", pid);
+    int fd = open(filename, O_WRONLY);
+    if (fd < 0) {
+        JNI_LOGW("open %s: %s", filename, strerror(errno));
+        return false;
+    }
+    bool ret = write(fd, mode, strlen(mode)) == strlen(mode);
+    if (!ret)
+        JNI_LOGW("write %s: %s", filename, strerror(errno));
+    close(fd);
+    return ret;
+}
+
+void Opencore::PrepareIncremental() {
+    incr_delta = false;
+    if (!getIncremental() || incr_base.empty() || !getSink()->Path())
+        return;
+
+    // a delta is useless once its base or parent is gone
+    if (access(incr_base.c_str(), F_OK) || access(incr_last.c_str(), F_OK))
+        return;
+
+    if (!IsSoftDirtySupported()) {
+        JNI_LOGW("Soft dirty not supported, full dump.");
+        return;
+    }
+
+    incr_delta = true;
+    const char* base = strrchr(incr_base.c_str(), '/');
+    const char* last = strrchr(incr_last.c_str(), '/');
+    ArenaString names = base ? base + 1 : incr_base.c_str();
+    names.push_back('\0');
+    names.append(last ? last + 1 : incr_last.c_str());
+    names.push_back('\0');
+
+    ArenaVector<uint8_t> desc(2 * sizeof(uint32_t) + names.length());
+    uint32_t head[2] = { 1, (uint32_t)(incr_seq + 1) };
+    memcpy(desc.data(), head, sizeof(head));
+    memcpy(desc.data() + sizeof(head), names.data(), names.length());
+    AddExtraNote(NT_OPENCORE_INCREMENTAL, desc.data(), desc.size());
+}
+
+void Opencore::UpdateIncremental(const char* filename, int status) {
+    if (!getIncremental())
+        return;
+
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    if (code == INCR_EXIT_BASE) {
+        incr_base = filename;
+        incr_last = filename;
+        incr_links.clear();
+        incr_links.push_back(filename);
+        incr_seq = 0;
+    } else if (code == INCR_EXIT_DELTA) {
+        incr_last = filename;
+        incr_links.push_back(filename);
+        incr_seq++;
+    } else {
+        incr_base.clear();
+        incr_last.clear();
+        incr_links.clear();
+        incr_seq = 0;
+    }
+}
+
+void Opencore::ListKeptCores(ArenaVector<ArenaString>& names) {
+    for (ArenaString& link : incr_links)
+        names.push_back(link);
+    if (getBaselineCore().length() > 0)
+        names.push_back(getBaselineCore().c_str());
+}
+
+void Opencore::GetKeptCores(ArenaVector<ArenaString>& names) {
+    Opencore* impl = GetInstance();
+    if (!impl)
+        return;
+    pthread_mutex_lock(&g_chain_lock);
+    impl->ListKeptCores(names);
+    pthread_mutex_unlock(&g_chain_lock);
+}
+
+bool Opencore::IsPfnVisible() {
+    uint64_t entry = ProbeSelfPage();
+    return (entry & PageMap::PM_PRESENT) && (entry & PageMap::PM_PFN_MASK);
+}
+
+void Opencore::PrepareBaseline() {
+    if (getBaselinePid() <= 0)
+        return;
+
+    // same frame at the same address is the same page, only pfn proves it.
+    // PM_MMAP_EXCLUSIVE can't stand in, our own fork shares every page.
+    if (!IsPfnVisible()) {
+        JNI_LOGW("Baseline needs pagemap pfn (CAP_SYS_ADMIN), full dump.");
+        return;
+    }
+
+    if (!baseline_map.Open(getBaselinePid()))
+        return;
+
+    std::string& core = getBaselineCore();
+    ArenaVector<uint8_t> desc(2 * sizeof(uint32_t) + core.length() + 1);
+    uint32_t head[2] = { 1, (uint32_t)getBaselinePid() };
+    memcpy(desc.data(), head, sizeof(head));
+    memcpy(desc.data() + sizeof(head), core.c_str(), core.length() + 1);
+    AddExtraNote(NT_OPENCORE_BASELINE, desc.data(), desc.size());
+}
+
+void Opencore::FilterBaselinePages(int index, ArenaVector<uint64_t>& entries) {
+    VirtualMemoryArea& vma = maps[index];
+    ArenaVector<uint64_t> baseline;
+    if (!baseline_map.Read(vma.begin, vma.end, baseline))
+        return;
+
+    for (uint64_t i = 0; i < entries.size(); ++i) {
+        if (!vma.pages.empty() && !vma.pages[i])
+            continue;
+
+        if (!(entries[i] & PageMap::PM_PRESENT) || !(baseline[i] & PageMap::PM_PRESENT))
+            continue;
+
+        uint64_t pfn = entries[i] & PageMap::PM_PFN_MASK;
+        if (!pfn || pfn != (baseline[i] & PageMap::PM_PFN_MASK))
+            continue;
+
+        // still the parent's frame, the baseline core has it
+        if (vma.pages.empty())
+            vma.pages.assign(entries.size(), 1);
+        vma.pages[i] = 0;
+        baseline_shared++;
+    }
+}
+
+bool Opencore::MarkIdlePages(int pid) {
+    int fd = open("/sys/kernel/mm/page_idle/bitmap", O_RDWR);
+    if (fd < 0)
+        return false;
+
+    ArenaVector<VirtualMemoryArea> vmas;
+    ParseSmaps(pid, vmas);
+
+    PageMap target;
+    ArenaVector<uint64_t> pfns;
+    ArenaVector<uint64_t> entries;
+    if (target.Open(pid)) {
+        for (int index = 0; index < vmas.size(); ++index) {
+            VirtualMemoryArea& vma = vmas[index];
+            if (vma.vmflags & (VMFLAG_IO | VMFLAG_PFNMAP))
+                continue;
+            if (!target.Read(vma.begin, vma.end, entries))
+                continue;
+            for (uint64_t i = 0; i < entries.size(); ++i) {
+                uint64_t pfn = entries[i] & PageMap::PM_PFN_MASK;
+                if ((entries[i] & PageMap::PM_PRESENT) && pfn)
+                    pfns.push_back(pfn);
+            }
+        }
+    }
+
+    // bitmap takes whole u64 words, one bit per pfn, set bits mark idle
+    std::sort(pfns.begin(), pfns.end());
+    uint64_t marked = 0;
+    for (uint64_t i = 0; i < pfns.size();) {
+        uint64_t word_index = pfns[i] / 64;
+        uint64_t word = 0;
+        for (; i < pfns.size() && pfns[i] / 64 == word_index; ++i)
+            word |= 1ULL << (pfns[i] % 64);
+        if (pwrite64(fd, &word, sizeof(word), word_index * sizeof(word)) == sizeof(word))
+            marked++;
+    }
+
+    if (!marked) {
+        close(fd);
+        return false;
+    }
+    idle_fd = fd;
+    return true;
+}
+
+void Opencore::BeginWorkingSet() {
+    ws_mode = WS_NONE;
+    if (getWorkingSet() <= 0)
+        return;
+
+    // smaps Referenced counts from here on in every mode
+    ClearRefs(getPid(), CLEAR_REFS_ALL);
+
+    if (IsPfnVisible() && MarkIdlePages(getPid())) {
+        ws_mode = WS_IDLE;
+    } else if (!getIncremental() && IsSoftDirtySupported()
+            && ClearRefs(getPid(), CLEAR_REFS_SOFT_DIRTY)) {
+        // soft-dirty belongs to the incremental chain when that is on
+        ws_mode = WS_DIRTY;
+    } else {
+        ws_mode = WS_REFERENCED;
+        JNI_LOGW("No page_idle or soft-dirty, working set per vma from smaps Referenced.");
+    }
+
+    // the target keeps running until StopTheWorld, the window counts into timeout
+    JNI_LOGI("Working set mode %d, wait %d ms.", ws_mode, getWorkingSet());
+    usleep((useconds_t)getWorkingSet() * 1000);
+}
+
+void Opencore::FilterWorkingSetPages(int index, ArenaVector<uint64_t>& entries) {
+    VirtualMemoryArea& vma = maps[index];
+    uint64_t resident = 0;
+    uint64_t accessed = 0;
+    uint64_t word_index = ~0ULL;
+    uint64_t word = 0;
+    for (uint64_t i = 0; i < entries.size(); ++i) {
+        bool present = entries[i] & PageMap::PM_PRESENT;
+        if (present)
+            resident++;
+
+        bool hot = true;
+        if (ws_mode == WS_IDLE) {
+            uint64_t pfn = entries[i] & PageMap::PM_PFN_MASK;
+            hot = false;
+            if (present && pfn) {
+                if (pfn / 64 != word_index) {
+                    word_index = pfn / 64;
+                    if (pread64(idle_fd, &word, sizeof(word), word_index * sizeof(word)) != sizeof(word))
+                        word = 0;
+                }
+                hot = !(word & (1ULL << (pfn % 64)));
+            }
+        } else if (ws_mode == WS_DIRTY) {
+            hot = entries[i] & PageMap::PM_SOFT_DIRTY;
+        } else if (ws_mode == WS_REFERENCED) {
+            // no page level signal, a vma nothing referenced in the window goes whole
+            hot = !(vma.vmflags & VMFLAG_SMAPS) || vma.referenced;
+        }
+
+        if (hot) {
+            accessed++;
+            continue;
+        }
+
+        if (vma.pages.empty())
+            vma.pages.assign(entries.size(), 1);
+        vma.pages[i] = 0;
+    }
+
+    if (ws_mode == WS_REFERENCED)
+        accessed = vma.referenced / page_size;
+
+    ws_records.push_back(vma.begin);
+    ws_records.push_back(vma.end);
+    ws_records.push_back(resident);
+    ws_records.push_back(accessed);
+    ws_records.push_back(vma.referenced);
+}
+
+uint64_t Opencore::NowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t Opencore::NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t Opencore::getDeadline() {
+    if (getTimeout() <= 0 || !dump_start)
+        return 0;
+
+    // leave a tenth of the timeout to rewrite headers and flush
+    uint64_t timeout = (uint64_t)getTimeout() * 1000;
+    uint64_t reserve = timeout / 10;
+    if (reserve < MIN_DEADLINE_RESERVE)
+        reserve = MIN_DEADLINE_RESERVE;
+    return dump_start + (timeout > reserve ? timeout - reserve : 0);
+}
+
+void Opencore::BeginLoadDeadline(uint64_t total) {
+    load_start = NowMs();
+    load_total = total;
+    load_done = 0;
+}
+
+bool Opencore::IsPastDeadline() {
+    uint64_t deadline = getDeadline();
+    if (degraded || !deadline || !load_done)
+        return false;
+
+    uint64_t now = NowMs();
+    if (now >= deadline)
+        return true;
+
+    // project the rest at the rate seen so far
+    uint64_t elapsed = now - load_start;
+    if (elapsed < 100)
+        return false;
+
+    uint64_t remain = load_total > load_done ? load_total - load_done : 0;
+    uint64_t projected = now + (uint64_t)((double)remain * elapsed / load_done);
+    if (projected <= deadline)
+        return false;
+
+    JNI_LOGW("Deadline, %" PRIu64 " of %" PRIu64 " bytes in %" PRIu64 " ms, projected %" PRIu64 " ms over.",
+             load_done, load_total, elapsed, projected - deadline);
+    return true;
+}
+
+bool Opencore::IsDegradeKeep(uint64_t begin, uint64_t end) {
+    // cheapest policy that still unwinds, the live range [sp, end) of every stack
+    int prnum = getPrNum();
+    for (int i = 0; i < prnum; ++i) {
+        uint64_t sp = getPrSp(i);
+        int index = FindVma(sp);
+        if (index < 0)
+            continue;
+
+        uint64_t live = RoundDown(sp, (uint64_t)page_size);
+        if (begin < maps[index].end && end > live)
+            return true;
+    }
+    return false;
+}
+
+const char* Opencore::PlanCategory(Opencore::VirtualMemoryArea& vma) {
+    int prnum = getPrNum();
+    for (int i = 0; i < prnum; ++i) {
+        uint64_t sp = getPrSp(i);
+        if (sp >= vma.begin && sp < vma.end)
+            return "stack";
+    }
+
+    if (vma.file.compare(0, 12, "[anon:dalvik") == 0)
+        return "java_heap";
+    if (IsJitCache(vma))
+        return "jit_cache";
+    if (vma.flags[3] == 's' || vma.flags[3] == 'S')
+        return "shared";
+    if (vma.inode > 0)
+        return "file";
+    return "anon";
+}
+
+void Opencore::BuildPlan(std::vector<PlanSegment>& segments, uint64_t head, uint64_t note_size,
+                         std::string& json, bool measure) {
+    static const char* kCategories[] = { "stack", "java_heap", "jit_cache", "shared", "file", "anon" };
+    constexpr int kNum = sizeof(kCategories) / sizeof(kCategories[0]);
+    uint64_t bytes[kNum] = { 0 };
+    uint64_t resident[kNum] = { 0 };
+    uint64_t swapped[kNum] = { 0 };
+    uint64_t vmas[kNum] = { 0 };
+    uint64_t load = 0;
+
+    // residency of the selected pages, the world runs again meanwhile
+    PageMap target;
+    target.Open(getPid());
+    ArenaVector<uint64_t> entries;
+    int last = -1;
+    for (int i = 0; i < segments.size(); ++i) {
+        PlanSegment& segment = segments[i];
+        int index = FindVma(segment.vaddr);
+        if (index < 0 || !segment.filesz)
+            continue;
+
+        const char* name = PlanCategory(maps[index]);
+        int k = 0;
+        while (k < kNum - 1 && strcmp(kCategories[k], name))
+            k++;
+
+        bytes[k] += segment.filesz;
+        load += segment.filesz;
+        if (index != last)
+            vmas[k]++;
+        last = index;
+
+        if (!target.IsOpen() || !target.Read(segment.vaddr, segment.vaddr + segment.filesz, entries))
+            continue;
+        for (uint64_t e = 0; e < entries.size(); ++e) {
+            if (entries[e] & PageMap::PM_PRESENT)
+                resident[k] += page_size;
+            else if (entries[e] & PageMap::PM_SWAP)
+                swapped[k] += page_size;
+        }
+    }
+
+    uint64_t throughput = DEF_PLAN_THROUGHPUT;
+    bool measured = false;
+    if (measure) {
+        char filename[32];
+        snprintf(filename, sizeof(filename), "/proc/%d/mem", getPid());
+        int fd = open(filename, O_RDONLY);
+        if (fd >= 0) {
+            std::vector<uint8_t> buf(page_size);
+            uint64_t sampled = 0;
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (int i = 0; i < segments.size() && sampled < DEF_PLAN_SAMPLE; ++i) {
+                for (uint64_t off = 0; off < segments[i].filesz && sampled < DEF_PLAN_SAMPLE; off += page_size) {
+                    if (pread64(fd, buf.data(), page_size, segments[i].vaddr + off) == page_size)
+                        sampled += page_size;
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            close(fd);
+            uint64_t us = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000;
+            if (sampled && us) {
+                throughput = sampled * 1000000 / us;
+                measured = true;
+            }
+        }
+    }
+
+    uint64_t total = head + load;
+    char buf[256];
+    json.assign("{");
+    snprintf(buf, sizeof(buf),
+             "\"pid\":%d,\"filter\":%d,\"threads\":%d,\"vmas\":%zu,\"segments\":%zu,"
+             "\"head_bytes\":%" PRIu64 ",\"note_bytes\":%" PRIu64 ",\"load_bytes\":%" PRIu64 ","
+             "\"file_bytes\":%" PRIu64 ",",
+             getPid(), getFilter(), getPrNum(), maps.size(), segments.size(),
+             head, note_size, load, total);
+    json.append(buf);
+    snprintf(buf, sizeof(buf),
+             "\"throughput\":%" PRIu64 ",\"measured\":%s,\"estimate_ms\":%" PRIu64 ",\"categories\":{",
+             throughput, measured ? "true" : "false", total * 1000 / throughput);
+    json.append(buf);
+    for (int k = 0; k < kNum; ++k) {
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\":{\"vmas\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"resident\":%" PRIu64 ",\"swapped\":%" PRIu64 "}",
+                 k ? "," : "", kCategories[k], vmas[k], bytes[k], resident[k], swapped[k]);
+        json.append(buf);
+    }
+    json.append("}}");
 }
@@ -20,11 +20,20 @@
 #include <inttypes.h>
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <unistd.h>
 #include <signal.h>
 #include <string>
 #include <vector>
 #include <type_traits>
+#include "opencore/rules.h"
+#include "opencore/pagemap.h"
+#include "opencore/dedup.h"
+#include "opencore/note.h"
+#include "opencore/arena.h"
+#include "opencore/signature.h"
+#include "opencore/retention.h"
+#include "opencore/sink.h"
 
 #define EM_NONE     0
 #define EM_386      3
@@ -39,6 +48,17 @@
 #define NOTE_CORE_NAME_SZ 5
 #define ELFLINUXMAGIC "LINUX"
 #define NOTE_LINUX_NAME_SZ 6
+#define ELFOPENCOREMAGIC "OPENCORE"
+#define NOTE_OPENCORE_NAME_SZ 9
+
+// "OPENCORE" note types
+#define NT_OPENCORE_SWAP 0x1    // skipped swap ranges, { u64 begin, u64 end }[]
+#define NT_OPENCORE_DEDUP 0x2   // load segments live in this "<core>.pages" file
+#define NT_OPENCORE_INCREMENTAL 0x3 // { u32 version, u32 seq } "base\0previous\0"
+#define NT_OPENCORE_BASELINE 0x4    // { u32 version, u32 pid } "baseline core\0"
+#define NT_OPENCORE_WORKINGSET 0x5  // { u32 version, u32 mode, u32 window ms, u32 page size }
+                                    // { u64 begin, u64 end, u64 resident, u64 accessed, u64 referenced }[]
+#define NT_OPENCORE_CRASHES 0x6     // { u32 version, u32 count } { u32 tid, u32 signo, u64 ucontext, siginfo_t }[]
 
 #define GENMASK_UL(h, l) (((~0ULL) << (l)) & (~0ULL >> (64 - 1 - (h))))
 
@@ -77,6 +97,12 @@ public:
     static constexpr int FILTER_MINIDUMP = 1 << 6;
     static constexpr int FILTER_JAVAHEAP_VMA = 1 << 7;
     static constexpr int FILTER_JIT_CACHE_VMA = 1 << 8;
+    static constexpr int FILTER_MINIDUMP_WINDOW = 1 << 9;
+    static constexpr int FILTER_MINIDUMP_REACHABLE = 1 << 10;
+    static constexpr int FILTER_DEVICE_VMA = 1 << 11;
+    static constexpr int FILTER_NON_RESIDENT_VMA = 1 << 12;
+    static constexpr int FILTER_CLEAN_FILE_PAGE = 1 << 13;
+    static constexpr int FILTER_JIT_CACHE_PC = 1 << 14;
 
     static constexpr int VMA_NORMAL = 0;
     static constexpr int VMA_NULL = 1 << 0;
@@ -84,6 +110,71 @@ public:
 
     /** only opencore-sdk append **/
     static constexpr int DEF_TIMEOUT = 120;
+    static constexpr int DEF_PAGE_WINDOW = 4;
+    static constexpr int DEF_REACH_DEPTH = 3;
+    static constexpr uint64_t DEF_REACH_BUDGET = 8 << 20;
+    static constexpr int MAX_PR_REGS = 64;
+    static constexpr uint64_t DEF_SWAP_BUDGET = 32 << 20;
+    // less than this left under the quota only gets a minidump
+    static constexpr uint64_t MIN_FULL_BUDGET = 64 << 20;
+
+    static constexpr int SWAP_INCLUDE = 0;
+    static constexpr int SWAP_SKIP = 1;
+    static constexpr int SWAP_BUDGET = 2;
+
+    static constexpr int INCR_EXIT_BASE = 10;
+    static constexpr int INCR_EXIT_DELTA = 11;
+
+    static constexpr int WS_NONE = 0;
+    static constexpr int WS_IDLE = 1;        // page_idle bitmap, accessed pages only
+    static constexpr int WS_DIRTY = 2;       // soft-dirty, written pages only
+    static constexpr int WS_REFERENCED = 3;  // smaps Referenced, whole vmas only
+
+    static constexpr const char* CLEAR_REFS_ALL = "1";
+    static constexpr const char* CLEAR_REFS_SOFT_DIRTY = "4";
+    static constexpr const char* CLEAR_REFS_PEAK_RSS = "5";
+
+    // projected load segment finish is checked every this many pages
+    static constexpr int DEADLINE_CHECK_PAGES = 256;
+    static constexpr uint64_t MIN_DEADLINE_RESERVE = 500;
+
+    // dry-run estimate when throughput is not measured, and the measure sample
+    static constexpr uint64_t DEF_PLAN_THROUGHPUT = 256 << 20;
+    static constexpr uint64_t DEF_PLAN_SAMPLE = 16 << 20;
+
+    // sessions of this process take turns per target pid, a thread traced
+    // by anyone else (another dumper process, a debugger) is waited this
+    // long, then the dump fails rather than write it without registers
+    static constexpr uint64_t ATTACH_WAIT_MS = 2000;
+    static constexpr int MAX_DUMP_TARGETS = 16;
+
+    // crash path arena reserved by Enable()
+    static constexpr uint64_t DEF_ARENA_SIZE = 64 << 20;
+
+    // faults coalesced into one crash dump, later ones only wait for it
+    static constexpr int MAX_CRASH_RECORDS = 32;
+    static constexpr int CRASH_WAIT_US = 10000;
+
+    // what a crash with an already seen signature gets
+    static constexpr int REPEAT_FULL = 0;
+    static constexpr int REPEAT_MINIDUMP = 1;
+    static constexpr int REPEAT_SKIP = 2;
+
+    // signature: return addresses hashed, stack words scanned for them,
+    // and the window the per signature and global dump limits count in
+    static constexpr int SIGNATURE_FRAMES = 8;
+    static constexpr int SIGNATURE_STACK_WORDS = 2048;
+    static constexpr uint64_t DEF_RATE_WINDOW = 24 * 3600;
+
+    static constexpr int COPY_CLONE = 1 << 0;
+    static constexpr int COPY_RANGE = 1 << 1;
+
+    // subset of /proc/pid/smaps VmFlags
+    static constexpr uint32_t VMFLAG_SMAPS = 1 << 0;
+    static constexpr uint32_t VMFLAG_IO = 1 << 1;
+    static constexpr uint32_t VMFLAG_PFNMAP = 1 << 2;
+    static constexpr uint32_t VMFLAG_DONTDUMP = 1 << 3;
+    static constexpr uint32_t VMFLAG_MIXEDMAP = 1 << 4;
 
     Opencore() {
         flag = FLAG_CORE
@@ -93,7 +184,6 @@ public:
         pid = INVALID_TID;
         tid = INVALID_TID;
         filter = FILTER_NONE;
-        extra_note_filesz = 0;
         page_size = sysconf(_SC_PAGE_SIZE);
         align_size = ELF_PAGE_SIZE;
 
@@ -102,17 +192,94 @@ public:
         siginfo = nullptr;
         cb = nullptr;
         timeout = DEF_TIMEOUT;
+        window = DEF_PAGE_WINDOW;
+        reach_depth = DEF_REACH_DEPTH;
+        reach_budget = DEF_REACH_BUDGET;
+        swap_policy = SWAP_INCLUDE;
+        swap_budget = DEF_SWAP_BUDGET;
+        swap_included = 0;
+        file_elided = 0;
+        copy_index = -1;
+        copy_fd = -1;
+        copy_flags = COPY_CLONE | COPY_RANGE;
+        file_copied = 0;
+        dedup = false;
+        incremental = false;
+        incr_delta = false;
+        incr_seq = 0;
+        dirty_pages = 0;
+        baseline_pid = 0;
+        baseline_shared = 0;
+        working_set = 0;
+        repeat_policy = REPEAT_FULL;
+        signature_limit = 0;
+        global_limit = 0;
+        quota = 0;
+        max_files = 0;
+        max_age = 0;
+        compact = false;
+        ws_mode = WS_NONE;
+        idle_fd = -1;
+        core_fd = -1;
+        sink = nullptr;
+        degraded = false;
+        dump_start = 0;
+        stats = nullptr;
+        stats_start = 0;
+        freeze_start = 0;
+        load_start = 0;
+        load_total = 0;
+        load_done = 0;
     }
 
+    virtual ~Opencore() {}
+
     struct VirtualMemoryArea {
         uint64_t begin;
         uint64_t end;
         char     flags[4];
-        uint32_t offset;
+        // file offsets pass 4GB on large mappings, the copy source needs all bits
+        uint64_t offset;
         uint32_t major;
         uint32_t minor;
         uint64_t inode;
-        std::string file;
+        ArenaString file;
+
+        /** only opencore-sdk append **/
+        // page select mask, empty means the whole vma follows its filter flag
+        ArenaVector<uint8_t> pages;
+        // from /proc/pid/smaps, valid only with VMFLAG_SMAPS
+        uint64_t rss = 0;
+        uint64_t swap = 0;
+        uint64_t referenced = 0;
+        uint32_t vmflags = 0;
+    };
+
+    // one dump as its dumper saw it, times in us from the dump request
+    struct DumpStats {
+        uint64_t freeze;
+        uint64_t first_byte;
+        uint64_t total;
+        uint64_t bytes;
+        uint64_t read_syscalls;
+        uint64_t write_syscalls;
+        uint64_t minor_faults;
+        uint64_t major_faults;
+        // dumper growth over what it inherited from the fork
+        uint64_t peak_rss_kb;
+        uint32_t threads;
+        uint32_t segments;
+    };
+
+    struct PlanSegment {
+        uint64_t vaddr;
+        uint64_t memsz;
+        uint64_t filesz;
+    };
+
+    struct ExtraNote {
+        uint32_t type;
+        ArenaVector<uint8_t> desc;
     };
 
     struct ThreadRecord {
@@ -120,6 +287,14 @@ public:
         bool attached;
     };
 
+    // NT_OPENCORE_CRASHES entry
+    struct CrashRecord {
+        uint32_t tid;
+        uint32_t signo;
+        uint64_t ucontext;
+        siginfo_t info;
+    };
+
     void setDir(const char* d) { dir = d; }
     void setPid(int p) { pid = p; }
     void setTid(int t) { tid = t; }
@@ -129,17 +304,21 @@ public:
     int getPid() { return pid; }
     int getTid() { return tid; }
     int getFilter() { return filter; }
-    int getExtraNoteFilesz() { return extra_note_filesz; }
     bool Coredump(const char* filename);
+    bool Coreplan(std::string& json, bool measure);
     virtual void Finish();
     virtual bool DoCoredump(const char* filename) { return false; }
+    virtual void TruncateOnTimeout() {}
+    virtual bool DoPlan(std::string& json, bool measure) { return false; }
     virtual int NeedFilterFile(Opencore::VirtualMemoryArea& vma) { return VMA_NORMAL; }
     virtual int getMachine() { return EM_NONE; }
     int IsFilterSegment(Opencore::VirtualMemoryArea& vma);
-    void StopTheWorld(int pid);
+    bool IsExcludedSegment(Opencore::VirtualMemoryArea& vma);
+    bool StopTheWorld(int pid);
     bool StopTheThread(int tid);
+    static bool IsTraced(int pid, int tid);
     void Continue();
-    static void ParseMaps(int pid, std::vector<VirtualMemoryArea>& maps);
+    static void ParseMaps(int pid, ArenaVector<VirtualMemoryArea>& maps);
 
     /** only opencore-sdk append **/
     void setFlag(int f) { flag = f; }
@@ -147,58 +326,220 @@ public:
     void setContext(void *raw) { ucontext_raw = raw; }
     void setSignalInfo(void* info) { siginfo = info; }
     void setCallback(DumpCallback callback) { cb = callback; }
+    void setPageWindow(int w) { window = w; }
+    void setReachDepth(int depth) { reach_depth = depth; }
+    void setReachBudget(uint64_t budget) { reach_budget = budget; }
+    void setReachRoots(const char* libs) { reach_roots = libs; }
+    bool setRules(const char* text) { return rules.Compile(text); }
+    void setSwapPolicy(int policy) { swap_policy = policy; }
+    void setSwapBudget(uint64_t budget) { swap_budget = budget; }
+    void setDedup(bool enable) { dedup = enable; }
+    void setIncremental(bool enable);
+    void setWorkingSet(int ms) { working_set = ms; }
+    void setBaseline(int pid, const char* core) { baseline_pid = pid; baseline_core = core ? core : ""; }
+    void setRepeatPolicy(int policy) { repeat_policy = policy; }
+    void setRateLimit(int per_signature, int global) { signature_limit = per_signature; global_limit = global; }
+    void setQuota(uint64_t bytes) { quota = bytes; }
+    void setMaxFiles(int count) { max_files = count; }
+    void setMaxAge(int sec) { max_age = sec; }
+    void setCompact(bool enable) { compact = enable; }
+    void setSink(OutputSink* s) { sink = s; }
     int getTimeout() { return timeout; }
+    int getPageWindow() { return window; }
+    int getReachDepth() { return reach_depth; }
+    uint64_t getReachBudget() { return reach_budget; }
+    std::string& getReachRoots() { return reach_roots; }
+    VmaRules& getRules() { return rules; }
+    int getSwapPolicy() { return swap_policy; }
+    uint64_t getSwapBudget() { return swap_budget; }
+    bool getDedup() { return dedup; }
+    bool getIncremental() { return incremental; }
+    int getWorkingSet() { return working_set; }
+    int getBaselinePid() { return baseline_pid; }
+    std::string& getBaselineCore() { return baseline_core; }
+    int getRepeatPolicy() { return repeat_policy; }
+    int getSignatureLimit() { return signature_limit; }
+    int getGlobalLimit() { return global_limit; }
+    uint64_t getQuota() { return quota; }
+    int getMaxFiles() { return max_files; }
+    int getMaxAge() { return max_age; }
+    bool getCompact() { return compact; }
+    OutputSink* getSink() { return sink; }
     void* getContext() { return ucontext_raw; }
     void* getSignalInfo() { return siginfo; }
     DumpCallback getCallback() { return cb; }
+    virtual int getPrNum() { return 0; }
+    virtual int getPrRegs(int index, uint64_t* regs) { return 0; }
+    virtual uint64_t getPrSp(int index) { return 0; }
+    virtual bool getContextPcSp(void* ucontext, uint64_t* pc, uint64_t* sp) { return false; }
+    int FindVma(uint64_t addr);
+    static int FindVma(ArenaVector<VirtualMemoryArea>& vmas, uint64_t addr);
+    bool IncludePages(int index, uint64_t begin, uint64_t end);
+    bool IsIncludedPage(int index, uint64_t addr);
+    void CreateMinidumpWindow();
+    bool IsReachRoot(int index);
+    void CreateMinidumpReachable();
+    static bool IsJitCache(Opencore::VirtualMemoryArea& vma);
+    void IncludeJitPages(int index, uint64_t addr);
+    void CreateJitRetention();
+    void IncludeWindowPages(int index);
+    void IncludeStackPages(int index);
+    int MatchRule(Opencore::VirtualMemoryArea& vma);
+    int IsRuleFilterSegment(int index);
+    void ParseProcessSmaps(int pid);
+    void MergeSmaps();
+    static void ParseSmaps(int pid, ArenaVector<VirtualMemoryArea>& smaps);
+    bool IsCleanFileCandidate(Opencore::VirtualMemoryArea& vma);
+    void FilterPages(int index);
+    void FilterFilePages(int index, ArenaVector<uint64_t>& entries);
+    void FilterSwapPages(int index, ArenaVector<uint64_t>& entries);
+    void FilterDirtyPages(int index, ArenaVector<uint64_t>& entries);
+    void PrepareIncremental();
+    void UpdateIncremental(const char* filename, int status);
+    void ListKeptCores(ArenaVector<ArenaString>& names);
+    static uint64_t ProbeSelfPage();
+    static bool IsSoftDirtySupported();
+    static bool ClearRefs(int pid, const char* mode);
+    void FilterBaselinePages(int index, ArenaVector<uint64_t>& entries);
+    void PrepareBaseline();
+    static bool IsPfnVisible();
+    void BeginWorkingSet();
+    bool MarkIdlePages(int pid);
+    void FilterWorkingSetPages(int index, ArenaVector<uint64_t>& entries);
+    static uint64_t NowMs();
+    static uint64_t NowUs();
+    void BeginStats();
+    void BeginChildStats();
+    void MarkFirstByte(uint32_t segments);
+    void MarkWritten(uint64_t bytes);
+    void FinishStats();
+    const char* PlanCategory(Opencore::VirtualMemoryArea& vma);
+    void BuildPlan(std::vector<PlanSegment>& segments, uint64_t head, uint64_t note_size,
+                   std::string& json, bool measure);
+    uint64_t getDeadline();
+    void BeginLoadDeadline(uint64_t total);
+    void AddLoadBytes(uint64_t bytes) { load_done += bytes; }
+    bool IsLoadWriting() { return load_start != 0; }
+    bool IsPastDeadline();
+    bool IsDegradeKeep(uint64_t begin, uint64_t end);
+    void CreatePageFilterNote();
+    void CreateCrashNote();
+    uint64_t CopyFilePages(OutputSink* sink, uint64_t addr, uint64_t size);
+    void CloseCopyFile();
+    void BeginDedup(const char* filename);
+    void AddExtraNote(uint32_t type, const void* desc, uint32_t size);
+    void BuildExtraNotes();
 
     static Opencore* GetInstance();
+    static Opencore* NewSession();
+    void CopyConfig(Opencore* from);
+    void CopyChain(Opencore* from);
     static const char* GetVersion() { return __OPENCORE_VERSION__; }
     static void HandleSignal(int signal, siginfo_t* siginfo, void* ucontext_raw);
+    static void RecordCrash(int signal, siginfo_t* siginfo, void* ucontext_raw);
 
     class DumpOption {
     public:
         DumpOption()
             : filename(nullptr),
               pid(INVALID_TID), tid(INVALID_TID),
-              siginfo(nullptr), context(nullptr) {}
+              siginfo(nullptr), context(nullptr),
+              sink(nullptr) {}
         char* filename;
         int pid;
         int tid;
         void* siginfo;
         void* context;
+        // instead of a file under dir, filename is ignored then
+        OutputSink* sink;
     };
 
     static void Dump();
     static void Dump(const char* filename);
     static void Dump(const char* filename, int tid);
+    static void Dump(OutputSink* sink, int tid);
     static void Dump(siginfo_t* siginfo, void* ucontext_raw);
     static void Dump(DumpOption* option);
+    bool RunDump(DumpOption* option);
+    uint64_t CrashSignature(DumpOption* option);
+    int CheckCrashRepeat(DumpOption* option);
     static bool Enable();
     static bool Disable();
     static bool IsEnabled();
+    static std::string Plan(bool measure);
+    static std::string Plan(int pid, int tid, bool measure);
+    static bool GetLastStats(DumpStats* out);
+    static std::string GetLastStatsJson();
     static void IgnoreHandler();
+    static void BeginTraceable();
+    static void EndTraceable();
     static void SetDir(const char* dir);
     static void SetCallback(DumpCallback cb);
     static void SetFlag(int flag);
     static void SetTimeout(int sec);
     static void SetFilter(int filter);
+    static void SetPageWindow(int pages);
+    static void SetReachDepth(int depth);
+    static void SetReachBudget(uint64_t budget);
+    static void SetReachRoots(const char* libs);
+    static bool SetRules(const char* rules);
+    static void SetSwapPolicy(int policy);
+    static void SetSwapBudget(uint64_t budget);
+    static void SetDedup(bool enable);
+    static void SetIncremental(bool enable);
+    static void SetBaseline(int pid, const char* core);
+    static void SetWorkingSet(int ms);
+    static void SetRepeatPolicy(int policy);
+    static void SetRateLimit(int per_signature, int global);
+    static void SetQuota(uint64_t bytes);
+    static void SetMaxFiles(int count);
+    static void SetMaxAge(int sec);
+    static void SetCompact(bool enable);
+    static void StartCompact();
+    static bool IsDumping();
+    // cores retention must not evict or compact, see retention.h
+    static void GetKeptCores(ArenaVector<ArenaString>& names);
     static void TimeoutHandle(int);
     static const char* GetDir();
     static int GetFlag();
     static int GetTimeout();
     static int GetFilter();
+    static int GetPageWindow();
+    static int GetReachDepth();
+    static uint64_t GetReachBudget();
+    static const char* GetReachRoots();
+    static const char* GetRules();
+    static int GetSwapPolicy();
+    static uint64_t GetSwapBudget();
+    static bool GetDedup();
+    static bool GetIncremental();
+    static int GetBaselinePid();
+    static const char* GetBaselineCore();
+    static int GetWorkingSet();
+    static int GetRepeatPolicy();
+    static int GetSignatureLimit();
+    static int GetGlobalLimit();
+    static uint64_t GetQuota();
+    static int GetMaxFiles();
+    static int GetMaxAge();
+    static bool GetCompact();
 protected:
-    int extra_note_filesz;
-    std::vector<ThreadRecord> threads;
-    std::vector<VirtualMemoryArea> maps;
-    std::vector<uint8_t> zero;
+    ArenaVector<ThreadRecord> threads;
+    ArenaVector<VirtualMemoryArea> maps;
+    ArenaVector<uint8_t> zero;
     uint32_t align_size;
     uint32_t page_size;
 
     /** only opencore-sdk append **/
     void* ucontext_raw;
     void* siginfo;
+    ArenaVector<ExtraNote> notes;
+    NoteBuilder note_arena;
+    PageMap pagemap;
+    DedupStore dedup_store;
+    int core_fd;
+    OutputSink* sink;
+    bool degraded;
 private:
     std::string dir;
     int flag;
@@ -209,6 +550,55 @@ private:
     /** only opencore-sdk append **/
     DumpCallback cb;
     int timeout;
+    int window;
+    int reach_depth;
+    uint64_t reach_budget;
+    std::string reach_roots;
+    VmaRules rules;
+    ArenaVector<VirtualMemoryArea> smaps;
+    int swap_policy;
+    uint64_t swap_budget;
+    uint64_t swap_included;
+    ArenaVector<uint64_t> swap_skipped;
+    uint64_t file_elided;
+    int copy_index;
+    int copy_fd;
+    int copy_flags;
+    uint64_t file_copied;
+    ArenaVector<uint64_t> copy_entries;
+    bool dedup;
+    bool incremental;
+    bool incr_delta;
+    int incr_seq;
+    // updated from the crash handler too, arena backed
+    ArenaString incr_base;
+    ArenaString incr_last;
+    // base and every delta since, merge needs all of them
+    ArenaVector<ArenaString> incr_links;
+    uint64_t dirty_pages;
+    int baseline_pid;
+    std::string baseline_core;
+    PageMap baseline_map;
+    uint64_t baseline_shared;
+    int working_set;
+    int ws_mode;
+    int idle_fd;
+    ArenaVector<uint64_t> ws_records;
+    int repeat_policy;
+    int signature_limit;
+    int global_limit;
+    uint64_t quota;
+    int max_files;
+    int max_age;
+    bool compact;
+    uint64_t dump_start;
+    // shared with the dumper child for the length of one dump
+    DumpStats* stats;
+    uint64_t stats_start;
+    uint64_t freeze_start;
+    uint64_t load_start;
+    uint64_t load_total;
+    uint64_t load_done;
 };
 
 #endif // OPENCORE_OPENCORE_H_
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/pagemap.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool PageMap::Open(int pid) {
+    if (fd >= 0)
+        return true;
+
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/proc/%d/pagemap", pid);
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        JNI_LOGW("open %s: %s", filename, strerror(errno));
+        return false;
+    }
+    page_size = sysconf(_SC_PAGE_SIZE);
+    return true;
+}
+
+void PageMap::Close() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool PageMap::Read(uint64_t begin, uint64_t end, ArenaVector<uint64_t>& entries) {
+    entries.clear();
+    if (fd < 0 || begin >= end)
+        return false;
+
+    uint64_t count = (end - begin) / page_size;
+    entries.resize(count);
+
+    uint8_t* buf = (uint8_t *)entries.data();
+    uint64_t size = count * sizeof(uint64_t);
+    uint64_t offset = begin / page_size * sizeof(uint64_t);
+    uint64_t done = 0;
+    while (done < size) {
+        ssize_t ret = pread64(fd, buf + done, size - done, offset + done);
+        if (ret <= 0) {
+            entries.clear();
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
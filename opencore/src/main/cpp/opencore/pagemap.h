@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_PAGEMAP_H_
+#define OPENCORE_PAGEMAP_H_
+
+#include <stdint.h>
+#include "opencore/arena.h"
+
+/*
+ * /proc/pid/pagemap reader, one 64-bit entry per virtual page.
+ * Flag bits are visible to unprivileged readers, the PFN field
+ * reads as zero without CAP_SYS_ADMIN.
+ */
+class PageMap {
+public:
+    static constexpr uint64_t PM_PFN_MASK = (1ULL << 55) - 1;
+    static constexpr uint64_t PM_SOFT_DIRTY = 1ULL << 55;
+    static constexpr uint64_t PM_MMAP_EXCLUSIVE = 1ULL << 56;
+    static constexpr uint64_t PM_FILE = 1ULL << 61;
+    static constexpr uint64_t PM_SWAP = 1ULL << 62;
+    static constexpr uint64_t PM_PRESENT = 1ULL << 63;
+
+    PageMap() : fd(-1), page_size(0) {}
+    ~PageMap() { Close(); }
+
+    bool Open(int pid);
+    void Close();
+    bool IsOpen() { return fd >= 0; }
+    // entries of every page in [begin, end), both page aligned
+    bool Read(uint64_t begin, uint64_t end, ArenaVector<uint64_t>& entries);
+private:
+    int fd;
+    uint32_t page_size;
+};
+
+#endif // OPENCORE_PAGEMAP_H_
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "opencore/reader.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+bool LineReader::Open(const char* filename) {
+    Close();
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    pos = 0;
+    len = 0;
+    return fd >= 0;
+}
+
+void LineReader::Close() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool LineReader::Fill() {
+    if (fd < 0)
+        return false;
+
+    int ret;
+    do {
+        ret = read(fd, buf, sizeof(buf));
+    } while (ret < 0 && errno == EINTR);
+    if (ret <= 0)
+        return false;
+
+    pos = 0;
+    len = ret;
+    return true;
+}
+
+char* LineReader::Next() {
+    int n = 0;
+    bool any = false;
+    while (true) {
+        if (pos >= len && !Fill())
+            break;
+
+        any = true;
+        char* start = buf + pos;
+        char* end = (char *)memchr(start, '\n', len - pos);
+        int count = end ? end - start : len - pos;
+        int copy = count < (int)sizeof(line) - 1 - n ? count : (int)sizeof(line) - 1 - n;
+        memcpy(line + n, start, copy);
+        n += copy;
+        pos += count;
+        if (end) {
+            pos++;
+            break;
+        }
+    }
+
+    if (!any)
+        return nullptr;
+    line[n] = '\0';
+    return line;
+}
+
+bool DirReader::Open(const char* dir) {
+    Close();
+    fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    pos = 0;
+    len = 0;
+    return fd >= 0;
+}
+
+void DirReader::Close() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+const char* DirReader::Next() {
+    struct linux_dirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        uint16_t d_reclen;
+        uint8_t d_type;
+        char d_name[];
+    };
+
+    while (fd >= 0) {
+        if (pos >= len) {
+            int ret;
+            do {
+                ret = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+            } while (ret < 0 && errno == EINTR);
+            if (ret <= 0)
+                return nullptr;
+            pos = 0;
+            len = ret;
+        }
+
+        struct linux_dirent64* entry = (struct linux_dirent64 *)(buf + pos);
+        pos += entry->d_reclen;
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+            continue;
+        return name;
+    }
+    return nullptr;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_READER_H_
+#define OPENCORE_READER_H_
+
+#include <stdint.h>
+
+/*
+ * /proc text reader on a plain fd and a fixed buffer, no stdio and no
+ * heap, so the crash path can walk maps and status files. Lines longer
+ * than the buffer are cut, the rest of such a line is skipped.
+ */
+class LineReader {
+public:
+    LineReader() : fd(-1), pos(0), len(0) {}
+    ~LineReader() { Close(); }
+
+    bool Open(const char* filename);
+    void Close();
+    // next line without its '\n', nullptr at the end
+    char* Next();
+private:
+    bool Fill();
+
+    int fd;
+    int pos;
+    int len;
+    char buf[4096];
+    char line[1024];
+};
+
+/*
+ * Directory walk on getdents64 and a fixed buffer, opendir() mallocs its
+ * DIR. "." and ".." are skipped, Fd() is there for the *at() calls.
+ */
+class DirReader {
+public:
+    DirReader() : fd(-1), pos(0), len(0) {}
+    ~DirReader() { Close(); }
+
+    bool Open(const char* dir);
+    void Close();
+    int Fd() { return fd; }
+    // next entry name, nullptr at the end
+    const char* Next();
+private:
+    int fd;
+    int pos;
+    int len;
+    char buf[4096];
+};
+
+#endif // OPENCORE_READER_H_
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/retention.h"
+#include "opencore/gzip.h"
+#include "opencore/dedup.h"
+#include "opencore/reader.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <linux/elf.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+static bool EndsWith(const char* name, const char* suffix) {
+    int len = strlen(name);
+    int slen = strlen(suffix);
+    return len >= slen && !strcmp(name + len - slen, suffix);
+}
+
+static void JoinPath(char* path, int size, const char* dir, const char* name) {
+    snprintf(path, size, "%s/%s", dir, name);
+}
+
+void Retention::ListCores(const char* dir, ArenaVector<Core>& cores) {
+    uint8_t header[SeekableGzip::HEADER_SIZE];
+    DirReader reader;
+    if (!reader.Open(dir))
+        return;
+
+    int fd = reader.Fd();
+    const char* name;
+    while ((name = reader.Next())) {
+        if (name[0] == '.' || EndsWith(name, ".tmp"))
+            continue;
+
+        struct stat sb;
+        if (fstatat(fd, name, &sb, AT_SYMLINK_NOFOLLOW) || !S_ISREG(sb.st_mode))
+            continue;
+
+        int file = openat(fd, name, O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            continue;
+        int rc = read(file, header, sizeof(header));
+        close(file);
+
+        Core core;
+        if (rc >= EI_NIDENT + 2 && !memcmp(header, ELFMAG, SELFMAG)
+                && *(uint16_t *)(header + EI_NIDENT) == ET_CORE) {
+            core.plain = true;
+        } else if (SeekableGzip::IsSeekable(header, rc)) {
+            core.plain = false;
+        } else {
+            continue;
+        }
+
+        core.name = name;
+        core.bytes = sb.st_blocks * 512;
+        core.mtime = sb.st_mtime;
+        core.pages = false;
+
+        ArenaString pages(core.name);
+        pages.append(DedupStore::PAGES_SUFFIX);
+        if (!fstatat(fd, pages.c_str(), &sb, 0)) {
+            core.bytes += sb.st_blocks * 512;
+            core.pages = true;
+        }
+        cores.push_back(core);
+    }
+}
+
+void Retention::Remove(const char* dir, Core& core) {
+    char path[512];
+    JoinPath(path, sizeof(path), dir, core.name.c_str());
+    if (unlink(path) && errno != ENOENT)
+        JNI_LOGW("unlink %s: %s", path, strerror(errno));
+    if (core.pages) {
+        strncat(path, DedupStore::PAGES_SUFFIX, sizeof(path) - strlen(path) - 1);
+        unlink(path);
+    }
+    JNI_LOGI("Retention evict %s (%" PRIu64 " bytes)", core.name.c_str(), core.bytes);
+}
+
+bool Retention::IsKept(Core& core, const ArenaVector<ArenaString>& keep) {
+    // keep holds paths, cores are listed by name within dir
+    for (const ArenaString& path : keep) {
+        const char* name = strrchr(path.c_str(), '/');
+        if (core.name == (name ? name + 1 : path.c_str()))
+            return true;
+    }
+    return false;
+}
+
+// page store shared by every dedup core of dir
+uint64_t Retention::StoreBytes(const char* dir) {
+    char path[512];
+    struct stat sb;
+    uint64_t bytes = 0;
+    JoinPath(path, sizeof(path), dir, DedupStore::STORE_NAME);
+    if (!stat(path, &sb))
+        bytes += sb.st_blocks * 512;
+    JoinPath(path, sizeof(path), dir, DedupStore::INDEX_NAME);
+    if (!stat(path, &sb))
+        bytes += sb.st_blocks * 512;
+    return bytes;
+}
+
+uint64_t Retention::Enforce(const char* dir, uint64_t quota, int max_files, uint64_t max_age,
+                            const ArenaVector<ArenaString>& keep) {
+    if (!quota && !max_files && !max_age)
+        return 0;
+
+    ArenaVector<Core> cores;
+    ListCores(dir, cores);
+    std::sort(cores.begin(), cores.end(), [](const Core& a, const Core& b) {
+        return a.mtime < b.mtime;
+    });
+
+    uint64_t now = time(nullptr);
+    uint64_t total = quota ? StoreBytes(dir) : 0;
+    for (Core& core : cores)
+        total += core.bytes;
+
+    // oldest first, leave room for the core about to be written: one more
+    // file, and as many bytes as the newest core took
+    int count = cores.size();
+    uint64_t reserve = cores.empty() ? 0 : cores.back().bytes;
+    for (Core& core : cores) {
+        bool expired = max_age && now - core.mtime >= max_age;
+        bool crowded = max_files && count >= max_files;
+        bool over = quota && total + reserve > quota;
+        if (!expired && !crowded && !over)
+            break;
+        // a delta is useless without every link before it
+        if (IsKept(core, keep))
+            continue;
+        Remove(dir, core);
+        total -= core.bytes;
+        count--;
+    }
+
+    uint64_t left = quota > total ? quota - total : 0;
+    if (quota)
+        JNI_LOGI("Retention %d cores, %" PRIu64 " bytes, %" PRIu64 " left for this dump.",
+                 count, total, left);
+    return left;
+}
+
+int Retention::Compact(const char* dir, bool (*busy)(), const ArenaVector<ArenaString>& keep) {
+    ArenaVector<Core> cores;
+    ListCores(dir, cores);
+
+    uint64_t now = time(nullptr);
+    uint64_t newest = 0;
+    for (Core& core : cores)
+        newest = std::max(newest, core.mtime);
+
+    int compacted = 0;
+    char path[512];
+    char output[512];
+    for (Core& core : cores) {
+        // dedup cores are headers and notes only, left as they are
+        if (!core.plain || core.pages)
+            continue;
+        // just written ones may still be read by the app
+        if (core.mtime >= newest || now - core.mtime < COMPACT_MIN_AGE)
+            continue;
+        if (IsKept(core, keep))
+            continue;
+        if (busy && busy())
+            break;
+
+        JoinPath(path, sizeof(path), dir, core.name.c_str());
+        snprintf(output, sizeof(output), "%s%s", path, SeekableGzip::SUFFIX);
+        struct stat sb;
+        if (stat(path, &sb))
+            continue;
+        if (!SeekableGzip::Compress(path, output)) {
+            JNI_LOGW("compress %s: %s", path, strerror(errno));
+            continue;
+        }
+
+        // evicted meanwhile, do not bring it back
+        if (access(path, F_OK)) {
+            unlink(output);
+            continue;
+        }
+        // keeps its place in the eviction order
+        struct timespec times[2] = { sb.st_atim, sb.st_mtim };
+        utimensat(AT_FDCWD, output, times, 0);
+        unlink(path);
+        compacted++;
+        JNI_LOGI("Compact %s", output);
+    }
+    return compacted;
+}
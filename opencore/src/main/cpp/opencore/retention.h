@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_RETENTION_H_
+#define OPENCORE_RETENTION_H_
+
+#include <stdint.h>
+#include "opencore/arena.h"
+
+/*
+ * Core directory housekeeping. A core is any ELF ET_CORE file of the
+ * directory, together with its dedup .pages companion, or a core already
+ * compacted to seekable gzip. Other files (the dedup store, the crash
+ * history) are never touched.
+ *
+ * Enforce() runs ahead of each dump: cores older than max_age go first,
+ * then the least recently written until there is room for one more core
+ * under max_files, and for one more core the size of the newest under the
+ * quota. The dedup store counts
+ * against the quota, cores named in keep (links of the live incremental
+ * chain, the baseline core) are never evicted. It only uses syscalls and
+ * the arena, the crash path calls it too.
+ *
+ * Compact() gzips plain cores in place, see gzip.h. The newest core,
+ * cores younger than COMPACT_MIN_AGE and the keep ones stay plain: the
+ * app may still be reading them, and opencore-merge and the next
+ * incremental dump only open plain ELF.
+ */
+class Retention {
+public:
+    static constexpr uint64_t COMPACT_MIN_AGE = 60;
+
+    struct Core {
+        ArenaString name;
+        uint64_t bytes;
+        uint64_t mtime;
+        bool plain;
+        bool pages;
+    };
+
+    // 0 leaves the limit off; returns bytes left under the quota, 0 if none
+    static uint64_t Enforce(const char* dir, uint64_t quota, int max_files, uint64_t max_age,
+                            const ArenaVector<ArenaString>& keep);
+    // stops early once busy() reports a dump in flight
+    static int Compact(const char* dir, bool (*busy)(), const ArenaVector<ArenaString>& keep);
+    static void ListCores(const char* dir, ArenaVector<Core>& cores);
+private:
+    static void Remove(const char* dir, Core& core);
+    static bool IsKept(Core& core, const ArenaVector<ArenaString>& keep);
+    static uint64_t StoreBytes(const char* dir);
+};
+
+#endif // OPENCORE_RETENTION_H_
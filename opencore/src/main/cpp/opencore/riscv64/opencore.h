@@ -17,7 +17,7 @@
 #ifndef OPENCORE_RISCV64_OPENCORE_IMPL_H_
 #define OPENCORE_RISCV64_OPENCORE_IMPL_H_
 
-#include "opencore/lp64/opencore.h"
+#include "opencore/elfcore.h"
 
 namespace riscv64 {
 
@@ -75,18 +75,21 @@ typedef struct elf64_prstatus {
     uint32_t             pr_fpvalid;
 } Elf64_prstatus;
 
-class Opencore : public lp64::OpencoreImpl {
-public:
-    Opencore() : lp64::OpencoreImpl() {}
-    void Finish();
-    void CreateCorePrStatus(int pid);
-    void WriteCorePrStatus(FILE* fp);
-    int IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma);
-    int getMachine() { return EM_RISCV; }
-private:
-    std::vector<Elf64_prstatus> prstatus;
+struct Arch {
+    typedef riscv64::pt_regs Regs;
+    typedef Elf64_prstatus Prstatus;
+    static constexpr int MACHINE = EM_RISCV;
+    static void ContextRegs(void* ucontext, Regs* regs);
+    static int ListRegs(Prstatus& prstatus, uint64_t* out);
+    static uint64_t ProgramCounter(Prstatus& prstatus) { return prstatus.pr_reg.pc; }
+    static uint64_t StackPointer(Prstatus& prstatus) { return prstatus.pr_reg.sp; }
+    static void BuildThreadNotes(NoteBuilder& notes, int tid) {}
 };
 
+typedef ElfCoreWriter<Elf64Class, Arch> Opencore;
+
 } // namespace riscv64
 
+extern template class ElfCoreWriter<Elf64Class, riscv64::Arch>;
+
 #endif // OPENCORE_RISCV64_OPENCORE_IMPL_H_
@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/rules.h"
+#include <string.h>
+#include <stdlib.h>
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool VmaRule::GlobMatch(const char* pattern, const char* str) {
+    const char* star = nullptr;
+    const char* back = nullptr;
+    while (*str) {
+        if (*pattern == '*') {
+            star = pattern++;
+            back = str;
+        } else if (*pattern == '?' || *pattern == *str) {
+            pattern++;
+            str++;
+        } else if (star) {
+            pattern = star + 1;
+            str = ++back;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*')
+        pattern++;
+    return !*pattern;
+}
+
+bool VmaRule::Match(const char* flags, uint64_t size, uint64_t inode, const char* file) {
+    if (perm_mask) {
+        uint32_t value;
+        memcpy(&value, flags, sizeof(value));
+        if ((value & perm_mask) != perm_value)
+            return false;
+    }
+
+    if (size < min_size || size > max_size)
+        return false;
+
+    if (shared != ANY) {
+        bool is_shared = flags[3] == 's' || flags[3] == 'S';
+        if (is_shared != !!shared)
+            return false;
+    }
+
+    if (backed != ANY) {
+        if ((inode > 0) != !!backed)
+            return false;
+    }
+
+    switch (kind) {
+        case NAME_EXACT:
+            return !strcmp(file, name.c_str());
+        case NAME_PREFIX:
+            return !strncmp(file, name.c_str(), name.length());
+        case NAME_GLOB:
+            return GlobMatch(name.c_str(), file);
+    }
+    return true;
+}
+
+static bool ParseSize(const char* str, const char* end, uint64_t* size) {
+    if (str == end)
+        return true;
+
+    char* pos;
+    uint64_t value = strtoull(str, &pos, 0);
+    if (pos == str)
+        return false;
+
+    if (pos < end) {
+        switch (*pos) {
+            case 'k': case 'K': value <<= 10; pos++; break;
+            case 'm': case 'M': value <<= 20; pos++; break;
+            case 'g': case 'G': value <<= 30; pos++; break;
+        }
+    }
+    if (pos != end)
+        return false;
+
+    *size = value;
+    return true;
+}
+
+bool VmaRules::ParseRule(const char* line, int len, VmaRule& rule) {
+    const char* pos = line;
+    const char* end = line + len;
+    char key[16];
+    std::string value;
+
+    while (pos < end) {
+        while (pos < end && IsSpace(*pos))
+            pos++;
+        if (pos == end)
+            break;
+
+        // token is key[=value], value may be double quoted
+        const char* token = pos;
+        while (pos < end && !IsSpace(*pos) && *pos != '=')
+            pos++;
+
+        int keylen = pos - token;
+        if (keylen >= sizeof(key))
+            return false;
+        memcpy(key, token, keylen);
+        key[keylen] = '\0';
+
+        value.clear();
+        bool has_value = pos < end && *pos == '=';
+        if (has_value) {
+            pos++;
+            if (pos < end && *pos == '"') {
+                const char* quote = (const char *)memchr(pos + 1, '"', end - pos - 1);
+                if (!quote)
+                    return false;
+                value.assign(pos + 1, quote - pos - 1);
+                pos = quote + 1;
+            } else {
+                const char* begin = pos;
+                while (pos < end && !IsSpace(*pos))
+                    pos++;
+                value.assign(begin, pos - begin);
+            }
+        }
+
+        if (rule.action == VmaRule::ACTION_NONE) {
+            if (has_value) return false;
+            if (!strcmp(key, "include")) {
+                rule.action = VmaRule::ACTION_INCLUDE;
+            } else if (!strcmp(key, "exclude")) {
+                rule.action = VmaRule::ACTION_EXCLUDE;
+            } else if (!strcmp(key, "stack-trim")) {
+                rule.action = VmaRule::ACTION_STACK_TRIM;
+            } else if (!strcmp(key, "page-window")) {
+                rule.action = VmaRule::ACTION_PAGE_WINDOW;
+            } else {
+                return false;
+            }
+        } else if (!strcmp(key, "name") && has_value) {
+            rule.name = value;
+            size_t meta = value.find_first_of("*?");
+            if (meta == std::string::npos) {
+                rule.kind = VmaRule::NAME_EXACT;
+            } else if (meta == value.length() - 1 && value.back() == '*') {
+                // trailing '*' only, a plain prefix compare is enough
+                rule.name.pop_back();
+                rule.kind = VmaRule::NAME_PREFIX;
+            } else {
+                rule.kind = VmaRule::NAME_GLOB;
+            }
+        } else if (!strcmp(key, "prefix") && has_value) {
+            rule.name = value;
+            rule.kind = VmaRule::NAME_PREFIX;
+        } else if (!strcmp(key, "perms") && has_value) {
+            if (value.length() > 4)
+                return false;
+            for (int i = 0; i < value.length(); ++i) {
+                if (value[i] == '?')
+                    continue;
+                rule.perm_mask |= 0xFFU << (i * 8);
+                rule.perm_value |= (uint32_t)(uint8_t)value[i] << (i * 8);
+            }
+        } else if (!strcmp(key, "size") && has_value) {
+            const char* str = value.c_str();
+            const char* split = strchr(str, '-');
+            if (!split)
+                return false;
+            if (!ParseSize(str, split, &rule.min_size)
+                    || !ParseSize(split + 1, str + value.length(), &rule.max_size))
+                return false;
+        } else if (!strcmp(key, "shared") && !has_value) {
+            rule.shared = 1;
+        } else if (!strcmp(key, "private") && !has_value) {
+            rule.shared = 0;
+        } else if (!strcmp(key, "file") && !has_value) {
+            rule.backed = 1;
+        } else if (!strcmp(key, "anon") && !has_value) {
+            rule.backed = 0;
+        } else {
+            return false;
+        }
+    }
+    return rule.action != VmaRule::ACTION_NONE;
+}
+
+bool VmaRules::Compile(const char* text) {
+    std::vector<VmaRule> compiled;
+    const char* line = text ? text : "";
+    while (*line) {
+        // separators and '#' only count outside double quotes, a comment
+        // runs to the end of its line
+        int len = 0;
+        int rule_len = -1;
+        bool quoted = false;
+        for (; line[len]; ++len) {
+            char c = line[len];
+            if (rule_len >= 0) {
+                if (c == '\n')
+                    break;
+            } else if (c == '"') {
+                quoted = !quoted;
+            } else if (!quoted && (c == '\n' || c == ';')) {
+                break;
+            } else if (!quoted && c == '#') {
+                rule_len = len;
+            }
+        }
+        if (rule_len < 0)
+            rule_len = len;
+
+        const char* pos = line;
+        while (pos < line + rule_len && IsSpace(*pos))
+            pos++;
+
+        if (pos < line + rule_len) {
+            VmaRule rule;
+            if (!ParseRule(pos, line + rule_len - pos, rule)) {
+                JNI_LOGE("Invalid vma rule \"%.*s\"", len, line);
+                return false;
+            }
+            compiled.push_back(rule);
+        }
+
+        line += len;
+        if (*line) line++;
+    }
+
+    rules.swap(compiled);
+    source = text ? text : "";
+    return true;
+}
+
+int VmaRules::Match(const char* flags, uint64_t size, uint64_t inode, const char* file) {
+    for (int i = 0; i < rules.size(); ++i) {
+        if (rules[i].Match(flags, size, inode, file))
+            return rules[i].action;
+    }
+    return VmaRule::ACTION_NONE;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_RULES_H_
+#define OPENCORE_RULES_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Ordered vma policy rules, one rule per line (or ';' separated):
+ *
+ *   <action> [name=<glob>] [prefix=<str>] [perms=<rwxp>] [size=<min>-<max>]
+ *            [shared|private] [file|anon]
+ *
+ *   action: include, exclude, stack-trim, page-window
+ *   perms:  up to 4 chars of /proc/pid/maps flags, '?' matches any
+ *   size:   bytes with optional k/m/g suffix, either bound may be empty
+ *
+ * '#' starts a comment to the end of the line. Inside a double quoted
+ * value ';' and '#' are plain characters, a value can't hold '"'.
+ *
+ * exp:
+ *   exclude prefix=/dev/ shared
+ *   page-window name="[anon:dalvik-main space*]"
+ *   stack-trim name="[anon:stack_and_tls:*]"
+ *
+ * The first matched rule decides, unmatched vma fall back to FILTER_* bits.
+ */
+class VmaRule {
+public:
+    static constexpr int ACTION_NONE = 0;
+    static constexpr int ACTION_INCLUDE = 1;
+    static constexpr int ACTION_EXCLUDE = 2;
+    static constexpr int ACTION_STACK_TRIM = 3;
+    static constexpr int ACTION_PAGE_WINDOW = 4;
+
+    static constexpr int NAME_ANY = 0;
+    static constexpr int NAME_EXACT = 1;
+    static constexpr int NAME_PREFIX = 2;
+    static constexpr int NAME_GLOB = 3;
+
+    static constexpr int ANY = -1;
+
+    VmaRule()
+        : action(ACTION_NONE), kind(NAME_ANY),
+          perm_mask(0), perm_value(0),
+          min_size(0), max_size(~0ULL),
+          shared(ANY), backed(ANY) {}
+
+    bool Match(const char* flags, uint64_t size, uint64_t inode, const char* file);
+    static bool GlobMatch(const char* pattern, const char* str);
+
+    int action;
+    int kind;
+    std::string name;
+    uint32_t perm_mask;
+    uint32_t perm_value;
+    uint64_t min_size;
+    uint64_t max_size;
+    int shared;
+    int backed;
+};
+
+class VmaRules {
+public:
+    bool Compile(const char* text);
+    int Match(const char* flags, uint64_t size, uint64_t inode, const char* file);
+    bool empty() { return rules.empty(); }
+    void clear() { rules.clear(); source.clear(); }
+    std::string& getSource() { return source; }
+private:
+    static bool ParseRule(const char* line, int len, VmaRule& rule);
+    std::vector<VmaRule> rules;
+    std::string source;
+};
+
+#endif // OPENCORE_RULES_H_
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "opencore/scanner.h"
+
+#if defined(__aarch64__) || defined(__arm64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void PointerScanner::AddRange(uintptr_t begin, uintptr_t end) {
+    if (begin >= end)
+        return;
+
+    if (!ranges.empty() && ranges.back().end == begin) {
+        ranges.back().end = end;
+    } else {
+        Range range = {
+            .begin = begin,
+            .end = end,
+        };
+        ranges.push_back(range);
+    }
+
+    lo = ranges.front().begin;
+    span = ranges.back().end - lo;
+}
+
+bool PointerScanner::Contains(uintptr_t addr) {
+    if (addr - lo >= span)
+        return false;
+
+    int left = 0;
+    int right = (int)ranges.size() - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        if (addr < ranges[mid].begin) {
+            right = mid - 1;
+        } else if (addr >= ranges[mid].end) {
+            left = mid + 1;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+int PointerScanner::Scan(const uintptr_t* words, int num, uintptr_t* out) {
+    int count = 0;
+    int i = 0;
+
+    if (ranges.empty())
+        return 0;
+
+    // vector prefilter on [lo, lo + span), only hit lanes go to the exact lookup
+#if defined(__aarch64__) || defined(__arm64__)
+    uint64x2_t vlo = vdupq_n_u64(lo);
+    uint64x2_t vspan = vdupq_n_u64(span);
+    uint64x2_t vmask = vdupq_n_u64(TAG_MASK);
+    for (; i + 4 <= num; i += 4) {
+        uint64x2_t a = vandq_u64(vld1q_u64((const uint64_t *)&words[i]), vmask);
+        uint64x2_t b = vandq_u64(vld1q_u64((const uint64_t *)&words[i + 2]), vmask);
+        uint64x2_t hit = vorrq_u64(vcltq_u64(vsubq_u64(a, vlo), vspan),
+                                   vcltq_u64(vsubq_u64(b, vlo), vspan));
+        if (!(vgetq_lane_u64(hit, 0) | vgetq_lane_u64(hit, 1)))
+            continue;
+
+        for (int j = i; j < i + 4; ++j) {
+            uintptr_t value = words[j] & TAG_MASK;
+            if (Contains(value)) out[count++] = value;
+        }
+    }
+#elif defined(__arm__) && defined(__ARM_NEON)
+    uint32x4_t vlo = vdupq_n_u32(lo);
+    uint32x4_t vspan = vdupq_n_u32(span);
+    for (; i + 8 <= num; i += 8) {
+        uint32x4_t a = vld1q_u32((const uint32_t *)&words[i]);
+        uint32x4_t b = vld1q_u32((const uint32_t *)&words[i + 4]);
+        uint32x4_t hit = vorrq_u32(vcltq_u32(vsubq_u32(a, vlo), vspan),
+                                   vcltq_u32(vsubq_u32(b, vlo), vspan));
+        uint32x2_t fold = vorr_u32(vget_low_u32(hit), vget_high_u32(hit));
+        if (!(vget_lane_u32(fold, 0) | vget_lane_u32(fold, 1)))
+            continue;
+
+        for (int j = i; j < i + 8; ++j) {
+            if (Contains(words[j])) out[count++] = words[j];
+        }
+    }
+#elif defined(__x86_64__)
+    // SSE2 has no unsigned 64-bit compare, build it from biased 32-bit lanes
+    __m128i vlo = _mm_set1_epi64x(lo);
+    __m128i bias = _mm_set1_epi32(0x80000000);
+    __m128i vspan = _mm_xor_si128(_mm_set1_epi64x(span), bias);
+    for (; i + 4 <= num; i += 4) {
+        __m128i hit = _mm_setzero_si128();
+        for (int k = 0; k < 4; k += 2) {
+            __m128i d = _mm_xor_si128(_mm_sub_epi64(
+                    _mm_loadu_si128((const __m128i *)&words[i + k]), vlo), bias);
+            __m128i gt = _mm_cmpgt_epi32(vspan, d);
+            __m128i eq = _mm_cmpeq_epi32(vspan, d);
+            __m128i lt = _mm_or_si128(_mm_shuffle_epi32(gt, _MM_SHUFFLE(3, 3, 1, 1)),
+                                      _mm_and_si128(_mm_shuffle_epi32(eq, _MM_SHUFFLE(3, 3, 1, 1)),
+                                                    _mm_shuffle_epi32(gt, _MM_SHUFFLE(2, 2, 0, 0))));
+            hit = _mm_or_si128(hit, lt);
+        }
+        if (!_mm_movemask_epi8(hit))
+            continue;
+
+        for (int j = i; j < i + 4; ++j) {
+            if (Contains(words[j])) out[count++] = words[j];
+        }
+    }
+#elif defined(__i386__) && defined(__SSE2__)
+    __m128i vlo = _mm_set1_epi32(lo);
+    __m128i bias = _mm_set1_epi32(0x80000000);
+    __m128i vspan = _mm_xor_si128(_mm_set1_epi32(span), bias);
+    for (; i + 8 <= num; i += 8) {
+        __m128i a = _mm_xor_si128(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)&words[i]), vlo), bias);
+        __m128i b = _mm_xor_si128(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)&words[i + 4]), vlo), bias);
+        __m128i hit = _mm_or_si128(_mm_cmpgt_epi32(vspan, a), _mm_cmpgt_epi32(vspan, b));
+        if (!_mm_movemask_epi8(hit))
+            continue;
+
+        for (int j = i; j < i + 8; ++j) {
+            if (Contains(words[j])) out[count++] = words[j];
+        }
+    }
+#endif
+
+    for (; i < num; ++i) {
+        uintptr_t value = words[i] & TAG_MASK;
+        if (Contains(value)) out[count++] = value;
+    }
+    return count;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_SCANNER_H_
+#define OPENCORE_SCANNER_H_
+
+#include <stdint.h>
+#include "opencore/arena.h"
+
+/*
+ * Conservative pointer scanner, any aligned word whose value lands in
+ * one of the added ranges is reported as a pointer candidate.
+ */
+class PointerScanner {
+public:
+    struct Range {
+        uintptr_t begin;
+        uintptr_t end;
+    };
+
+    PointerScanner() : lo(0), span(0) {}
+    // ranges must be added in ascending order without overlap
+    void AddRange(uintptr_t begin, uintptr_t end);
+    bool Contains(uintptr_t addr);
+    int Scan(const uintptr_t* words, int num, uintptr_t* out);
+    void Clear() { ranges.clear(); lo = 0; span = 0; }
+    bool Empty() { return ranges.empty(); }
+
+#if defined(__aarch64__) || defined(__arm64__)
+    // strip the top byte, tagged heap pointers (TBI/MTE) still match
+    static constexpr uintptr_t TAG_MASK = 0x00FFFFFFFFFFFFFFULL;
+#else
+    static constexpr uintptr_t TAG_MASK = ~(uintptr_t)0;
+#endif
+private:
+    ArenaVector<Range> ranges;
+    uintptr_t lo;
+    uintptr_t span;
+};
+
+#endif // OPENCORE_SCANNER_H_
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/signature.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+uint64_t SignatureHash(uint64_t hash, const void* data, uint64_t size) {
+    const uint8_t* p = (const uint8_t *)data;
+    for (uint64_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool CrashStore::Open(const char* dir) {
+    char filename[256];
+    if (dir && dir[0])
+        snprintf(filename, sizeof(filename), "%s/%s", dir, STORE_NAME);
+    else
+        snprintf(filename, sizeof(filename), "%s", STORE_NAME);
+
+    Close();
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+
+    fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        JNI_LOGW("open %s: %s", filename, strerror(errno));
+        return false;
+    }
+
+    // a missing, short or foreign file starts an empty history
+    Header head;
+    if (pread(fd, &head, sizeof(head), 0) != sizeof(head)
+            || memcmp(head.magic, MAGIC, sizeof(head.magic))
+            || head.version != VERSION
+            || head.count > MAX_ENTRIES)
+        return true;
+
+    uint64_t size = (uint64_t)head.count * sizeof(Entry);
+    if (pread(fd, entries, size, sizeof(head)) != (ssize_t)size)
+        return true;
+
+    header = head;
+    return true;
+}
+
+CrashStore::Entry* CrashStore::Find(uint64_t signature) {
+    for (uint32_t i = 0; i < header.count; ++i) {
+        if (entries[i].signature == signature)
+            return &entries[i];
+    }
+    return nullptr;
+}
+
+CrashStore::Entry* CrashStore::Add(uint64_t signature, uint64_t now) {
+    Entry* entry;
+    if (header.count < MAX_ENTRIES) {
+        entry = &entries[header.count++];
+    } else {
+        entry = &entries[0];
+        for (uint32_t i = 1; i < header.count; ++i) {
+            if (entries[i].last < entry->last)
+                entry = &entries[i];
+        }
+    }
+
+    memset(entry, 0, sizeof(Entry));
+    entry->signature = signature;
+    entry->first = now;
+    entry->window_start = now;
+    return entry;
+}
+
+bool CrashStore::Save() {
+    if (fd < 0)
+        return false;
+
+    uint64_t size = (uint64_t)header.count * sizeof(Entry);
+    if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)
+            || pwrite(fd, entries, size, sizeof(header)) != (ssize_t)size) {
+        JNI_LOGW("write %s: %s", STORE_NAME, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void CrashStore::Close() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
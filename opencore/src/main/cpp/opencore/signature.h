@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_SIGNATURE_H_
+#define OPENCORE_SIGNATURE_H_
+
+#include <stdint.h>
+
+/*
+ * Crash signature history of one core directory.
+ *
+ *   <dir>/opencore.crashes    Header, then Entry[count]
+ *
+ * Fixed size and handled with plain open/read/pwrite, it is consulted
+ * from the crash signal handler. The least recently seen signature makes
+ * room for a new one once the table is full.
+ */
+class CrashStore {
+public:
+    static constexpr const char* STORE_NAME = "opencore.crashes";
+    static constexpr const char* MAGIC = "OCCRASH";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr int MAX_ENTRIES = 64;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+        // global rate window, unix seconds
+        uint64_t window_start;
+        uint32_t window_dumps;
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        uint64_t signature;
+        uint32_t seen;
+        uint32_t dumps;
+        uint64_t first;
+        uint64_t last;
+        // per signature rate window, unix seconds
+        uint64_t window_start;
+        uint32_t window_dumps;
+        uint32_t reserved;
+    };
+
+    CrashStore() : fd(-1) {}
+    ~CrashStore() { Close(); }
+
+    bool Open(const char* dir);
+    Entry* Find(uint64_t signature);
+    Entry* Add(uint64_t signature, uint64_t now);
+    Header& getHeader() { return header; }
+    bool Save();
+    void Close();
+private:
+    int fd;
+    Header header;
+    Entry entries[MAX_ENTRIES];
+};
+
+/*
+ * FNV-1a, cheap enough for the signal handler and stable across
+ * launches as long as the inputs are.
+ */
+uint64_t SignatureHash(uint64_t hash, const void* data, uint64_t size);
+
+static constexpr uint64_t SIGNATURE_SEED = 0xcbf29ce484222325ULL;
+
+#endif // OPENCORE_SIGNATURE_H_
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "eajnis/Log.h"
+#include "opencore/sink.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+bool OutputSink::Skip(uint64_t pos) {
+    static const uint8_t zero[4096] = {0};
+    while (offset < pos) {
+        uint64_t size = pos - offset;
+        if (size > sizeof(zero)) size = sizeof(zero);
+        if (!Write(zero, size))
+            return false;
+    }
+    return true;
+}
+
+bool FdSink::Open() {
+    offset = 0;
+    if (fd < 0)
+        return false;
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        JNI_LOGE("fstat %s: %s", Name(), strerror(errno));
+        return false;
+    }
+
+    // the core starts at offset 0 of a regular file, whatever came before
+    seekable = S_ISREG(sb.st_mode) || S_ISBLK(sb.st_mode);
+    if (seekable && lseek(fd, 0, SEEK_SET) < 0)
+        seekable = false;
+
+    // a collector going away fails the write, it must not kill the child
+    if (!seekable)
+        signal(SIGPIPE, SIG_IGN);
+
+    buffer.clear();
+    buffer.reserve(BUFFER_SIZE);
+    return true;
+}
+
+void FdSink::Close() {
+    if (fd < 0)
+        return;
+    Flush();
+    if (seekable)
+        fsync(fd);
+    if (own) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool FdSink::WriteFully(const void* data, uint64_t size) {
+    const uint8_t* pos = (const uint8_t *)data;
+    while (size) {
+        ssize_t ret = write(fd, pos, size);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        pos += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+bool FdSink::Flush() {
+    if (buffer.empty())
+        return true;
+    bool ok = WriteFully(buffer.data(), buffer.size());
+    buffer.clear();
+    return ok;
+}
+
+bool FdSink::Write(const void* data, uint64_t size) {
+    if (buffer.size() + size > BUFFER_SIZE) {
+        if (!Flush())
+            return false;
+        // large blocks (the note segment) go straight through
+        if (size >= BUFFER_SIZE) {
+            if (!WriteFully(data, size))
+                return false;
+            offset += size;
+            return true;
+        }
+    }
+    const uint8_t* pos = (const uint8_t *)data;
+    buffer.insert(buffer.end(), pos, pos + size);
+    offset += size;
+    return true;
+}
+
+bool FdSink::Skip(uint64_t pos) {
+    if (!seekable)
+        return OutputSink::Skip(pos);
+    // leave a hole
+    return pos <= offset || Seek(pos);
+}
+
+bool FdSink::Seek(uint64_t pos) {
+    if (!seekable || !Flush())
+        return false;
+    if (lseek(fd, pos, SEEK_SET) < 0)
+        return false;
+    offset = pos;
+    return true;
+}
+
+bool FdSink::WriteAt(const void* data, uint64_t size, uint64_t pos) {
+    if (!seekable || !Flush())
+        return false;
+    const uint8_t* src = (const uint8_t *)data;
+    uint64_t done = 0;
+    while (done < size) {
+        ssize_t ret = pwrite64(fd, src + done, size - done, pos + done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        done += ret;
+    }
+    return true;
+}
+
+const char* FdSink::Name() {
+    if (!name[0])
+        snprintf(name, sizeof(name), "fd:%d", fd);
+    return name;
+}
+
+bool FileSink::Open() {
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        JNI_LOGE("open %s: %s", path, strerror(errno));
+        return false;
+    }
+    own = true;
+    return FdSink::Open();
+}
+
+bool UnixSocketSink::Open() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    uint64_t len = strlen(path);
+    if (len >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, path, len);
+    // '@name' is the abstract namespace
+    if (path[0] == '@')
+        addr.sun_path[0] = '\0';
+    socklen_t addrlen = offsetof(struct sockaddr_un, sun_path) + len;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    own = true;
+    if (connect(fd, (struct sockaddr *)&addr, addrlen) < 0) {
+        JNI_LOGE("connect %s: %s", path, strerror(errno));
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return FdSink::Open();
+}
+
+const char* UnixSocketSink::Name() {
+    if (!name[0])
+        snprintf(name, sizeof(name), "unix:%s", path);
+    return name;
+}
+
+MemorySink::MemorySink(uint64_t capacity) : capacity(capacity) {
+    // shared, the dump child writes it and the parent reads it back
+    void* map = mmap(nullptr, sizeof(uint64_t) + capacity, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    region = map != MAP_FAILED ? (uint8_t *)map : nullptr;
+}
+
+MemorySink::~MemorySink() {
+    if (region)
+        munmap(region, sizeof(uint64_t) + capacity);
+}
+
+bool MemorySink::Open() {
+    offset = 0;
+    if (!region)
+        return false;
+    memset(region + sizeof(uint64_t), 0, Size());
+    *(volatile uint64_t *)region = 0;
+    return true;
+}
+
+bool MemorySink::Write(const void* data, uint64_t size) {
+    if (!WriteAt(data, size, offset))
+        return false;
+    offset += size;
+    return true;
+}
+
+bool MemorySink::Seek(uint64_t pos) {
+    if (pos > capacity)
+        return false;
+    offset = pos;
+    return true;
+}
+
+bool MemorySink::WriteAt(const void* data, uint64_t size, uint64_t pos) {
+    if (!region || pos + size > capacity) {
+        errno = ENOSPC;
+        return false;
+    }
+    memcpy(region + sizeof(uint64_t) + pos, data, size);
+    if (pos + size > Size())
+        *(volatile uint64_t *)region = pos + size;
+    return true;
+}
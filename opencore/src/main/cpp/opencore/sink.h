@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef OPENCORE_SINK_H_
+#define OPENCORE_SINK_H_
+
+#include <stdint.h>
+#include "opencore/arena.h"
+
+/*
+ * Where the core bytes go. The writer appends in file order, so every
+ * sink takes a core laid out sequentially; only seekable sinks also let
+ * it go back (program header rewrites on degrade) or hand their fd to
+ * in kernel copies.
+ *
+ *   FileSink        path, created and truncated
+ *   FdSink          caller's fd: a regular file from offset 0, or a pipe
+ *                   or socket streamed as is
+ *   UnixSocketSink  connects to a local collector, '@' for abstract names
+ *   MemorySink      shared anonymous buffer the parent reads after the
+ *                   dump child exits, for tests
+ *
+ * Open() and Close() run in the dump child. Whatever reads a pipe or
+ * socket must be another process, this one is stopped while dumping.
+ */
+class OutputSink {
+public:
+    OutputSink() : offset(0) {}
+    virtual ~OutputSink() {}
+
+    virtual bool Open() { offset = 0; return true; }
+    virtual void Close() {}
+    virtual bool Write(const void* data, uint64_t size) = 0;
+    virtual bool Flush() { return true; }
+    // forward to pos, a stream gets zeros in between
+    virtual bool Skip(uint64_t pos);
+    // seekable sinks only
+    virtual bool IsSeekable() { return false; }
+    virtual bool Seek(uint64_t pos) { return false; }
+    virtual bool WriteAt(const void* data, uint64_t size, uint64_t pos) { return false; }
+    // fd for copy_file_range and clones, -1 when there is none
+    virtual int Fd() { return -1; }
+    // backing file, nullptr unless the core lands in a named file
+    virtual const char* Path() { return nullptr; }
+    virtual const char* Name() = 0;
+    uint64_t Offset() { return offset; }
+protected:
+    uint64_t offset;
+};
+
+class FdSink : public OutputSink {
+public:
+    static constexpr int BUFFER_SIZE = 64 << 10;
+
+    FdSink(int fd) : fd(fd), own(false), seekable(false) { name[0] = '\0'; }
+    ~FdSink() { Close(); }
+
+    bool Open();
+    void Close();
+    bool Write(const void* data, uint64_t size);
+    bool Flush();
+    bool Skip(uint64_t pos);
+    bool IsSeekable() { return seekable; }
+    bool Seek(uint64_t pos);
+    bool WriteAt(const void* data, uint64_t size, uint64_t pos);
+    int Fd() { return fd; }
+    const char* Name();
+protected:
+    bool WriteFully(const void* data, uint64_t size);
+
+    int fd;
+    bool own;
+    bool seekable;
+    char name[32];
+    ArenaVector<uint8_t> buffer;
+};
+
+class FileSink : public FdSink {
+public:
+    FileSink(const char* path) : FdSink(-1), path(path) {}
+
+    bool Open();
+    const char* Path() { return path; }
+    const char* Name() { return path; }
+private:
+    const char* path;
+};
+
+class UnixSocketSink : public FdSink {
+public:
+    UnixSocketSink(const char* path) : FdSink(-1), path(path) {}
+
+    bool Open();
+    const char* Name();
+private:
+    const char* path;
+};
+
+class MemorySink : public OutputSink {
+public:
+    MemorySink(uint64_t capacity);
+    ~MemorySink();
+
+    bool Open();
+    bool Write(const void* data, uint64_t size);
+    bool IsSeekable() { return true; }
+    bool Seek(uint64_t pos);
+    bool WriteAt(const void* data, uint64_t size, uint64_t pos);
+    const char* Name() { return "memory"; }
+    const uint8_t* Data() { return region ? region + sizeof(uint64_t) : nullptr; }
+    // core bytes, valid in the parent once the dump returned
+    uint64_t Size() { return region ? *(volatile uint64_t *)region : 0; }
+private:
+    uint8_t* region;
+    uint64_t capacity;
+};
+
+#endif // OPENCORE_SINK_H_
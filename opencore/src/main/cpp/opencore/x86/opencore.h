@@ -17,7 +17,7 @@
 #ifndef OPENCORE_X86_OPENCORE_IMPL_H_
 #define OPENCORE_X86_OPENCORE_IMPL_H_
 
-#include "opencore/lp32/opencore.h"
+#include "opencore/elfcore.h"
 
 namespace x86 {
 
@@ -51,18 +51,21 @@ typedef struct elf32_prstatus {
     uint32_t             pr_fpvalid;
 } Elf32_prstatus;
 
-class Opencore : public lp32::OpencoreImpl {
-public:
-    Opencore() : lp32::OpencoreImpl() {}
-    void Finish();
-    void CreateCorePrStatus(int pid);
-    void WriteCorePrStatus(FILE* fp);
-    int IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma);
-    int getMachine() { return EM_386; }
-private:
-    std::vector<Elf32_prstatus> prstatus;
+struct Arch {
+    typedef x86::pt_regs Regs;
+    typedef Elf32_prstatus Prstatus;
+    static constexpr int MACHINE = EM_386;
+    static void ContextRegs(void* ucontext, Regs* regs);
+    static int ListRegs(Prstatus& prstatus, uint64_t* out);
+    static uint64_t ProgramCounter(Prstatus& prstatus) { return prstatus.pr_reg.eip; }
+    static uint64_t StackPointer(Prstatus& prstatus) { return prstatus.pr_reg.esp; }
+    static void BuildThreadNotes(NoteBuilder& notes, int tid) {}
 };
 
+typedef ElfCoreWriter<Elf32Class, Arch> Opencore;
+
 } // namespace x86
 
+extern template class ElfCoreWriter<Elf32Class, x86::Arch>;
+
 #endif // OPENCORE_X86_OPENCORE_IMPL_H_
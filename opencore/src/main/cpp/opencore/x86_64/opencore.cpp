@@ -20,6 +20,7 @@
 
 #include "eajnis/Log.h"
 #include "opencore/x86_64/opencore.h"
+#include "opencore/elfcore-inl.h"
 #include <sys/ptrace.h>
 #include <sys/uio.h>
 #include <errno.h>
@@ -28,122 +29,57 @@
 
 namespace x86_64 {
 
-void Opencore::CreateCorePrStatus(int pid) {
-    if (!threads.size()) return;
-
-    prstatus.assign(threads.size(), {});
-    int prnum = (int)prstatus.size();
-
-    int cur = 1;
-    for (int index = 0; index < prnum; index++) {
-        pid_t tid = threads[index].pid;
-        int idx;
-        if (tid == getTid()) {
-            idx = 0;
-            prstatus[idx].pr_pid = tid;
-            // top thread maybe use ucontext prs
-            if (getContext()) {
-                struct ucontext *context = (struct ucontext *) getContext();
-                x86_64::pt_regs uc_regs;
-                memset(&uc_regs, 0x0, sizeof(x86_64::pt_regs));
-                uc_regs.r15 = context->uc_mcontext.gregs[7];
-                uc_regs.r14 = context->uc_mcontext.gregs[6];
-                uc_regs.r13 = context->uc_mcontext.gregs[5];
-                uc_regs.r12 = context->uc_mcontext.gregs[4];
-                uc_regs.rbp = context->uc_mcontext.gregs[10];
-                uc_regs.rbx = context->uc_mcontext.gregs[11];
-                uc_regs.r11 = context->uc_mcontext.gregs[3];
-                uc_regs.r10 = context->uc_mcontext.gregs[2];
-                uc_regs.r9 = context->uc_mcontext.gregs[1];
-                uc_regs.r8 = context->uc_mcontext.gregs[0];
-                uc_regs.rax = context->uc_mcontext.gregs[13];
-                uc_regs.rcx = context->uc_mcontext.gregs[14];
-                uc_regs.rdx = context->uc_mcontext.gregs[12];
-                uc_regs.rsi = context->uc_mcontext.gregs[9];
-                uc_regs.rdi = context->uc_mcontext.gregs[8];
-                uc_regs.rip = context->uc_mcontext.gregs[16];
-                uc_regs.cs = context->uc_mcontext.gregs[18];
-                uc_regs.flags = context->uc_mcontext.gregs[17];
-                uc_regs.rsp = context->uc_mcontext.gregs[15];
-                uc_regs.ss = context->uc_mcontext.gregs[21];
-                uc_regs.fs = context->uc_mcontext.gregs[20];
-                uc_regs.gs = context->uc_mcontext.gregs[19];
-                memcpy(&prstatus[idx].pr_reg, &uc_regs, sizeof(x86_64::pt_regs));
-                continue;
-            }
-        } else {
-            // 0 top thread was truncated
-            idx = (cur >= prnum) ? 0 : cur;
-            ++cur;
-            prstatus[idx].pr_pid = tid;
-        }
-
-        struct iovec ioVec = {
-            &prstatus[idx].pr_reg,
-            sizeof(x86_64::pt_regs),
-        };
-
-        if (ptrace(PTRACE_GETREGSET, tid, NT_PRSTATUS, &ioVec) < 0)
-            continue;
-    }
-
-    extra_note_filesz += (sizeof(Elf64_prstatus) + sizeof(Elf64_Nhdr) + 8) * prnum;
-    extra_note_filesz += sizeof(siginfo_t) + sizeof(Elf64_Nhdr) + 8;      // NT_SIGINFO
-}
-
-void Opencore::WriteCorePrStatus(FILE* fp) {
-    Elf64_Nhdr elf_nhdr;
-    elf_nhdr.n_namesz = NOTE_CORE_NAME_SZ;
-    elf_nhdr.n_descsz = sizeof(Elf64_prstatus);
-    elf_nhdr.n_type = NT_PRSTATUS;
-
-    char magic[8];
-    memset(magic, 0, sizeof(magic));
-    snprintf(magic, NOTE_CORE_NAME_SZ, ELFCOREMAGIC);
-
-    int prnum = (int)prstatus.size();
-    for (int index = 0; index < prnum; index++) {
-        fwrite(&elf_nhdr, sizeof(Elf64_Nhdr), 1, fp);
-        fwrite(magic, sizeof(magic), 1, fp);
-        fwrite(&prstatus[index], sizeof(Elf64_prstatus), 1, fp);
-        if (!index) WriteCoreSignalInfo(fp);
-    }
+void Arch::ContextRegs(void* ucontext, Regs* regs) {
+    ucontext_t *context = (ucontext_t *) ucontext;
+    x86_64::pt_regs uc_regs;
+    memset(&uc_regs, 0x0, sizeof(x86_64::pt_regs));
+    uc_regs.r15 = context->uc_mcontext.gregs[7];
+    uc_regs.r14 = context->uc_mcontext.gregs[6];
+    uc_regs.r13 = context->uc_mcontext.gregs[5];
+    uc_regs.r12 = context->uc_mcontext.gregs[4];
+    uc_regs.rbp = context->uc_mcontext.gregs[10];
+    uc_regs.rbx = context->uc_mcontext.gregs[11];
+    uc_regs.r11 = context->uc_mcontext.gregs[3];
+    uc_regs.r10 = context->uc_mcontext.gregs[2];
+    uc_regs.r9 = context->uc_mcontext.gregs[1];
+    uc_regs.r8 = context->uc_mcontext.gregs[0];
+    uc_regs.rax = context->uc_mcontext.gregs[13];
+    uc_regs.rcx = context->uc_mcontext.gregs[14];
+    uc_regs.rdx = context->uc_mcontext.gregs[12];
+    uc_regs.rsi = context->uc_mcontext.gregs[9];
+    uc_regs.rdi = context->uc_mcontext.gregs[8];
+    uc_regs.rip = context->uc_mcontext.gregs[16];
+    uc_regs.cs = context->uc_mcontext.gregs[18];
+    uc_regs.flags = context->uc_mcontext.gregs[17];
+    uc_regs.rsp = context->uc_mcontext.gregs[15];
+    uc_regs.ss = context->uc_mcontext.gregs[21];
+    uc_regs.fs = context->uc_mcontext.gregs[20];
+    uc_regs.gs = context->uc_mcontext.gregs[19];
+    memcpy(regs, &uc_regs, sizeof(x86_64::pt_regs));
 }
 
-int Opencore::IsSpecialFilterSegment(Opencore::VirtualMemoryArea& vma) {
-    int filter = getFilter();
-    if (filter & FILTER_MINIDUMP) {
-        if (prstatus.empty())
-            return VMA_NULL;
-
-        x86_64::pt_regs *regs = &prstatus[0].pr_reg;
-        if (regs->r15 >= vma.begin && regs->r15 < vma.end
-                || regs->r14 >= vma.begin && regs->r14 < vma.end
-                || regs->r13 >= vma.begin && regs->r13 < vma.end
-                || regs->r12 >= vma.begin && regs->r12 < vma.end
-                || regs->rbp >= vma.begin && regs->rbp < vma.end
-                || regs->rbx >= vma.begin && regs->rbx < vma.end
-                || regs->r11 >= vma.begin && regs->r11 < vma.end
-                || regs->r10 >= vma.begin && regs->r10 < vma.end
-                || regs->r9 >= vma.begin && regs->r9 < vma.end
-                || regs->r8 >= vma.begin && regs->r8 < vma.end
-                || regs->rax >= vma.begin && regs->rax < vma.end
-                || regs->rcx >= vma.begin && regs->rcx < vma.end
-                || regs->rdx >= vma.begin && regs->rdx < vma.end
-                || regs->rsi >= vma.begin && regs->rsi < vma.end
-                || regs->rdi >= vma.begin && regs->rdi < vma.end
-                || regs->rip >= vma.begin && regs->rip < vma.end) {
-            return VMA_INCLUDE;
-        }
-
-        return VMA_NULL;
-    }
-    return VMA_NORMAL;
-}
-
-void Opencore::Finish() {
-    prstatus.clear();
-    lp64::OpencoreImpl::Finish();
+int Arch::ListRegs(Prstatus& prstatus, uint64_t* out) {
+    int num = 0;
+    out[num++] = prstatus.pr_reg.r15;
+    out[num++] = prstatus.pr_reg.r14;
+    out[num++] = prstatus.pr_reg.r13;
+    out[num++] = prstatus.pr_reg.r12;
+    out[num++] = prstatus.pr_reg.rbp;
+    out[num++] = prstatus.pr_reg.rbx;
+    out[num++] = prstatus.pr_reg.r11;
+    out[num++] = prstatus.pr_reg.r10;
+    out[num++] = prstatus.pr_reg.r9;
+    out[num++] = prstatus.pr_reg.r8;
+    out[num++] = prstatus.pr_reg.rax;
+    out[num++] = prstatus.pr_reg.rcx;
+    out[num++] = prstatus.pr_reg.rdx;
+    out[num++] = prstatus.pr_reg.rsi;
+    out[num++] = prstatus.pr_reg.rdi;
+    out[num++] = prstatus.pr_reg.rip;
+    out[num++] = prstatus.pr_reg.rsp;
+    return num;
 }
 
 } // namespace x86_64
+
+template class ElfCoreWriter<Elf64Class, x86_64::Arch>;
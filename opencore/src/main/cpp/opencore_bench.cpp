@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "opencore/opencore.h"
+#include "eajnis/Log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+ * Dump benchmark on synthetic targets. Each scenario forks a target that
+ * lays out its memory and parks, then the regular Dump pipeline runs
+ * against it, repeat times. Engine numbers come from GetLastStats, the
+ * target side (resident, swapped) from /proc/<pid>/status.
+ *
+ *   opencore-bench -s name:threads=8,vmas=64,rss=256M,zero=0.5,swap=0.1,file=64M
+ */
+
+// linux/mman.h of older sysroots lacks it
+static constexpr int kMadvPageout = 21;
+
+struct Scenario {
+    std::string name;
+    int threads = 1;
+    int vmas = 16;
+    uint64_t rss = 64 << 20;
+    double zero = 0.0;
+    double swap = 0.0;
+    uint64_t file = 0;
+    int filter = Opencore::FILTER_NONE;
+};
+
+static const char* kDefaults[] = {
+    "baseline:threads=1,vmas=16,rss=64M",
+    "threads:threads=64,vmas=16,rss=64M",
+    "vmas:threads=1,vmas=4096,rss=64M",
+    "large:threads=8,vmas=64,rss=512M",
+    "zero:threads=1,vmas=16,rss=256M,zero=0.75",
+    "swap:threads=1,vmas=16,rss=256M,swap=0.5",
+    "file:threads=1,vmas=16,rss=64M,file=256M",
+};
+
+static void Usage() {
+    printf("Usage: opencore-bench [-d <dir>] [-r <repeat>] [-o <json>] [--keep] [-s <scenario>]...\n");
+    printf("Dump synthetic targets and report the numbers as json.\n");
+    printf("  -d  core dir, default /tmp\n");
+    printf("  -r  dumps per scenario, default 3\n");
+    printf("  -o  json output, default stdout\n");
+    printf("  -s  name:key=value,... keys threads vmas rss zero swap file filter,\n");
+    printf("      sizes take K/M/G, repeatable, default the built-in set:\n");
+    for (const char* scenario : kDefaults)
+        printf("        %s\n", scenario);
+}
+
+static uint64_t ParseSize(const char* value) {
+    char* end;
+    uint64_t size = strtoull(value, &end, 0);
+    switch (*end) {
+        case 'G': case 'g': size <<= 10;
+        case 'M': case 'm': size <<= 10;
+        case 'K': case 'k': size <<= 10;
+    }
+    return size;
+}
+
+static bool ParseScenario(const char* arg, Scenario* scenario) {
+    std::string spec = arg;
+    size_t colon = spec.find(':');
+    scenario->name = spec.substr(0, colon);
+    if (colon == std::string::npos)
+        return !scenario->name.empty();
+
+    size_t pos = colon + 1;
+    while (pos < spec.length()) {
+        size_t split = spec.find(',', pos);
+        if (split == std::string::npos)
+            split = spec.length();
+        std::string item = spec.substr(pos, split - pos);
+        pos = split + 1;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            return false;
+        std::string key = item.substr(0, eq);
+        const char* value = item.c_str() + eq + 1;
+        if (key == "threads") {
+            scenario->threads = atoi(value);
+        } else if (key == "vmas") {
+            scenario->vmas = atoi(value);
+        } else if (key == "rss") {
+            scenario->rss = ParseSize(value);
+        } else if (key == "zero") {
+            scenario->zero = atof(value);
+        } else if (key == "swap") {
+            scenario->swap = atof(value);
+        } else if (key == "file") {
+            scenario->file = ParseSize(value);
+        } else if (key == "filter") {
+            scenario->filter = strtol(value, nullptr, 0);
+        } else {
+            fprintf(stderr, "unknown key %s.\n", key.c_str());
+            return false;
+        }
+    }
+    return scenario->threads > 0 && scenario->vmas > 0;
+}
+
+static void* ParkThread(void*) {
+    for (;;)
+        pause();
+    return nullptr;
+}
+
+// incompressible and never a duplicate page, so dedup and gzip can't cheat
+static void FillPage(uint8_t* page, uint64_t size, uint64_t seed) {
+    uint64_t x = seed * 0x9e3779b97f4a7c15ULL + 1;
+    for (uint64_t i = 0; i + 8 <= size; i += 8) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        memcpy(page + i, &x, 8);
+    }
+}
+
+static bool BuildTarget(Scenario& scenario, const std::string& file_path) {
+    uint64_t page = sysconf(_SC_PAGE_SIZE);
+    uint64_t per_vma = std::max(page, scenario.rss / scenario.vmas / page * page);
+    uint64_t seed = 1;
+    for (int i = 0; i < scenario.vmas; ++i) {
+        // one guard page behind each, neighbours never merge into one vma
+        uint8_t* base = (uint8_t *)mmap(nullptr, per_vma + page, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            return false;
+        mprotect(base + per_vma, page, PROT_NONE);
+
+        uint64_t pages = per_vma / page;
+        uint64_t zeros = pages * scenario.zero;
+        for (uint64_t k = 0; k < pages; ++k) {
+            // zero pages are resident too, written not just mapped
+            if (k < zeros)
+                base[k * page] = 0;
+            else
+                FillPage(base + k * page, page, seed++);
+        }
+
+        uint64_t swapped = (uint64_t)(pages * scenario.swap) * page;
+        if (swapped)
+            madvise(base + per_vma - swapped, swapped, kMadvPageout);
+    }
+
+    if (scenario.file) {
+        int fd = open(file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+            return false;
+        std::vector<uint8_t> chunk(page);
+        for (uint64_t off = 0; off < scenario.file; off += page) {
+            FillPage(chunk.data(), page, seed++);
+            if (write(fd, chunk.data(), page) != (ssize_t)page)
+                return false;
+        }
+        uint8_t* map = (uint8_t *)mmap(nullptr, scenario.file, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+            return false;
+        volatile uint8_t sum = 0;
+        for (uint64_t off = 0; off < scenario.file; off += page)
+            sum += map[off];
+    }
+
+    for (int i = 1; i < scenario.threads; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, ParkThread, nullptr))
+            return false;
+    }
+    return true;
+}
+
+static pid_t SpawnTarget(Scenario& scenario, const std::string& file_path) {
+    int fds[2];
+    if (pipe(fds) < 0)
+        return -1;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        char ready = BuildTarget(scenario, file_path) ? 1 : 0;
+        write(fds[1], &ready, 1);
+        close(fds[1]);
+        for (;;)
+            pause();
+    }
+
+    close(fds[1]);
+    char ready = 0;
+    if (pid < 0 || read(fds[0], &ready, 1) != 1 || !ready) {
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        pid = -1;
+    }
+    close(fds[0]);
+    return pid;
+}
+
+static void ReadTargetStatus(pid_t pid, uint64_t* rss_kb, uint64_t* swap_kb) {
+    char path[64];
+    char line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    *rss_kb = *swap_kb = 0;
+    FILE* fp = fopen(path, "re");
+    if (!fp)
+        return;
+    while (fgets(line, sizeof(line), fp)) {
+        if (!strncmp(line, "VmRSS:", 6))
+            *rss_kb = strtoull(line + 6, nullptr, 10);
+        else if (!strncmp(line, "VmSwap:", 7))
+            *swap_kb = strtoull(line + 7, nullptr, 10);
+    }
+    fclose(fp);
+}
+
+static uint64_t Median(std::vector<uint64_t> values) {
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    std::string dir = "/tmp";
+    std::string json_path;
+    int repeat = 3;
+    bool keep = false;
+    std::vector<Scenario> scenarios;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (!strcmp(argv[i], "--keep")) {
+            keep = true;
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            Scenario scenario;
+            if (!ParseScenario(argv[++i], &scenario)) {
+                fprintf(stderr, "bad scenario %s.\n", argv[i]);
+                return 1;
+            }
+            scenarios.push_back(scenario);
+        } else {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (repeat < 1) {
+        Usage();
+        return 1;
+    }
+    if (scenarios.empty()) {
+        for (const char* spec : kDefaults) {
+            Scenario scenario;
+            ParseScenario(spec, &scenario);
+            scenarios.push_back(scenario);
+        }
+    }
+    if (!Opencore::GetInstance()) {
+        fprintf(stderr, "no opencore writer for this architecture.\n");
+        return 1;
+    }
+    // the numbers are the point, engine logs only when something is off
+    jni_log_set_priority(ANDROID_LOG_WARN);
+
+    std::string json = "{\"version\":\"";
+    json.append(Opencore::GetVersion()).append("\",\"repeat\":");
+    json.append(std::to_string(repeat)).append(",\"scenarios\":[");
+
+    char buf[512];
+    int failed = 0;
+    for (uint64_t s = 0; s < scenarios.size(); ++s) {
+        Scenario& scenario = scenarios[s];
+        std::string core = dir + "/bench." + scenario.name + ".core";
+        std::string file_path = dir + "/bench." + scenario.name + ".data";
+        fprintf(stderr, "%s ...\n", scenario.name.c_str());
+
+        pid_t pid = SpawnTarget(scenario, file_path);
+        if (pid < 0) {
+            fprintf(stderr, "%s: target setup failed.\n", scenario.name.c_str());
+            unlink(file_path.c_str());
+            failed++;
+            continue;
+        }
+
+        uint64_t rss_kb, swap_kb;
+        ReadTargetStatus(pid, &rss_kb, &swap_kb);
+        Opencore::SetFilter(scenario.filter);
+
+        std::string runs;
+        std::vector<uint64_t> totals, freezes, first_bytes, rates;
+        for (int r = 0; r < repeat; ++r) {
+            Opencore::DumpOption option;
+            option.pid = pid;
+            option.tid = pid;
+            option.filename = const_cast<char *>(core.c_str());
+            Opencore::Dump(&option);
+
+            Opencore::DumpStats stats;
+            struct stat sb;
+            if (!Opencore::GetLastStats(&stats) || stat(core.c_str(), &sb) || !stats.bytes) {
+                fprintf(stderr, "%s: dump %d failed.\n", scenario.name.c_str(), r);
+                failed++;
+                continue;
+            }
+
+            totals.push_back(stats.total);
+            freezes.push_back(stats.freeze);
+            first_bytes.push_back(stats.first_byte);
+            rates.push_back(stats.total ? stats.bytes * 1000000 / stats.total / (1 << 20) : 0);
+            std::string one = Opencore::GetLastStatsJson();
+            // disk usage next to the logical size, holes and dedup show here
+            snprintf(buf, sizeof(buf), ",\"disk_bytes\":%" PRIu64 "}", (uint64_t)sb.st_blocks * 512);
+            one.replace(one.length() - 1, 1, buf);
+            if (!runs.empty())
+                runs.append(",");
+            runs.append(one);
+            if (!keep)
+                unlink(core.c_str());
+        }
+
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        unlink(file_path.c_str());
+
+        snprintf(buf, sizeof(buf),
+                 "%s{\"name\":\"%s\",\"threads\":%d,\"vmas\":%d,\"rss\":%" PRIu64 ","
+                 "\"zero\":%.2f,\"swap\":%.2f,\"file\":%" PRIu64 ",\"filter\":%d,"
+                 "\"target_rss_kb\":%" PRIu64 ",\"target_swap_kb\":%" PRIu64 ",",
+                 s ? "," : "", scenario.name.c_str(), scenario.threads, scenario.vmas,
+                 scenario.rss, scenario.zero, scenario.swap, scenario.file, scenario.filter,
+                 rss_kb, swap_kb);
+        json.append(buf);
+        snprintf(buf, sizeof(buf),
+                 "\"median\":{\"freeze_us\":%" PRIu64 ",\"first_byte_us\":%" PRIu64 ","
+                 "\"total_us\":%" PRIu64 ",\"mb_per_s\":%" PRIu64 "},\"runs\":[",
+                 Median(freezes), Median(first_bytes), Median(totals), Median(rates));
+        json.append(buf).append(runs).append("]}");
+    }
+    json.append("]}\n");
+
+    FILE* out = json_path.empty() ? stdout : fopen(json_path.c_str(), "w");
+    if (!out) {
+        fprintf(stderr, "open %s: %s\n", json_path.c_str(), strerror(errno));
+        return 1;
+    }
+    fputs(json.c_str(), out);
+    if (out != stdout)
+        fclose(out);
+    return failed ? 2 : 0;
+}
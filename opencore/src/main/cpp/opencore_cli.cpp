@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TAG
+#define LOG_TAG "opencore"
+#endif
+
+#include "opencore/opencore.h"
+#include "opencore/retention.h"
+#include "opencore/sink.h"
+#include "eajnis/Log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <syslog.h>
+#include <sys/stat.h>
+#include <string>
+
+/*
+ * Host side dumper, the same DoCoredump pipeline the SDK runs in app
+ * processes, pointed at another pid. Attaching needs ptrace rights on
+ * the target: root, or the same uid with kernel.yama.ptrace_scope 0.
+ */
+
+struct FilterName {
+    const char* name;
+    int bit;
+};
+
+static const FilterName kFilters[] = {
+    { "special", Opencore::FILTER_SPECIAL_VMA },
+    { "file", Opencore::FILTER_FILE_VMA },
+    { "shared", Opencore::FILTER_SHARED_VMA },
+    { "shadow", Opencore::FILTER_SANITIZER_SHADOW_VMA },
+    { "non-read", Opencore::FILTER_NON_READ_VMA },
+    { "context", Opencore::FILTER_SIGNAL_CONTEXT },
+    { "minidump", Opencore::FILTER_MINIDUMP },
+    { "javaheap", Opencore::FILTER_JAVAHEAP_VMA },
+    { "jit", Opencore::FILTER_JIT_CACHE_VMA },
+    { "window", Opencore::FILTER_MINIDUMP_WINDOW },
+    { "reachable", Opencore::FILTER_MINIDUMP_REACHABLE },
+    { "device", Opencore::FILTER_DEVICE_VMA },
+    { "non-resident", Opencore::FILTER_NON_RESIDENT_VMA },
+    { "clean-file", Opencore::FILTER_CLEAN_FILE_PAGE },
+    { "jit-pc", Opencore::FILTER_JIT_CACHE_PC },
+};
+
+static void Usage() {
+    printf("Usage: opencore [options] <pid>\n");
+    printf("Dump a running process with the opencore engine.\n");
+    printf("  -o, --output <file>     core file, under <dir> unless absolute,\n");
+    printf("                          default <dir>/core.<comm>_<pid>...\n");
+    printf("  -d, --dir <dir>         core dir, retention applies here\n");
+    printf("  -t, --tid <tid>         thread reported first, default the main thread\n");
+    printf("  -f, --filter <filters>  bits or names joined by ',':\n");
+    printf("                         ");
+    for (const FilterName& filter : kFilters)
+        printf(" %s", filter.name);
+    printf("\n");
+    printf("      --flag <bits>       output name flags, FLAG_* of opencore.h\n");
+    printf("      --timeout <sec>     give up after, default %d\n", Opencore::DEF_TIMEOUT);
+    printf("      --page-window <n>   minidump window pages around registers\n");
+    printf("      --reach-depth <n>   minidump reachable depth\n");
+    printf("      --reach-budget <b>  minidump reachable bytes\n");
+    printf("      --reach-roots <l>   minidump root libraries, ',' joined\n");
+    printf("      --rules <rules>     vma rules, see setCoreRules\n");
+    printf("      --swap <policy>     include, skip or budget\n");
+    printf("      --swap-budget <b>   swapped bytes read back under budget\n");
+    printf("      --working-set <ms>  sample the working set for ms first\n");
+    printf("      --dedup             page store next to the core\n");
+    printf("      --incremental       later dumps of --count only keep dirty pages\n");
+    printf("      --baseline <pid>:<core>  omit pages shared with a dumped process\n");
+    printf("      --quota <bytes>     core dir quota\n");
+    printf("      --max-files <n>     core dir file limit\n");
+    printf("      --max-age <sec>     core dir age limit\n");
+    printf("      --compact           compress older cores once done\n");
+    printf("      --fd <fd>           write to an open fd instead, '-' is stdout\n");
+    printf("      --unix <path>       write to a unix socket, '@' abstract\n");
+    printf("  -n, --count <n>         dump n times, --interval ms apart\n");
+    printf("      --interval <ms>\n");
+    printf("      --plan              print the layout plan json, no dump\n");
+    printf("      --measure           plan with read throughput sampled\n");
+    printf("      --syslog            engine log to syslog instead of stderr\n");
+    printf("  -v, --verbose           debug log\n");
+    printf("  -q, --quiet             warnings and errors only\n");
+}
+
+static bool ParseFilter(const char* arg, int* filter) {
+    char* end;
+    long value = strtol(arg, &end, 0);
+    if (*arg && !*end) {
+        *filter = value;
+        return true;
+    }
+
+    std::string names = arg;
+    *filter = 0;
+    size_t pos = 0;
+    while (pos <= names.length()) {
+        size_t split = names.find(',', pos);
+        if (split == std::string::npos)
+            split = names.length();
+        std::string name = names.substr(pos, split - pos);
+        pos = split + 1;
+        if (name.empty())
+            continue;
+
+        bool found = false;
+        for (const FilterName& filter_name : kFilters) {
+            if (name == filter_name.name) {
+                *filter |= filter_name.bit;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "unknown filter %s.\n", name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ParseSwap(const char* arg, int* policy) {
+    if (!strcmp(arg, "include")) {
+        *policy = Opencore::SWAP_INCLUDE;
+    } else if (!strcmp(arg, "skip")) {
+        *policy = Opencore::SWAP_SKIP;
+    } else if (!strcmp(arg, "budget")) {
+        *policy = Opencore::SWAP_BUDGET;
+    } else {
+        fprintf(stderr, "unknown swap policy %s.\n", arg);
+        return false;
+    }
+    return true;
+}
+
+static std::string g_output;
+
+static void OnDumped(const char* filepath) {
+    g_output = filepath;
+}
+
+enum {
+    OPT_FLAG = 0x100,
+    OPT_TIMEOUT,
+    OPT_PAGE_WINDOW,
+    OPT_REACH_DEPTH,
+    OPT_REACH_BUDGET,
+    OPT_REACH_ROOTS,
+    OPT_RULES,
+    OPT_SWAP,
+    OPT_SWAP_BUDGET,
+    OPT_WORKING_SET,
+    OPT_DEDUP,
+    OPT_INCREMENTAL,
+    OPT_BASELINE,
+    OPT_QUOTA,
+    OPT_MAX_FILES,
+    OPT_MAX_AGE,
+    OPT_COMPACT,
+    OPT_FD,
+    OPT_UNIX,
+    OPT_INTERVAL,
+    OPT_PLAN,
+    OPT_MEASURE,
+    OPT_SYSLOG,
+};
+
+static const struct option kOptions[] = {
+    { "output", required_argument, nullptr, 'o' },
+    { "dir", required_argument, nullptr, 'd' },
+    { "tid", required_argument, nullptr, 't' },
+    { "filter", required_argument, nullptr, 'f' },
+    { "flag", required_argument, nullptr, OPT_FLAG },
+    { "timeout", required_argument, nullptr, OPT_TIMEOUT },
+    { "page-window", required_argument, nullptr, OPT_PAGE_WINDOW },
+    { "reach-depth", required_argument, nullptr, OPT_REACH_DEPTH },
+    { "reach-budget", required_argument, nullptr, OPT_REACH_BUDGET },
+    { "reach-roots", required_argument, nullptr, OPT_REACH_ROOTS },
+    { "rules", required_argument, nullptr, OPT_RULES },
+    { "swap", required_argument, nullptr, OPT_SWAP },
+    { "swap-budget", required_argument, nullptr, OPT_SWAP_BUDGET },
+    { "working-set", required_argument, nullptr, OPT_WORKING_SET },
+    { "dedup", no_argument, nullptr, OPT_DEDUP },
+    { "incremental", no_argument, nullptr, OPT_INCREMENTAL },
+    { "baseline", required_argument, nullptr, OPT_BASELINE },
+    { "quota", required_argument, nullptr, OPT_QUOTA },
+    { "max-files", required_argument, nullptr, OPT_MAX_FILES },
+    { "max-age", required_argument, nullptr, OPT_MAX_AGE },
+    { "compact", no_argument, nullptr, OPT_COMPACT },
+    { "fd", required_argument, nullptr, OPT_FD },
+    { "unix", required_argument, nullptr, OPT_UNIX },
+    { "count", required_argument, nullptr, 'n' },
+    { "interval", required_argument, nullptr, OPT_INTERVAL },
+    { "plan", no_argument, nullptr, OPT_PLAN },
+    { "measure", no_argument, nullptr, OPT_MEASURE },
+    { "syslog", no_argument, nullptr, OPT_SYSLOG },
+    { "verbose", no_argument, nullptr, 'v' },
+    { "quiet", no_argument, nullptr, 'q' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 },
+};
+
+int main(int argc, char** argv) {
+    const char* output = nullptr;
+    const char* dir = nullptr;
+    const char* unix_path = nullptr;
+    int tid = 0;
+    int fd = -1;
+    int count = 1;
+    int interval = 0;
+    bool plan = false;
+    bool measure = false;
+    bool compact = false;
+    uint64_t quota = 0;
+    int max_files = 0;
+    int max_age = 0;
+
+    if (!Opencore::GetInstance()) {
+        fprintf(stderr, "no opencore writer for this architecture.\n");
+        return 1;
+    }
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:d:t:f:n:vqh", kOptions, nullptr)) != -1) {
+        int value;
+        switch (opt) {
+            case 'o': output = optarg; break;
+            case 'd': dir = optarg; break;
+            case 't': tid = atoi(optarg); break;
+            case 'f':
+                if (!ParseFilter(optarg, &value))
+                    return 1;
+                Opencore::SetFilter(value);
+                break;
+            case OPT_FLAG: Opencore::SetFlag(strtol(optarg, nullptr, 0)); break;
+            case OPT_TIMEOUT: Opencore::SetTimeout(atoi(optarg)); break;
+            case OPT_PAGE_WINDOW: Opencore::SetPageWindow(atoi(optarg)); break;
+            case OPT_REACH_DEPTH: Opencore::SetReachDepth(atoi(optarg)); break;
+            case OPT_REACH_BUDGET: Opencore::SetReachBudget(strtoull(optarg, nullptr, 0)); break;
+            case OPT_REACH_ROOTS: Opencore::SetReachRoots(optarg); break;
+            case OPT_RULES:
+                if (!Opencore::SetRules(optarg)) {
+                    fprintf(stderr, "bad rules %s.\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_SWAP:
+                if (!ParseSwap(optarg, &value))
+                    return 1;
+                Opencore::SetSwapPolicy(value);
+                break;
+            case OPT_SWAP_BUDGET: Opencore::SetSwapBudget(strtoull(optarg, nullptr, 0)); break;
+            case OPT_WORKING_SET: Opencore::SetWorkingSet(atoi(optarg)); break;
+            case OPT_DEDUP: Opencore::SetDedup(true); break;
+            case OPT_INCREMENTAL: Opencore::SetIncremental(true); break;
+            case OPT_BASELINE: {
+                const char* core = strchr(optarg, ':');
+                if (!core) {
+                    Usage();
+                    return 1;
+                }
+                Opencore::SetBaseline(atoi(optarg), core + 1);
+                break;
+            }
+            case OPT_QUOTA: quota = strtoull(optarg, nullptr, 0); break;
+            case OPT_MAX_FILES: max_files = atoi(optarg); break;
+            case OPT_MAX_AGE: max_age = atoi(optarg); break;
+            case OPT_COMPACT: compact = true; break;
+            case OPT_FD: fd = !strcmp(optarg, "-") ? STDOUT_FILENO : atoi(optarg); break;
+            case OPT_UNIX: unix_path = optarg; break;
+            case 'n': count = atoi(optarg); break;
+            case OPT_INTERVAL: interval = atoi(optarg); break;
+            case OPT_PLAN: plan = true; break;
+            case OPT_MEASURE: plan = measure = true; break;
+            case OPT_SYSLOG:
+                openlog("opencore", LOG_PID, LOG_USER);
+                jni_log_set_backend(JNI_LOG_SYSLOG);
+                break;
+            case 'v': jni_log_set_priority(ANDROID_LOG_VERBOSE); break;
+            case 'q': jni_log_set_priority(ANDROID_LOG_WARN); break;
+            default:
+                Usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind != argc - 1 || count < 1) {
+        Usage();
+        return 1;
+    }
+
+    int pid = atoi(argv[optind]);
+    if (pid <= 0 || kill(pid, 0)) {
+        fprintf(stderr, "no process %s.\n", argv[optind]);
+        return 1;
+    }
+    if (!tid)
+        tid = pid;
+
+    if (plan) {
+        std::string json = Opencore::Plan(pid, tid, measure);
+        if (json.empty())
+            return 1;
+        printf("%s\n", json.c_str());
+        return 0;
+    }
+
+    if (dir)
+        Opencore::SetDir(dir);
+    Opencore::SetQuota(quota);
+    Opencore::SetMaxFiles(max_files);
+    Opencore::SetMaxAge(max_age);
+    Opencore::SetCallback(OnDumped);
+
+    OutputSink* sink = nullptr;
+    if (fd >= 0) {
+        sink = new FdSink(fd);
+    } else if (unix_path) {
+        sink = new UnixSocketSink(unix_path);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < count; ++i) {
+        if (i && interval)
+            usleep(interval * 1000);
+
+        std::string name;
+        if (output) {
+            name = output;
+            if (count > 1)
+                name += "." + std::to_string(i);
+        }
+
+        Opencore::DumpOption option;
+        option.pid = pid;
+        option.tid = tid;
+        option.filename = name.empty() ? nullptr : const_cast<char *>(name.c_str());
+        option.sink = sink;
+        g_output.clear();
+        Opencore::Dump(&option);
+
+        // a file that never got its header is a failed dump
+        struct stat sb;
+        bool done = !g_output.empty()
+                && (sink || (!stat(g_output.c_str(), &sb) && sb.st_size > 0));
+        if (!done)
+            failed++;
+        fprintf(stderr, "%s %s\n", done ? "dumped" : "failed", g_output.c_str());
+    }
+    // the SDK compacts on a background thread, here we wait for it
+    if (compact && !sink) {
+        ArenaVector<ArenaString> keep;
+        Opencore::GetKeptCores(keep);
+        Retention::Compact(dir ? dir : ".", nullptr, keep);
+    }
+    delete sink;
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "opencore/opencore.h"
+#include "opencore/dedup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <link.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/*
+ * The crash path must not touch the heap, the fault may be the heap
+ * itself. malloc is interposed here and counts every call made after the
+ * victim armed it: the signal handler, the dump and the dumper child all
+ * count into one shared page. Only the faulting thread is armed, so a
+ * background compaction left by a warm up dump does not count. Each mode
+ * runs in its own victim that enables the handlers and faults; it has to
+ * die of SIGSEGV, leave one core, and count zero allocations. Dedup and
+ * incremental victims dump once first, so the crash loads a non empty
+ * store index and writes a delta (where the kernel has soft-dirty). The
+ * threads victim faults on several threads at once: its one core has to
+ * carry an NT_OPENCORE_CRASHES note listing every faulting thread but the
+ * one that dumped.
+ *
+ * glibc only, the interposer forwards to its __libc_* entry points.
+ */
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t align, size_t size);
+void __libc_free(void* ptr);
+}
+
+static constexpr int kMaxThreads = 8;
+// the dumper sleeps this long before it stops the world, time enough for
+// every released thread to fault even on one cpu
+static constexpr int kFaultWindowMs = 200;
+
+// one shared page: the allocation count, then the faulting tids
+struct Shared {
+    uint64_t allocs;
+    pid_t tids[kMaxThreads];
+};
+
+static __thread bool g_armed = false;
+static uint64_t* g_allocs = nullptr;
+static Shared* g_shared = nullptr;
+static volatile bool g_go = false;
+
+static inline void CountAlloc() {
+    if (g_armed && g_allocs)
+        __atomic_fetch_add(g_allocs, 1, __ATOMIC_RELAXED);
+}
+
+extern "C" {
+void* malloc(size_t size) {
+    CountAlloc();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    CountAlloc();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    CountAlloc();
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t align, size_t size) {
+    CountAlloc();
+    return __libc_memalign(align, size);
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+    CountAlloc();
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void** ptr, size_t align, size_t size) {
+    CountAlloc();
+    void* p = __libc_memalign(align, size);
+    if (!p)
+        return ENOMEM;
+    *ptr = p;
+    return 0;
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+}
+
+struct Mode {
+    const char* name;
+    int filter;
+    bool dedup;
+    bool incremental;
+    int threads;
+};
+
+static const Mode kModes[] = {
+    { "default", Opencore::FILTER_SPECIAL_VMA | Opencore::FILTER_SIGNAL_CONTEXT },
+    { "minidump", Opencore::FILTER_MINIDUMP },
+    { "window", Opencore::FILTER_MINIDUMP | Opencore::FILTER_MINIDUMP_WINDOW },
+    { "reachable", Opencore::FILTER_MINIDUMP | Opencore::FILTER_MINIDUMP_REACHABLE },
+    { "device", Opencore::FILTER_DEVICE_VMA | Opencore::FILTER_NON_RESIDENT_VMA },
+    { "dedup", Opencore::FILTER_SPECIAL_VMA, true, false },
+    { "incremental", Opencore::FILTER_SPECIAL_VMA, false, true },
+    { "threads", Opencore::FILTER_SPECIAL_VMA | Opencore::FILTER_SIGNAL_CONTEXT, false, false, 4 },
+};
+
+static void* Fault(void* arg) {
+    __atomic_store_n(&g_shared->tids[(intptr_t)arg], gettid(), __ATOMIC_RELEASE);
+    while (!g_go)
+        ;
+    g_armed = true;
+    *(volatile int *)nullptr = 0;
+    return nullptr;
+}
+
+static void Victim(const char* dir, const Mode& mode) {
+    Opencore::SetDir(dir);
+    Opencore::SetFilter(mode.filter);
+    Opencore::SetDedup(mode.dedup);
+    Opencore::SetIncremental(mode.incremental);
+    if (!Opencore::Enable())
+        _exit(1);
+
+    // named apart from core.*, only the crash core is counted
+    if (mode.dedup || mode.incremental)
+        Opencore::Dump("warmup");
+
+    if (mode.threads) {
+        Opencore::SetWorkingSet(kFaultWindowMs);
+        // all parked first, then released together
+        pthread_t thread;
+        for (int i = 0; i < mode.threads; ++i) {
+            if (pthread_create(&thread, nullptr, Fault, (void *)(intptr_t)i))
+                _exit(1);
+        }
+        for (int i = 0; i < mode.threads; ++i) {
+            while (!__atomic_load_n(&g_shared->tids[i], __ATOMIC_ACQUIRE))
+                usleep(1000);
+        }
+        g_go = true;
+        for (;;)
+            pause();
+    }
+
+    g_armed = true;
+    *(volatile int *)nullptr = 0;
+    _exit(2);
+}
+
+// number of cores in dir, the path of one of them in core
+static int FindCores(const char* dir, char* core, int size) {
+    int count = 0;
+    DIR* d = opendir(dir);
+    if (!d)
+        return 0;
+    struct dirent* entry;
+    while ((entry = readdir(d))) {
+        int len = strlen(entry->d_name);
+        int suffix = strlen(DedupStore::PAGES_SUFFIX);
+        if (len > suffix && !strcmp(entry->d_name + len - suffix, DedupStore::PAGES_SUFFIX))
+            continue;
+        if (!strncmp(entry->d_name, "core.", 5)) {
+            snprintf(core, size, "%s/%s", dir, entry->d_name);
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+static void RemoveDir(const char* dir) {
+    DIR* d = opendir(dir);
+    if (d) {
+        char path[512];
+        struct dirent* entry;
+        while ((entry = readdir(d))) {
+            if (entry->d_name[0] == '.')
+                continue;
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+// tids of the NT_OPENCORE_CRASHES note, -1 when the core has none
+static int ReadCrashTids(const char* core, pid_t* tids, int max) {
+    int fd = open(core, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    int found = -1;
+    ElfW(Ehdr) ehdr;
+    if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr)) {
+        close(fd);
+        return -1;
+    }
+    for (int i = 0; i < ehdr.e_phnum && found < 0; ++i) {
+        ElfW(Phdr) phdr;
+        if (pread(fd, &phdr, sizeof(phdr), ehdr.e_phoff + i * sizeof(phdr)) != sizeof(phdr))
+            break;
+        if (phdr.p_type != PT_NOTE)
+            continue;
+
+        uint8_t* notes = (uint8_t *)malloc(phdr.p_filesz);
+        if (!notes || pread(fd, notes, phdr.p_filesz, phdr.p_offset) != (ssize_t)phdr.p_filesz) {
+            free(notes);
+            break;
+        }
+        for (uint64_t pos = 0; pos + sizeof(ElfW(Nhdr)) <= phdr.p_filesz;) {
+            ElfW(Nhdr)* nhdr = (ElfW(Nhdr) *)(notes + pos);
+            const char* name = (const char *)(nhdr + 1);
+            uint8_t* desc = (uint8_t *)name + ((nhdr->n_namesz + 3) & ~3);
+            pos += sizeof(ElfW(Nhdr)) + ((nhdr->n_namesz + 3) & ~3) + ((nhdr->n_descsz + 3) & ~3);
+            if (nhdr->n_type != NT_OPENCORE_CRASHES || strcmp(name, ELFOPENCOREMAGIC))
+                continue;
+
+            uint32_t count = ((uint32_t *)desc)[1];
+            Opencore::CrashRecord* records = (Opencore::CrashRecord *)(desc + 2 * sizeof(uint32_t));
+            found = 0;
+            for (uint32_t n = 0; n < count && found < max; ++n)
+                tids[found++] = records[n].tid;
+            break;
+        }
+        free(notes);
+    }
+    close(fd);
+    return found;
+}
+
+// every faulting thread but one is in the note, and nothing else
+static bool CheckCrashTids(const char* core, int threads) {
+    pid_t noted[kMaxThreads];
+    int count = ReadCrashTids(core, noted, kMaxThreads);
+    if (count != threads - 1)
+        return false;
+    for (int i = 0; i < count; ++i) {
+        bool known = false;
+        for (int t = 0; t < threads; ++t)
+            known |= noted[i] == g_shared->tids[t];
+        if (!known)
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    // shared with every victim and its dumper child
+    g_shared = (Shared *)mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    g_allocs = &g_shared->allocs;
+
+    int failed = 0;
+    for (const Mode& mode : kModes) {
+        char dir[] = "/tmp/opencore-crash-XXXXXX";
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        memset(g_shared, 0, sizeof(Shared));
+
+        pid_t pid = fork();
+        if (pid == 0)
+            Victim(dir, mode);
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        bool crashed = WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV;
+        char path[512];
+        int cores = FindCores(dir, path, sizeof(path));
+        bool core = cores == 1;
+        bool noted = !mode.threads || (core && CheckCrashTids(path, mode.threads));
+        RemoveDir(dir);
+        uint64_t allocs = __atomic_load_n(g_allocs, __ATOMIC_RELAXED);
+        bool ok = crashed && core && noted && !allocs;
+        if (!ok)
+            failed++;
+
+        printf("%-12s %s: %s, %d core%s%s, %llu allocations\n", mode.name,
+               ok ? "ok" : "FAILED", crashed ? "SIGSEGV" : "no crash", cores,
+               cores == 1 ? "" : "s", noted ? "" : ", crash note wrong",
+               (unsigned long long)allocs);
+    }
+    return failed ? 1 : 0;
+}
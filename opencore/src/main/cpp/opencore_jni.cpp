@@ -77,6 +77,12 @@ static jboolean penguin_opencore_sdk_Coredump_nativeCoredump(JNIEnv* env, jclass
     return true;
 }
 
+static jboolean penguin_opencore_sdk_Coredump_nativeCoredumpFd(JNIEnv* /*env*/, jclass /*clazz*/, jint tid, jint fd) {
+    FdSink sink(fd);
+    Opencore::Dump(&sink, tid);
+    return true;
+}
+
 static void penguin_opencore_sdk_Coredump_nativeSetDir(JNIEnv* env, jclass /*clazz*/, jstring dir) {
     jboolean isCopy;
     if (dir != NULL) {
@@ -98,6 +104,69 @@ static void penguin_opencore_sdk_Coredump_nativeSetFilter(JNIEnv* /*env*/, jclas
     Opencore::SetFilter(filter);
 }
 
+static void penguin_opencore_sdk_Coredump_nativeSetPageWindow(JNIEnv* /*env*/, jclass /*clazz*/, jint pages) {
+    Opencore::SetPageWindow(pages);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetReachDepth(JNIEnv* /*env*/, jclass /*clazz*/, jint depth) {
+    Opencore::SetReachDepth(depth);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetReachBudget(JNIEnv* /*env*/, jclass /*clazz*/, jlong budget) {
+    Opencore::SetReachBudget(budget);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetReachRoots(JNIEnv* env, jclass /*clazz*/, jstring libs) {
+    jboolean isCopy;
+    if (libs != NULL) {
+        const char *cstr = env->GetStringUTFChars(libs, &isCopy);
+        Opencore::SetReachRoots(cstr);
+        env->ReleaseStringUTFChars(libs, cstr);
+    } else {
+        Opencore::SetReachRoots(nullptr);
+    }
+}
+
+static jboolean penguin_opencore_sdk_Coredump_nativeSetRules(JNIEnv* env, jclass /*clazz*/, jstring rules) {
+    jboolean isCopy;
+    jboolean ret;
+    if (rules != NULL) {
+        const char *cstr = env->GetStringUTFChars(rules, &isCopy);
+        ret = Opencore::SetRules(cstr);
+        env->ReleaseStringUTFChars(rules, cstr);
+    } else {
+        ret = Opencore::SetRules(nullptr);
+    }
+    return ret;
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetSwapPolicy(JNIEnv* /*env*/, jclass /*clazz*/, jint policy) {
+    Opencore::SetSwapPolicy(policy);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetSwapBudget(JNIEnv* /*env*/, jclass /*clazz*/, jlong budget) {
+    Opencore::SetSwapBudget(budget);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetDedup(JNIEnv* /*env*/, jclass /*clazz*/, jboolean enable) {
+    Opencore::SetDedup(enable);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetIncremental(JNIEnv* /*env*/, jclass /*clazz*/, jboolean enable) {
+    Opencore::SetIncremental(enable);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetBaseline(JNIEnv* env, jclass /*clazz*/, jint pid, jstring core) {
+    jboolean isCopy;
+    if (core != NULL) {
+        const char *cstr = env->GetStringUTFChars(core, &isCopy);
+        Opencore::SetBaseline(pid, cstr);
+        env->ReleaseStringUTFChars(core, cstr);
+    } else {
+        Opencore::SetBaseline(pid, nullptr);
+    }
+}
+
 static jboolean penguin_opencore_sdk_Coredump_nativeIsEnabled(JNIEnv* /*env*/, jclass /*clazz*/) {
     return Opencore::IsEnabled();
 }
@@ -119,6 +188,127 @@ static jint penguin_opencore_sdk_Coredump_nativeGetFilter(JNIEnv* /*env*/, jclas
     return Opencore::GetFilter();
 }
 
+static jint penguin_opencore_sdk_Coredump_nativeGetPageWindow(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetPageWindow();
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetReachDepth(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetReachDepth();
+}
+
+static jlong penguin_opencore_sdk_Coredump_nativeGetReachBudget(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetReachBudget();
+}
+
+static jstring penguin_opencore_sdk_Coredump_nativeGetReachRoots(JNIEnv* env, jclass /*clazz*/) {
+    const char* libs = Opencore::GetReachRoots();
+    return env->NewStringUTF(libs);
+}
+
+static jstring penguin_opencore_sdk_Coredump_nativeGetRules(JNIEnv* env, jclass /*clazz*/) {
+    const char* rules = Opencore::GetRules();
+    return env->NewStringUTF(rules);
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetSwapPolicy(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetSwapPolicy();
+}
+
+static jlong penguin_opencore_sdk_Coredump_nativeGetSwapBudget(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetSwapBudget();
+}
+
+static jboolean penguin_opencore_sdk_Coredump_nativeGetDedup(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetDedup();
+}
+
+static jboolean penguin_opencore_sdk_Coredump_nativeGetIncremental(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetIncremental();
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetWorkingSet(JNIEnv* /*env*/, jclass /*clazz*/, jint ms) {
+    Opencore::SetWorkingSet(ms);
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetWorkingSet(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetWorkingSet();
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetRepeatPolicy(JNIEnv* /*env*/, jclass /*clazz*/, jint policy) {
+    Opencore::SetRepeatPolicy(policy);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetRateLimit(JNIEnv* /*env*/, jclass /*clazz*/, jint per_signature, jint global) {
+    Opencore::SetRateLimit(per_signature, global);
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetRepeatPolicy(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetRepeatPolicy();
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetSignatureLimit(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetSignatureLimit();
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetGlobalLimit(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetGlobalLimit();
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetQuota(JNIEnv* /*env*/, jclass /*clazz*/, jlong bytes) {
+    Opencore::SetQuota(bytes);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetMaxFiles(JNIEnv* /*env*/, jclass /*clazz*/, jint count) {
+    Opencore::SetMaxFiles(count);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetMaxAge(JNIEnv* /*env*/, jclass /*clazz*/, jint sec) {
+    Opencore::SetMaxAge(sec);
+}
+
+static void penguin_opencore_sdk_Coredump_nativeSetCompact(JNIEnv* /*env*/, jclass /*clazz*/, jboolean enable) {
+    Opencore::SetCompact(enable);
+}
+
+static jlong penguin_opencore_sdk_Coredump_nativeGetQuota(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetQuota();
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetMaxFiles(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetMaxFiles();
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetMaxAge(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetMaxAge();
+}
+
+static jboolean penguin_opencore_sdk_Coredump_nativeGetCompact(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetCompact();
+}
+
+static jint penguin_opencore_sdk_Coredump_nativeGetBaselinePid(JNIEnv* /*env*/, jclass /*clazz*/) {
+    return Opencore::GetBaselinePid();
+}
+
+static jstring penguin_opencore_sdk_Coredump_nativeGetBaselineCore(JNIEnv* env, jclass /*clazz*/) {
+    const char* core = Opencore::GetBaselineCore();
+    return env->NewStringUTF(core);
+}
+
+static jstring penguin_opencore_sdk_Coredump_nativePlan(JNIEnv* env, jclass /*clazz*/, jboolean measure) {
+    std::string json = Opencore::Plan(measure);
+    if (json.empty())
+        return NULL;
+    return env->NewStringUTF(json.c_str());
+}
+
+static jstring penguin_opencore_sdk_Coredump_nativeGetLastStats(JNIEnv* env, jclass /*clazz*/) {
+    std::string json = Opencore::GetLastStatsJson();
+    if (json.empty())
+        return NULL;
+    return env->NewStringUTF(json.c_str());
+}
+
 static JNINativeMethod gMethods[] = {
     {
         "nativeVersion",
@@ -140,6 +330,11 @@ static JNINativeMethod gMethods[] = {
         "(ILjava/lang/String;)Z",
         (void *)penguin_opencore_sdk_Coredump_nativeCoredump
     },
+    {
+        "nativeCoredumpFd",
+        "(II)Z",
+        (void *)penguin_opencore_sdk_Coredump_nativeCoredumpFd
+    },
     {
         "nativeSetDir",
         "(Ljava/lang/String;)V",
@@ -185,6 +380,196 @@ static JNINativeMethod gMethods[] = {
         "()I",
         (void *)penguin_opencore_sdk_Coredump_nativeGetFilter
     },
+    {
+        "nativeSetPageWindow",
+        "(I)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetPageWindow
+    },
+    {
+        "nativeGetPageWindow",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetPageWindow
+    },
+    {
+        "nativeSetReachDepth",
+        "(I)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetReachDepth
+    },
+    {
+        "nativeSetReachBudget",
+        "(J)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetReachBudget
+    },
+    {
+        "nativeSetReachRoots",
+        "(Ljava/lang/String;)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetReachRoots
+    },
+    {
+        "nativeGetReachDepth",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetReachDepth
+    },
+    {
+        "nativeGetReachBudget",
+        "()J",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetReachBudget
+    },
+    {
+        "nativeGetReachRoots",
+        "()Ljava/lang/String;",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetReachRoots
+    },
+    {
+        "nativeSetRules",
+        "(Ljava/lang/String;)Z",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetRules
+    },
+    {
+        "nativeGetRules",
+        "()Ljava/lang/String;",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetRules
+    },
+    {
+        "nativeSetSwapPolicy",
+        "(I)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetSwapPolicy
+    },
+    {
+        "nativeSetSwapBudget",
+        "(J)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetSwapBudget
+    },
+    {
+        "nativeGetSwapPolicy",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetSwapPolicy
+    },
+    {
+        "nativeGetSwapBudget",
+        "()J",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetSwapBudget
+    },
+    {
+        "nativeSetDedup",
+        "(Z)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetDedup
+    },
+    {
+        "nativeGetDedup",
+        "()Z",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetDedup
+    },
+    {
+        "nativeSetIncremental",
+        "(Z)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetIncremental
+    },
+    {
+        "nativeGetIncremental",
+        "()Z",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetIncremental
+    },
+    {
+        "nativeSetBaseline",
+        "(ILjava/lang/String;)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetBaseline
+    },
+    {
+        "nativeGetBaselinePid",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetBaselinePid
+    },
+    {
+        "nativeGetBaselineCore",
+        "()Ljava/lang/String;",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetBaselineCore
+    },
+    {
+        "nativeSetWorkingSet",
+        "(I)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetWorkingSet
+    },
+    {
+        "nativeGetWorkingSet",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetWorkingSet
+    },
+    {
+        "nativeSetRepeatPolicy",
+        "(I)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetRepeatPolicy
+    },
+    {
+        "nativeSetRateLimit",
+        "(II)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetRateLimit
+    },
+    {
+        "nativeGetRepeatPolicy",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetRepeatPolicy
+    },
+    {
+        "nativeGetSignatureLimit",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetSignatureLimit
+    },
+    {
+        "nativeGetGlobalLimit",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetGlobalLimit
+    },
+    {
+        "nativeSetQuota",
+        "(J)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetQuota
+    },
+    {
+        "nativeSetMaxFiles",
+        "(I)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetMaxFiles
+    },
+    {
+        "nativeSetMaxAge",
+        "(I)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetMaxAge
+    },
+    {
+        "nativeSetCompact",
+        "(Z)V",
+        (void *)penguin_opencore_sdk_Coredump_nativeSetCompact
+    },
+    {
+        "nativeGetQuota",
+        "()J",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetQuota
+    },
+    {
+        "nativeGetMaxFiles",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetMaxFiles
+    },
+    {
+        "nativeGetMaxAge",
+        "()I",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetMaxAge
+    },
+    {
+        "nativeGetCompact",
+        "()Z",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetCompact
+    },
+    {
+        "nativePlan",
+        "(Z)Ljava/lang/String;",
+        (void *)penguin_opencore_sdk_Coredump_nativePlan
+    },
+    {
+        "nativeGetLastStats",
+        "()Ljava/lang/String;",
+        (void *)penguin_opencore_sdk_Coredump_nativeGetLastStats
+    },
 };
 
 extern "C"
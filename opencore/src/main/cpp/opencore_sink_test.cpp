@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "opencore/opencore.h"
+#include "opencore/sink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+ * Every sink has to produce the same core. One parked target is dumped
+ * into a FileSink as the reference, then into a MemorySink, an FdSink on
+ * a pipe (streamed, Skip zero fills, no in kernel file copies) and an
+ * FdSink on a regular file. The ELF header, every program header and the
+ * data of every PT_LOAD have to match the reference; notes are left out,
+ * they carry the stats of their own dump.
+ *
+ * The target holds a pattern, never touched zero pages and a clean file
+ * mapping, so both the memory and the file copy paths are covered.
+ */
+
+static constexpr uint64_t kRegion = 4 << 20;
+static constexpr uint64_t kMemoryCapacity = 1ULL << 30;
+
+static void Fill(uint8_t* data, uint64_t size, uint32_t seed) {
+    uint32_t* words = (uint32_t *)data;
+    for (uint64_t i = 0; i < size / sizeof(uint32_t); ++i)
+        words[i] = (uint32_t)(i * 2654435761u) ^ seed;
+}
+
+// the first pause() still binds lazily, wait until the target sleeps in it
+static bool WaitAsleep(pid_t pid) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    for (int i = 0; i < 1000; ++i) {
+        char stat[256] = {0};
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        read(fd, stat, sizeof(stat) - 1);
+        close(fd);
+        const char* state = strrchr(stat, ')');
+        if (state && state[1] == ' ' && state[2] == 'S')
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+static pid_t StartTarget(const char* file) {
+    int ready[2];
+    if (pipe(ready))
+        return -1;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(ready[0]);
+        uint8_t* data = (uint8_t *)mmap(nullptr, kRegion, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        void* zero = mmap(nullptr, kRegion, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        int fd = open(file, O_RDONLY);
+        void* mapped = fd >= 0 ? mmap(nullptr, kRegion, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        if (data == MAP_FAILED || zero == MAP_FAILED || mapped == MAP_FAILED)
+            _exit(1);
+        Fill(data, kRegion, 0x5a5a5a5a);
+        // fault the file in, its pages stay clean
+        volatile uint8_t sum = 0;
+        for (uint64_t off = 0; off < kRegion; off += 4096)
+            sum += ((uint8_t *)mapped)[off];
+
+        char c = 1;
+        write(ready[1], &c, 1);
+        for (;;)
+            pause();
+    }
+
+    close(ready[1]);
+    char c = 0;
+    bool ok = read(ready[0], &c, 1) == 1 && WaitAsleep(pid);
+    close(ready[0]);
+    if (!ok && pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return -1;
+    }
+    return pid;
+}
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& out) {
+    out.clear();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    uint8_t buffer[64 << 10];
+    ssize_t rc;
+    while ((rc = read(fd, buffer, sizeof(buffer))) > 0)
+        out.insert(out.end(), buffer, buffer + rc);
+    close(fd);
+    return rc == 0 && !out.empty();
+}
+
+static void DumpTo(pid_t pid, OutputSink* sink, const char* filename) {
+    Opencore::DumpOption option;
+    option.pid = pid;
+    option.tid = pid;
+    option.sink = sink;
+    option.filename = const_cast<char *>(filename);
+    Opencore::Dump(&option);
+}
+
+// drains the pipe in another process, the dumper only streams into it
+static pid_t StartReader(int fds[2], const char* path) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int in = fds[0];
+        close(fds[1]);
+        int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0)
+            _exit(1);
+        uint8_t buffer[64 << 10];
+        ssize_t rc;
+        while ((rc = read(in, buffer, sizeof(buffer))) > 0) {
+            if (write(out, buffer, rc) != rc)
+                _exit(1);
+        }
+        close(out);
+        _exit(rc ? 1 : 0);
+    }
+    return pid;
+}
+
+static const ElfW(Phdr)* Phdrs(const std::vector<uint8_t>& core, int* phnum) {
+    const ElfW(Ehdr)* ehdr = (const ElfW(Ehdr) *)core.data();
+    if (core.size() < sizeof(ElfW(Ehdr)) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG)
+            || ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(ElfW(Phdr)) > core.size())
+        return nullptr;
+    *phnum = ehdr->e_phnum;
+    return (const ElfW(Phdr) *)(core.data() + ehdr->e_phoff);
+}
+
+static bool IsZero(const std::vector<uint8_t>& core, uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end && i < core.size(); ++i) {
+        if (core[i])
+            return false;
+    }
+    return true;
+}
+
+// returns an empty string when got matches ref
+static std::string Compare(const std::vector<uint8_t>& ref, const std::vector<uint8_t>& got) {
+    int ref_num = 0, got_num = 0;
+    const ElfW(Phdr)* ref_phdr = Phdrs(ref, &ref_num);
+    const ElfW(Phdr)* got_phdr = Phdrs(got, &got_num);
+    if (!ref_phdr || !got_phdr)
+        return "not an ELF core";
+    if (memcmp(ref.data(), got.data(), sizeof(ElfW(Ehdr))))
+        return "ELF header differs";
+    if (ref_num != got_num)
+        return "phdr count differs";
+    if (ref.size() != got.size())
+        return "core size differs";
+
+    int loads = 0;
+    // past the phdrs and the extended numbering section header, if any
+    const ElfW(Ehdr)* ehdr = (const ElfW(Ehdr) *)got.data();
+    uint64_t gap = ehdr->e_phoff + got_num * sizeof(ElfW(Phdr));
+    if (ehdr->e_shoff)
+        gap = std::max(gap, (uint64_t)(ehdr->e_shoff + ehdr->e_shnum * ehdr->e_shentsize));
+    char reason[128];
+    for (int i = 0; i < ref_num; ++i) {
+        const ElfW(Phdr)& a = ref_phdr[i];
+        const ElfW(Phdr)& b = got_phdr[i];
+        if (memcmp(&a, &b, sizeof(ElfW(Phdr)))) {
+            snprintf(reason, sizeof(reason), "phdr %d differs", i);
+            return reason;
+        }
+        // what Skip put before the notes and ahead of the first load
+        if (a.p_type == PT_NOTE || (a.p_type == PT_LOAD && a.p_filesz && !loads)) {
+            if (!IsZero(got, gap, b.p_offset)) {
+                snprintf(reason, sizeof(reason), "padding before phdr %d not zero", i);
+                return reason;
+            }
+            if (a.p_type == PT_NOTE)
+                gap = b.p_offset + b.p_filesz;
+        }
+        if (a.p_type != PT_LOAD || !a.p_filesz)
+            continue;
+        if (a.p_offset + a.p_filesz > ref.size() || b.p_offset + b.p_filesz > got.size()) {
+            snprintf(reason, sizeof(reason), "segment %d truncated", i);
+            return reason;
+        }
+        if (memcmp(ref.data() + a.p_offset, got.data() + b.p_offset, a.p_filesz)) {
+            snprintf(reason, sizeof(reason), "segment %d at 0x%llx data differs",
+                     i, (unsigned long long)a.p_vaddr);
+            return reason;
+        }
+        loads++;
+    }
+    return loads ? "" : "no PT_LOAD data";
+}
+
+int main() {
+    char dir[] = "/tmp/opencore-sink-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string mapped = std::string(dir) + "/mapped";
+    std::string ref_path = std::string(dir) + "/core.file";
+    std::string fd_path = std::string(dir) + "/core.fd";
+    std::string pipe_path = std::string(dir) + "/core.pipe";
+
+    std::vector<uint8_t> pattern(kRegion);
+    Fill(pattern.data(), kRegion, 0xa5a5a5a5);
+    int fd = open(mapped.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, pattern.data(), kRegion) != (ssize_t)kRegion) {
+        perror("mapped");
+        return 1;
+    }
+    close(fd);
+
+    pid_t target = StartTarget(mapped.c_str());
+    if (target < 0) {
+        fprintf(stderr, "target setup failed.\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> ref;
+    DumpTo(target, nullptr, ref_path.c_str());
+    bool ready = ReadFile(ref_path.c_str(), ref);
+
+    int failed = 0;
+    std::string result;
+    std::vector<uint8_t> got;
+    if (ready) {
+        MemorySink memory(kMemoryCapacity);
+        DumpTo(target, &memory, nullptr);
+        got.assign(memory.Data(), memory.Data() + memory.Size());
+        result = Compare(ref, got);
+        printf("%-6s %s%s\n", "memory", result.empty() ? "ok" : "FAILED: ", result.c_str());
+        failed += !result.empty();
+
+        int fds[2];
+        if (!pipe(fds)) {
+            pid_t reader = StartReader(fds, pipe_path.c_str());
+            close(fds[0]);
+            FdSink stream(fds[1]);
+            DumpTo(target, &stream, nullptr);
+            close(fds[1]);
+            int status = 0;
+            waitpid(reader, &status, 0);
+            bool read = WIFEXITED(status) && !WEXITSTATUS(status) && ReadFile(pipe_path.c_str(), got);
+            result = read ? Compare(ref, got) : "pipe read failed";
+        } else {
+            result = "pipe failed";
+        }
+        printf("%-6s %s%s\n", "pipe", result.empty() ? "ok" : "FAILED: ", result.c_str());
+        failed += !result.empty();
+
+        fd = open(fd_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            FdSink file(fd);
+            DumpTo(target, &file, nullptr);
+            close(fd);
+            result = ReadFile(fd_path.c_str(), got) ? Compare(ref, got) : "no core";
+        } else {
+            result = "open failed";
+        }
+        printf("%-6s %s%s\n", "fd", result.empty() ? "ok" : "FAILED: ", result.c_str());
+        failed += !result.empty();
+    } else {
+        fprintf(stderr, "reference dump failed.\n");
+        failed++;
+    }
+
+    kill(target, SIGKILL);
+    waitpid(target, nullptr, 0);
+    unlink(mapped.c_str());
+    unlink(ref_path.c_str());
+    unlink(fd_path.c_str());
+    unlink(pipe_path.c_str());
+    rmdir(dir);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/core_image.h"
+#include <string.h>
+
+template<typename T>
+static T Field(const uint8_t* base, int offset) {
+    T value;
+    memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+bool CoreImage::Open(const char* path) {
+    Close();
+    fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "open %s fail.\n", path);
+        return false;
+    }
+
+    uint8_t ehdr[64];
+    if (fread(ehdr, 1, sizeof(ehdr), fp) < 52 || memcmp(ehdr, "\177ELF", 4)) {
+        fprintf(stderr, "%s is not an elf file.\n", path);
+        return false;
+    }
+
+    bits = ehdr[4] == 2 ? 64 : 32;
+    uint64_t phoff, shoff;
+    uint32_t phentsize, phnum;
+    if (Is64()) {
+        phoff = Field<uint64_t>(ehdr, 32);
+        shoff = Field<uint64_t>(ehdr, 40);
+        phentsize = Field<uint16_t>(ehdr, 54);
+        phnum = Field<uint16_t>(ehdr, 56);
+    } else {
+        phoff = Field<uint32_t>(ehdr, 28);
+        shoff = Field<uint32_t>(ehdr, 32);
+        phentsize = Field<uint16_t>(ehdr, 42);
+        phnum = Field<uint16_t>(ehdr, 44);
+    }
+
+    // PN_XNUM, the real count is sh_info of section header 0
+    if (phnum == PN_XNUM_COUNT && shoff) {
+        uint8_t shdr[64];
+        fseeko(fp, shoff, SEEK_SET);
+        if (fread(shdr, 1, sizeof(shdr), fp) < 40)
+            return false;
+        phnum = Field<uint32_t>(shdr, Is64() ? 44 : 28);
+    }
+
+    std::vector<uint8_t> table((uint64_t)phentsize * phnum);
+    fseeko(fp, phoff, SEEK_SET);
+    if (fread(table.data(), 1, table.size(), fp) != table.size()) {
+        fprintf(stderr, "%s truncated program headers.\n", path);
+        return false;
+    }
+
+    segments.clear();
+    head_size = 0;
+    for (uint32_t i = 0; i < phnum; ++i) {
+        const uint8_t* p = table.data() + (uint64_t)i * phentsize;
+        Segment segment;
+        segment.type = Field<uint32_t>(p, 0);
+        if (Is64()) {
+            segment.flags = Field<uint32_t>(p, 4);
+            segment.offset = Field<uint64_t>(p, 8);
+            segment.vaddr = Field<uint64_t>(p, 16);
+            segment.filesz = Field<uint64_t>(p, 32);
+            segment.memsz = Field<uint64_t>(p, 40);
+            segment.align = Field<uint64_t>(p, 48);
+        } else {
+            segment.offset = Field<uint32_t>(p, 4);
+            segment.vaddr = Field<uint32_t>(p, 8);
+            segment.filesz = Field<uint32_t>(p, 16);
+            segment.memsz = Field<uint32_t>(p, 20);
+            segment.flags = Field<uint32_t>(p, 24);
+            segment.align = Field<uint32_t>(p, 28);
+        }
+        segments.push_back(segment);
+
+        if (segment.type == PT_NOTE_TYPE) {
+            ReadNotes(segment);
+        } else if (segment.type == PT_LOAD_TYPE && !head_size) {
+            head_size = segment.offset;
+        }
+    }
+    return true;
+}
+
+bool CoreImage::ReadNotes(Segment& segment) {
+    std::vector<uint8_t> data(segment.filesz);
+    fseeko(fp, segment.offset, SEEK_SET);
+    if (fread(data.data(), 1, data.size(), fp) != data.size())
+        return false;
+
+    uint64_t pos = 0;
+    while (pos + 12 <= data.size()) {
+        uint32_t namesz = Field<uint32_t>(data.data(), pos);
+        uint32_t descsz = Field<uint32_t>(data.data(), pos + 4);
+        Note note;
+        note.type = Field<uint32_t>(data.data(), pos + 8);
+        pos += 12;
+
+        uint64_t name_end = pos + ((namesz + 3) & ~3U);
+        uint64_t desc_end = name_end + ((descsz + 3) & ~3U);
+        if (desc_end > data.size() + 3)
+            break;
+
+        note.name.assign((const char *)data.data() + pos, namesz ? strnlen((const char *)data.data() + pos, namesz) : 0);
+        if (name_end + descsz <= data.size())
+            note.desc.assign(data.begin() + name_end, data.begin() + name_end + descsz);
+        notes.push_back(note);
+        pos = desc_end;
+    }
+    return true;
+}
+
+CoreImage::Note* CoreImage::FindNote(const char* name, uint32_t type) {
+    for (int i = 0; i < notes.size(); ++i) {
+        if (notes[i].name == name && notes[i].type == type)
+            return &notes[i];
+    }
+    return nullptr;
+}
+
+bool CoreImage::ReadHead(std::vector<uint8_t>& head) {
+    if (!fp)
+        return false;
+
+    fseeko(fp, 0, SEEK_END);
+    uint64_t size = ftello(fp);
+    if (head_size && head_size < size)
+        size = head_size;
+
+    head.resize(size);
+    fseeko(fp, 0, SEEK_SET);
+    return fread(head.data(), 1, size, fp) == size;
+}
+
+void CoreImage::Close() {
+    if (fp) {
+        fclose(fp);
+        fp = nullptr;
+    }
+    segments.clear();
+    notes.clear();
+}
+
+bool WriteAt(FILE* fp, uint64_t offset, const void* data, uint64_t size) {
+    if (fseeko(fp, offset, SEEK_SET) < 0)
+        return false;
+    return fwrite(data, 1, size, fp) == size;
+}
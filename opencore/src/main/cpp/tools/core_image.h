@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPENCORE_TOOLS_CORE_IMAGE_H_
+#define OPENCORE_TOOLS_CORE_IMAGE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/*
+ * Minimal ELF32/ELF64 core reader for the host tools, only what is
+ * needed to walk program headers and notes of an opencore output.
+ */
+class CoreImage {
+public:
+    static constexpr uint32_t PT_LOAD_TYPE = 1;
+    static constexpr uint32_t PT_NOTE_TYPE = 4;
+    static constexpr uint32_t PN_XNUM_COUNT = 0xffff;
+
+    struct Segment {
+        uint32_t type;
+        uint32_t flags;
+        uint64_t offset;
+        uint64_t vaddr;
+        uint64_t filesz;
+        uint64_t memsz;
+        uint64_t align;
+    };
+
+    struct Note {
+        std::string name;
+        uint32_t type;
+        std::vector<uint8_t> desc;
+    };
+
+    CoreImage() : fp(nullptr), bits(0), head_size(0) {}
+    ~CoreImage() { Close(); }
+
+    bool Open(const char* path);
+    void Close();
+    bool Is64() { return bits == 64; }
+    // bytes before the first load segment data: ehdr, phdrs and notes
+    uint64_t getHeadSize() { return head_size; }
+    std::vector<Segment>& getSegments() { return segments; }
+    std::vector<Note>& getNotes() { return notes; }
+    Note* FindNote(const char* name, uint32_t type);
+    bool ReadHead(std::vector<uint8_t>& head);
+    FILE* getFile() { return fp; }
+private:
+    bool ReadNotes(Segment& segment);
+
+    FILE* fp;
+    int bits;
+    uint64_t head_size;
+    std::vector<Segment> segments;
+    std::vector<Note> notes;
+};
+
+// copy helpers shared by the tools
+bool WriteAt(FILE* fp, uint64_t offset, const void* data, uint64_t size);
+
+#endif // OPENCORE_TOOLS_CORE_IMAGE_H_
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/core_image.h"
+#include "opencore/dedup.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+// keep in step with opencore/opencore.h
+#define OPENCORE_NOTE_NAME "OPENCORE"
+#define NT_OPENCORE_DEDUP 0x2
+
+static void Usage() {
+    printf("Usage: opencore-dedup <core> [-o <output>] [-s <store dir>]\n");
+    printf("Rebuild a plain ELF core from a deduplicated opencore output.\n");
+}
+
+static std::string DirName(const std::string& path) {
+    size_t split = path.rfind('/');
+    return split == std::string::npos ? "." : path.substr(0, split);
+}
+
+int main(int argc, char** argv) {
+    const char* core = nullptr;
+    std::string output;
+    std::string store_dir;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            output = argv[++i];
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            store_dir = argv[++i];
+        } else if (argv[i][0] == '-') {
+            Usage();
+            return 1;
+        } else {
+            core = argv[i];
+        }
+    }
+
+    if (!core) {
+        Usage();
+        return 1;
+    }
+
+    CoreImage image;
+    if (!image.Open(core))
+        return 1;
+
+    std::string pages_name = std::string(core) + DedupStore::PAGES_SUFFIX;
+    CoreImage::Note* note = image.FindNote(OPENCORE_NOTE_NAME, NT_OPENCORE_DEDUP);
+    if (note && !note->desc.empty())
+        pages_name = DirName(core) + "/" + (const char *)note->desc.data();
+
+    if (store_dir.empty())
+        store_dir = DirName(core);
+    if (output.empty())
+        output = std::string(core) + ".full";
+
+    FILE* pages = fopen(pages_name.c_str(), "rb");
+    if (!pages) {
+        fprintf(stderr, "open %s fail.\n", pages_name.c_str());
+        return 1;
+    }
+
+    DedupStore::Header header;
+    if (fread(&header, sizeof(header), 1, pages) != 1
+            || memcmp(header.magic, DedupStore::MAGIC, strlen(DedupStore::MAGIC))
+            || header.version != DedupStore::VERSION || !header.unit) {
+        fprintf(stderr, "%s is not a pages file.\n", pages_name.c_str());
+        return 1;
+    }
+
+    std::string store_name = store_dir + "/" + DedupStore::STORE_NAME;
+    FILE* store = fopen(store_name.c_str(), "rb");
+    if (!store) {
+        fprintf(stderr, "open %s fail.\n", store_name.c_str());
+        return 1;
+    }
+
+    uint64_t expect = 0;
+    for (auto& segment : image.getSegments()) {
+        if (segment.type == CoreImage::PT_LOAD_TYPE)
+            expect += segment.filesz / header.unit;
+    }
+    if (expect != header.count) {
+        fprintf(stderr, "%s has %" PRIu64 " pages, core needs %" PRIu64 ".\n",
+                pages_name.c_str(), (uint64_t)header.count, expect);
+        return 1;
+    }
+
+    FILE* out = fopen(output.c_str(), "wb");
+    if (!out) {
+        fprintf(stderr, "open %s fail.\n", output.c_str());
+        return 1;
+    }
+
+    std::vector<uint8_t> head;
+    if (!image.ReadHead(head) || !WriteAt(out, 0, head.data(), head.size())) {
+        fprintf(stderr, "write %s head fail.\n", output.c_str());
+        return 1;
+    }
+
+    std::vector<uint8_t> page(header.unit);
+    uint64_t missing = 0;
+    for (auto& segment : image.getSegments()) {
+        if (segment.type != CoreImage::PT_LOAD_TYPE || !segment.filesz)
+            continue;
+
+        fseeko(out, segment.offset, SEEK_SET);
+        uint64_t count = segment.filesz / header.unit;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t ref;
+            if (fread(&ref, sizeof(ref), 1, pages) != 1)
+                return 1;
+
+            memset(page.data(), 0, header.unit);
+            if (ref != DedupStore::REF_ZERO) {
+                fseeko(store, ref * header.unit, SEEK_SET);
+                if (fread(page.data(), 1, header.unit, store) != header.unit)
+                    missing++;
+            }
+            fwrite(page.data(), 1, header.unit, out);
+        }
+    }
+
+    fclose(out);
+    fclose(store);
+    fclose(pages);
+    printf("%s: %" PRIu64 " pages", output.c_str(), (uint64_t)header.count);
+    if (missing)
+        printf(", %" PRIu64 " missing in store", missing);
+    printf("\n");
+    return missing ? 2 : 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/core_image.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <memory>
+
+// keep in step with opencore/opencore.h
+#define OPENCORE_NOTE_NAME "OPENCORE"
+#define NT_OPENCORE_DEDUP 0x2
+#define NT_OPENCORE_INCREMENTAL 0x3
+#define NT_OPENCORE_BASELINE 0x4
+
+static constexpr uint64_t CHUNK = 4096;
+
+static void Usage() {
+    printf("Usage: opencore-merge <core> [-o <output>]\n");
+    printf("Rebuild a full ELF core from the latest incremental opencore output\n");
+    printf("and the chain of previous dumps and baseline cores it refers to.\n");
+}
+
+static std::string DirName(const std::string& path) {
+    size_t split = path.rfind('/');
+    return split == std::string::npos ? "." : path.substr(0, split);
+}
+
+struct ChainImage {
+    std::string path;
+    CoreImage image;
+    // PT_LOAD with data, sorted by vaddr
+    std::vector<CoreImage::Segment> loads;
+
+    bool Open(const std::string& name) {
+        path = name;
+        if (!image.Open(name.c_str()))
+            return false;
+        for (auto& segment : image.getSegments()) {
+            if (segment.type == CoreImage::PT_LOAD_TYPE && segment.filesz)
+                loads.push_back(segment);
+        }
+        std::sort(loads.begin(), loads.end(),
+                  [](const CoreImage::Segment& a, const CoreImage::Segment& b) {
+                      return a.vaddr < b.vaddr;
+                  });
+        return true;
+    }
+
+    CoreImage::Segment* Find(uint64_t vaddr) {
+        auto it = std::upper_bound(loads.begin(), loads.end(), vaddr,
+                                   [](uint64_t addr, const CoreImage::Segment& s) {
+                                       return addr < s.vaddr;
+                                   });
+        if (it == loads.begin())
+            return nullptr;
+        --it;
+        return vaddr < it->vaddr + it->filesz ? &*it : nullptr;
+    }
+
+    bool Read(uint64_t vaddr, uint8_t* buf) {
+        CoreImage::Segment* segment = Find(vaddr);
+        if (!segment)
+            return false;
+        FILE* fp = image.getFile();
+        fseeko(fp, segment->offset + (vaddr - segment->vaddr), SEEK_SET);
+        return fread(buf, 1, CHUNK, fp) == CHUNK;
+    }
+};
+
+int main(int argc, char** argv) {
+    const char* core = nullptr;
+    std::string output;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] == '-') {
+            Usage();
+            return 1;
+        } else {
+            core = argv[i];
+        }
+    }
+
+    if (!core) {
+        Usage();
+        return 1;
+    }
+
+    if (output.empty())
+        output = std::string(core) + ".full";
+
+    // newest first, walk the manifest back to the base
+    std::vector<std::unique_ptr<ChainImage>> chain;
+    std::vector<std::string> baselines;
+    std::string name = core;
+    while (true) {
+        if (chain.size() > 4096) {
+            fprintf(stderr, "%s chain too long.\n", core);
+            return 1;
+        }
+
+        std::unique_ptr<ChainImage> link(new ChainImage);
+        if (!link->Open(name))
+            return 1;
+
+        if (link->image.FindNote(OPENCORE_NOTE_NAME, NT_OPENCORE_DEDUP)) {
+            fprintf(stderr, "%s is deduplicated, run opencore-dedup first.\n", name.c_str());
+            return 1;
+        }
+
+        // { u32 version, u32 pid } "baseline core\0"
+        CoreImage::Note* baseline = link->image.FindNote(OPENCORE_NOTE_NAME, NT_OPENCORE_BASELINE);
+        if (baseline && baseline->desc.size() > 2 * sizeof(uint32_t) + 1) {
+            const char* path = (const char *)baseline->desc.data() + 2 * sizeof(uint32_t);
+            std::string base(path, strnlen(path, baseline->desc.size() - 2 * sizeof(uint32_t)));
+            if (base[0] != '/')
+                base = DirName(name) + "/" + base;
+            if (std::find(baselines.begin(), baselines.end(), base) == baselines.end())
+                baselines.push_back(base);
+        }
+
+        CoreImage::Note* note = link->image.FindNote(OPENCORE_NOTE_NAME, NT_OPENCORE_INCREMENTAL);
+        chain.push_back(std::move(link));
+        if (!note)
+            break;
+
+        // { u32 version, u32 seq } "base\0previous\0"
+        if (note->desc.size() < 2 * sizeof(uint32_t) + 2) {
+            fprintf(stderr, "%s bad incremental note.\n", name.c_str());
+            return 1;
+        }
+        const char* names = (const char *)note->desc.data() + 2 * sizeof(uint32_t);
+        const char* end = (const char *)note->desc.data() + note->desc.size();
+        const char* previous = names + strnlen(names, end - names) + 1;
+        if (previous >= end) {
+            fprintf(stderr, "%s bad incremental note.\n", name.c_str());
+            return 1;
+        }
+        name = DirName(name) + "/" + std::string(previous, strnlen(previous, end - previous));
+    }
+
+    // pages still shared with the parent come last, from its own core
+    for (auto& base : baselines) {
+        std::unique_ptr<ChainImage> link(new ChainImage);
+        if (!link->Open(base))
+            return 1;
+        chain.push_back(std::move(link));
+    }
+
+    ChainImage& latest = *chain[0];
+    std::vector<uint8_t> head;
+    if (!latest.image.ReadHead(head))
+        return 1;
+
+    bool is64 = latest.image.Is64();
+    uint64_t phoff;
+    uint32_t phentsize;
+    if (is64) {
+        memcpy(&phoff, head.data() + 32, sizeof(uint64_t));
+        phentsize = 0;
+        memcpy(&phentsize, head.data() + 54, sizeof(uint16_t));
+    } else {
+        uint32_t off32;
+        memcpy(&off32, head.data() + 28, sizeof(uint32_t));
+        phoff = off32;
+        phentsize = 0;
+        memcpy(&phentsize, head.data() + 42, sizeof(uint16_t));
+    }
+
+    // same segment table as the latest dump, gaps of unchanged pages
+    // are filled back from older dumps, pages found nowhere stay zero.
+    std::vector<CoreImage::Segment> segments = latest.image.getSegments();
+    std::vector<bool> fill(segments.size(), false);
+    std::vector<uint8_t> chunk(CHUNK);
+    uint64_t offset = latest.image.getHeadSize();
+    for (int i = 0; i < segments.size(); ++i) {
+        CoreImage::Segment& segment = segments[i];
+        if (segment.type != CoreImage::PT_LOAD_TYPE)
+            continue;
+
+        if (!segment.filesz && segment.memsz) {
+            for (int k = 1; k < chain.size() && !fill[i]; ++k) {
+                for (uint64_t addr = segment.vaddr; addr < segment.vaddr + segment.memsz; addr += CHUNK) {
+                    if (chain[k]->Find(addr)) {
+                        fill[i] = true;
+                        break;
+                    }
+                }
+            }
+            if (fill[i])
+                segment.filesz = segment.memsz;
+        }
+
+        segment.offset = offset;
+        offset += segment.filesz;
+
+        uint8_t* p = head.data() + phoff + (uint64_t)i * phentsize;
+        if (phoff + (uint64_t)(i + 1) * phentsize > head.size()) {
+            fprintf(stderr, "%s program headers out of head.\n", core);
+            return 1;
+        }
+        if (is64) {
+            memcpy(p + 8, &segment.offset, sizeof(uint64_t));
+            memcpy(p + 32, &segment.filesz, sizeof(uint64_t));
+        } else {
+            uint32_t value = segment.offset;
+            memcpy(p + 4, &value, sizeof(uint32_t));
+            value = segment.filesz;
+            memcpy(p + 16, &value, sizeof(uint32_t));
+        }
+    }
+
+    FILE* out = fopen(output.c_str(), "wb");
+    if (!out) {
+        fprintf(stderr, "open %s fail.\n", output.c_str());
+        return 1;
+    }
+
+    if (!WriteAt(out, 0, head.data(), head.size())) {
+        fprintf(stderr, "write %s head fail.\n", output.c_str());
+        return 1;
+    }
+
+    uint64_t latest_pages = 0;
+    uint64_t merged_pages = 0;
+    uint64_t zero_pages = 0;
+    for (int i = 0; i < segments.size(); ++i) {
+        CoreImage::Segment& segment = segments[i];
+        if (segment.type != CoreImage::PT_LOAD_TYPE || !segment.filesz)
+            continue;
+
+        fseeko(out, segment.offset, SEEK_SET);
+        for (uint64_t addr = segment.vaddr; addr < segment.vaddr + segment.filesz; addr += CHUNK) {
+            if (!fill[i]) {
+                if (!latest.Read(addr, chunk.data()))
+                    memset(chunk.data(), 0, CHUNK);
+                latest_pages++;
+            } else {
+                bool found = false;
+                for (int k = 1; k < chain.size() && !found; ++k)
+                    found = chain[k]->Read(addr, chunk.data());
+                if (found) {
+                    merged_pages++;
+                } else {
+                    memset(chunk.data(), 0, CHUNK);
+                    zero_pages++;
+                }
+            }
+            if (fwrite(chunk.data(), 1, CHUNK, out) != CHUNK) {
+                fprintf(stderr, "write %s fail.\n", output.c_str());
+                return 1;
+            }
+        }
+    }
+
+    fclose(out);
+    printf("%s: %d dumps, %" PRIu64 " latest, %" PRIu64 " merged, %" PRIu64 " zero (4K pages)\n",
+           output.c_str(), (int)chain.size(), latest_pages, merged_pages, zero_pages);
+    return 0;
+}
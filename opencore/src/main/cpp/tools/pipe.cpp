@@ -0,0 +1,593 @@
+/*
+ * Copyright (C) 2024-present, Guanyou.Chen. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Kernel core_pattern pipe handler:
+ *
+ *   echo '|/usr/bin/opencore-pipe -o /var/crash/core.%e.%p -z %p %s' \
+ *       > /proc/sys/kernel/core_pattern
+ *
+ * The kernel writes ehdr, phdrs, the note segment and then every load
+ * segment in file order, so one forward pass over stdin is enough. Headers
+ * and notes are held in memory, segment data only passes through one
+ * buffer. /proc/<pid> stays readable until we exit, maps give the names
+ * and share flags the filters need, NT_FILE stands in when it is gone.
+ */
+
+#include "opencore/gzip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+// keep in step with opencore/opencore.h
+#define FILTER_SPECIAL_VMA (1 << 0)
+#define FILTER_FILE_VMA (1 << 1)
+#define FILTER_SHARED_VMA (1 << 2)
+#define FILTER_SANITIZER_SHADOW_VMA (1 << 3)
+#define FILTER_NON_READ_VMA (1 << 4)
+#define FILTER_JAVAHEAP_VMA (1 << 7)
+#define FILTER_SUPPORTED (FILTER_SPECIAL_VMA | FILTER_FILE_VMA | FILTER_SHARED_VMA \
+        | FILTER_SANITIZER_SHADOW_VMA | FILTER_NON_READ_VMA | FILTER_JAVAHEAP_VMA)
+
+static constexpr uint64_t PAGE = 4096;
+static constexpr uint64_t BUFFER_SIZE = 1 << 20;
+
+static void Usage() {
+    printf("Usage: opencore-pipe -o <output> [-z] [-f <filter>] [<pid> [<signal>]]\n");
+    printf("Filter a kernel core read from stdin, register it in core_pattern as\n");
+    printf("  |/path/opencore-pipe -o /var/crash/core.%%e.%%p [-z] %%p %%s\n");
+    printf("  -z  seekable gzip output, .gz is appended\n");
+    printf("  -f  opencore filter bits, supported 0x%x\n", FILTER_SUPPORTED);
+}
+
+struct Vma {
+    uint64_t begin;
+    uint64_t end;
+    char flags[5];
+    uint64_t offset;
+    uint64_t inode;
+    std::string file;
+};
+
+struct Stats {
+    uint64_t read;
+    uint64_t written;
+    uint64_t holes;
+    uint64_t dropped;
+    int segments;
+    int filtered;
+};
+
+class PipeInput {
+public:
+    PipeInput(int f) : fd(f), pos(0) {}
+    bool Read(void* data, uint64_t size);
+    // up to size bytes, 0 at the end of the stream
+    int64_t ReadSome(void* data, uint64_t size);
+    bool SkipTo(uint64_t offset, std::vector<uint8_t>& buffer);
+    uint64_t Offset() { return pos; }
+private:
+    int fd;
+    uint64_t pos;
+};
+
+bool PipeInput::Read(void* data, uint64_t size) {
+    uint8_t* p = (uint8_t *)data;
+    while (size) {
+        ssize_t rc = read(fd, p, size);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0)
+            return false;
+        p += rc;
+        size -= rc;
+        pos += rc;
+    }
+    return true;
+}
+
+int64_t PipeInput::ReadSome(void* data, uint64_t size) {
+    ssize_t rc;
+    do {
+        rc = read(fd, data, size);
+    } while (rc < 0 && errno == EINTR);
+    if (rc > 0)
+        pos += rc;
+    return rc;
+}
+
+bool PipeInput::SkipTo(uint64_t offset, std::vector<uint8_t>& buffer) {
+    if (offset < pos)
+        return false;
+    while (pos < offset) {
+        uint64_t count = offset - pos;
+        if (count > buffer.size())
+            count = buffer.size();
+        if (!Read(buffer.data(), count))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Raw output leaves zero pages as holes and sets the size at the end,
+ * compressed output goes through the seekable gzip writer where zero
+ * pages cost next to nothing anyway.
+ */
+class PipeOutput {
+public:
+    PipeOutput(Stats& s) : fd(-1), compress(false), pos(0), stats(s) {}
+    bool Open(const char* path, bool gz);
+    bool Write(const void* data, uint64_t size);
+    bool PadTo(uint64_t offset);
+    bool Close();
+    uint64_t Offset() { return pos; }
+private:
+    bool WriteRaw(const uint8_t* data, uint64_t size);
+
+    int fd;
+    bool compress;
+    uint64_t pos;
+    Stats& stats;
+    SeekableGzipWriter gz;
+};
+
+bool PipeOutput::Open(const char* path, bool gz_out) {
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    compress = gz_out;
+    return !compress || gz.Begin(fd);
+}
+
+static bool IsZero(const uint8_t* data, uint64_t size) {
+    return !data[0] && !memcmp(data, data + 1, size - 1);
+}
+
+bool PipeOutput::WriteRaw(const uint8_t* data, uint64_t size) {
+    while (size) {
+        uint64_t count = PAGE - pos % PAGE;
+        if (count > size)
+            count = size;
+
+        if (count == PAGE && IsZero(data, PAGE)) {
+            stats.holes++;
+        } else {
+            ssize_t rc = pwrite(fd, data, count, pos);
+            if (rc < 0 && errno == EINTR)
+                continue;
+            if (rc <= 0)
+                return false;
+            count = rc;
+            stats.written += count;
+        }
+        data += count;
+        size -= count;
+        pos += count;
+    }
+    return true;
+}
+
+bool PipeOutput::Write(const void* data, uint64_t size) {
+    if (!compress)
+        return WriteRaw((const uint8_t *)data, size);
+
+    if (!gz.Write(data, size))
+        return false;
+    pos += size;
+    stats.written += size;
+    return true;
+}
+
+bool PipeOutput::PadTo(uint64_t offset) {
+    static const uint8_t zero[PAGE] = {};
+    while (pos < offset) {
+        uint64_t count = offset - pos;
+        if (count > PAGE)
+            count = PAGE;
+        if (!Write(zero, count))
+            return false;
+    }
+    return true;
+}
+
+bool PipeOutput::Close() {
+    bool ok = true;
+    if (compress) {
+        ok = gz.Finish();
+        gz.End();
+    } else {
+        // trailing holes still count
+        ok = !ftruncate(fd, pos);
+    }
+    if (close(fd))
+        ok = false;
+    fd = -1;
+    return ok;
+}
+
+static void ParseMaps(int pid, std::vector<Vma>& maps) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE* fp = fopen(path, "re");
+    if (!fp) {
+        fprintf(stderr, "open %s: %s, using NT_FILE\n", path, strerror(errno));
+        return;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        Vma vma;
+        char file[512] = "";
+        int m, n;
+        if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %4c %" SCNx64 " %x:%x %" SCNu64 " %511[^\n]",
+                   &vma.begin, &vma.end, vma.flags, &vma.offset, &m, &n, &vma.inode, file) < 7)
+            continue;
+        vma.flags[4] = '\0';
+        vma.file = file;
+        maps.push_back(vma);
+    }
+    fclose(fp);
+}
+
+static Vma* FindVma(std::vector<Vma>& maps, uint64_t addr) {
+    int left = 0;
+    int right = (int)maps.size() - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        if (addr < maps[mid].begin)
+            right = mid - 1;
+        else if (addr >= maps[mid].end)
+            left = mid + 1;
+        else
+            return &maps[mid];
+    }
+    return nullptr;
+}
+
+template <class Ehdr, class Phdr, class Nhdr, class Word>
+class CorePipe {
+public:
+    CorePipe(int f, int p, Stats& s) : filter(f), pid(p), stats(s) {}
+    bool Run(PipeInput& in, PipeOutput& out, const uint8_t* ident);
+private:
+    void ParseNtFile(std::vector<uint8_t>& notes);
+    bool IsFilterSegment(Phdr& phdr);
+    bool NeedFilterFile(Vma& vma);
+
+    int filter;
+    int pid;
+    Stats& stats;
+    int machine;
+    std::vector<Vma> maps;
+};
+
+template <class Ehdr, class Phdr, class Nhdr, class Word>
+void CorePipe<Ehdr, Phdr, Nhdr, Word>::ParseNtFile(std::vector<uint8_t>& notes) {
+    uint64_t pos = 0;
+    while (pos + sizeof(Nhdr) <= notes.size()) {
+        Nhdr* nhdr = (Nhdr *)(notes.data() + pos);
+        uint64_t name = pos + sizeof(Nhdr);
+        uint64_t desc = name + ((nhdr->n_namesz + 3) & ~3ULL);
+        uint64_t next = desc + ((nhdr->n_descsz + 3) & ~3ULL);
+        if (next > notes.size())
+            break;
+
+        if (nhdr->n_type == NT_FILE && nhdr->n_descsz >= 2 * sizeof(Word)) {
+            Word* words = (Word *)(notes.data() + desc);
+            Word count = words[0];
+            Word page_size = words[1];
+            const char* names = (const char *)(words + 2 + count * 3);
+            const char* limit = (const char *)(notes.data() + desc + nhdr->n_descsz);
+            if (names > limit)
+                break;
+
+            for (Word i = 0; i < count && names < limit; ++i) {
+                Vma vma;
+                vma.begin = words[2 + i * 3];
+                vma.end = words[3 + i * 3];
+                vma.offset = words[4 + i * 3] * page_size;
+                // NT_FILE lists file backed ranges only, share flag is lost
+                memcpy(vma.flags, "r--p", sizeof(vma.flags));
+                vma.inode = 1;
+                vma.file = names;
+                names += vma.file.size() + 1;
+                maps.push_back(vma);
+            }
+            break;
+        }
+        pos = next;
+    }
+}
+
+template <class Ehdr, class Phdr, class Nhdr, class Word>
+bool CorePipe<Ehdr, Phdr, Nhdr, Word>::NeedFilterFile(Vma& vma) {
+    struct stat sb;
+    int fd = open(vma.file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return true;
+
+    if (fstat(fd, &sb) < 0 || sb.st_size < (off_t)sizeof(Ehdr)) {
+        close(fd);
+        return true;
+    }
+
+    char* mem = (char *)mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0x0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return true;
+
+    Ehdr* ehdr = (Ehdr *)mem;
+    if (strncmp(mem, ELFMAG, 4) || ehdr->e_machine != machine
+            || ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(Phdr) > (uint64_t)sb.st_size) {
+        munmap(mem, sb.st_size);
+        return true;
+    }
+
+    // writable parts of an elf carry relocated data, keep those
+    bool ret = true;
+    Phdr* phdr = (Phdr *)(mem + ehdr->e_phoff);
+    for (int index = 0; index < ehdr->e_phnum; index++) {
+        if (phdr[index].p_type != PT_LOAD)
+            continue;
+
+        uint64_t pos = phdr[index].p_offset & ~(PAGE - 1);
+        uint64_t end = pos + phdr[index].p_memsz;
+        if (pos <= vma.offset && vma.offset < end) {
+            if (phdr[index].p_flags & PF_W)
+                ret = false;
+        }
+    }
+
+    munmap(mem, sb.st_size);
+    return ret;
+}
+
+template <class Ehdr, class Phdr, class Nhdr, class Word>
+bool CorePipe<Ehdr, Phdr, Nhdr, Word>::IsFilterSegment(Phdr& phdr) {
+    Vma* vma = FindVma(maps, phdr.p_vaddr);
+    if (!vma) {
+        // anonymous when only NT_FILE is known
+        if (filter & FILTER_NON_READ_VMA)
+            return !(phdr.p_flags & (PF_R | PF_W | PF_X));
+        return false;
+    }
+
+    if (filter & FILTER_SPECIAL_VMA) {
+        if (vma->file == "/dev/binderfs/hwbinder"
+                || vma->file == "/dev/binderfs/binder"
+                || vma->file == "[vvar]"
+                || vma->file == "/dev/mali0")
+            return true;
+    }
+
+    if (filter & FILTER_FILE_VMA) {
+        bool writable = (phdr.p_flags & PF_W) || vma->flags[1] == 'w';
+        if (vma->inode > 0 && !writable)
+            return NeedFilterFile(*vma);
+    }
+
+    if (filter & FILTER_SHARED_VMA) {
+        if (vma->flags[3] == 's' || vma->flags[3] == 'S')
+            return true;
+    }
+
+    if (filter & FILTER_SANITIZER_SHADOW_VMA) {
+        if (vma->file == "[anon:low shadow]"
+                || vma->file == "[anon:high shadow]"
+                || vma->file.compare(0, 12, "[anon:hwasan") == 0)
+            return true;
+    }
+
+    if (filter & FILTER_NON_READ_VMA) {
+        if (!(phdr.p_flags & (PF_R | PF_W | PF_X)))
+            return true;
+    }
+
+    if (filter & FILTER_JAVAHEAP_VMA) {
+        if (vma->file.compare(0, 12, "[anon:dalvik") == 0)
+            return true;
+    }
+    return false;
+}
+
+template <class Ehdr, class Phdr, class Nhdr, class Word>
+bool CorePipe<Ehdr, Phdr, Nhdr, Word>::Run(PipeInput& in, PipeOutput& out,
+                                           const uint8_t* ident) {
+    std::vector<uint8_t> buffer(BUFFER_SIZE);
+    Ehdr ehdr;
+    memcpy(&ehdr, ident, EI_NIDENT);
+    if (!in.Read((uint8_t *)&ehdr + EI_NIDENT, sizeof(Ehdr) - EI_NIDENT))
+        return false;
+    machine = ehdr.e_machine;
+
+    // PN_XNUM puts the real count behind the data, nothing to filter by
+    if (ehdr.e_type != ET_CORE || ehdr.e_phnum == PN_XNUM
+            || ehdr.e_phentsize != sizeof(Phdr)) {
+        fprintf(stderr, "not a plain core, copy as is.\n");
+        if (!out.Write(&ehdr, sizeof(ehdr)))
+            return false;
+        int64_t count;
+        while ((count = in.ReadSome(buffer.data(), buffer.size())) > 0) {
+            if (!out.Write(buffer.data(), count))
+                return false;
+        }
+        return !count;
+    }
+
+    if (!in.SkipTo(ehdr.e_phoff, buffer))
+        return false;
+    std::vector<Phdr> phdr(ehdr.e_phnum);
+    if (!in.Read(phdr.data(), phdr.size() * sizeof(Phdr)))
+        return false;
+
+    // notes come before any load, kernel keeps them one segment
+    std::vector<uint8_t> notes;
+    Phdr* note = nullptr;
+    for (Phdr& p : phdr) {
+        if (p.p_type == PT_NOTE) {
+            note = &p;
+            break;
+        }
+    }
+    if (note) {
+        if (!in.SkipTo(note->p_offset, buffer))
+            return false;
+        notes.resize(note->p_filesz);
+        if (!in.Read(notes.data(), notes.size()))
+            return false;
+    }
+
+    if (pid > 0)
+        ParseMaps(pid, maps);
+    if (maps.empty())
+        ParseNtFile(notes);
+
+    // new layout first, nothing is written before all offsets are known
+    std::vector<Phdr> layout(phdr);
+    std::vector<bool> keep(phdr.size());
+    uint64_t offset = sizeof(Ehdr) + phdr.size() * sizeof(Phdr);
+    if (note) {
+        layout[note - phdr.data()].p_offset = offset;
+        offset += notes.size();
+    }
+    offset = (offset + PAGE - 1) & ~(PAGE - 1);
+    for (uint64_t i = 0; i < phdr.size(); ++i) {
+        if (phdr[i].p_type != PT_LOAD)
+            continue;
+
+        stats.segments++;
+        keep[i] = phdr[i].p_filesz && !(filter && IsFilterSegment(phdr[i]));
+        if (phdr[i].p_filesz && !keep[i]) {
+            stats.filtered++;
+            stats.dropped += phdr[i].p_filesz;
+            layout[i].p_filesz = 0;
+        }
+        layout[i].p_offset = offset;
+        offset += layout[i].p_filesz;
+    }
+
+    Ehdr head = ehdr;
+    head.e_phoff = sizeof(Ehdr);
+    head.e_shoff = 0;
+    head.e_shnum = 0;
+    head.e_shstrndx = 0;
+    if (!out.Write(&head, sizeof(head))
+            || !out.Write(layout.data(), layout.size() * sizeof(Phdr))
+            || !out.Write(notes.data(), notes.size()))
+        return false;
+
+    // kernel writes loads in phdr order, ascending offsets
+    for (uint64_t i = 0; i < phdr.size(); ++i) {
+        if (phdr[i].p_type != PT_LOAD || !phdr[i].p_filesz)
+            continue;
+
+        if (!in.SkipTo(phdr[i].p_offset, buffer))
+            return false;
+        if (keep[i] && !out.PadTo(layout[i].p_offset))
+            return false;
+
+        uint64_t left = phdr[i].p_filesz;
+        while (left) {
+            uint64_t count = left < BUFFER_SIZE ? left : BUFFER_SIZE;
+            if (!in.Read(buffer.data(), count))
+                return false;
+            if (keep[i] && !out.Write(buffer.data(), count))
+                return false;
+            left -= count;
+        }
+    }
+    // even the last segments may have been all dropped
+    return out.PadTo(offset);
+}
+
+typedef CorePipe<Elf32_Ehdr, Elf32_Phdr, Elf32_Nhdr, uint32_t> CorePipe32;
+typedef CorePipe<Elf64_Ehdr, Elf64_Phdr, Elf64_Nhdr, uint64_t> CorePipe64;
+
+int main(int argc, char** argv) {
+    std::string output;
+    bool compress = false;
+    int filter = FILTER_SPECIAL_VMA | FILTER_FILE_VMA | FILTER_SHARED_VMA
+            | FILTER_SANITIZER_SHADOW_VMA | FILTER_NON_READ_VMA;
+    int pid = 0;
+    int signal = 0;
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            output = argv[++i];
+        } else if (!strcmp(argv[i], "-z")) {
+            compress = true;
+        } else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            filter = strtol(argv[++i], nullptr, 0);
+        } else if (argv[i][0] == '-') {
+            Usage();
+            return 1;
+        } else if (positional++ == 0) {
+            pid = atoi(argv[i]);
+        } else {
+            signal = atoi(argv[i]);
+        }
+    }
+
+    if (output.empty()) {
+        Usage();
+        return 1;
+    }
+    if (compress && (output.size() < strlen(SeekableGzip::SUFFIX)
+            || output.compare(output.size() - strlen(SeekableGzip::SUFFIX),
+                              std::string::npos, SeekableGzip::SUFFIX)))
+        output += SeekableGzip::SUFFIX;
+    if (filter & ~FILTER_SUPPORTED)
+        fprintf(stderr, "filter 0x%x not supported on kernel cores, ignored.\n",
+                filter & ~FILTER_SUPPORTED);
+    filter &= FILTER_SUPPORTED;
+
+    Stats stats = {};
+    PipeInput in(STDIN_FILENO);
+    PipeOutput out(stats);
+    uint8_t ident[EI_NIDENT];
+    if (!in.Read(ident, sizeof(ident)) || memcmp(ident, ELFMAG, SELFMAG)) {
+        fprintf(stderr, "stdin is not an elf core.\n");
+        return 1;
+    }
+    if (!out.Open(output.c_str(), compress))
+        return 1;
+
+    bool ok;
+    if (ident[EI_CLASS] == ELFCLASS64)
+        ok = CorePipe64(filter, pid, stats).Run(in, out, ident);
+    else
+        ok = CorePipe32(filter, pid, stats).Run(in, out, ident);
+    ok = out.Close() && ok;
+
+    stats.read = in.Offset();
+    fprintf(stderr, "%s: pid %d signal %d, %d/%d segments filtered (%" PRIu64 " bytes), "
+            "%" PRIu64 " read, %" PRIu64 " written, %" PRIu64 " zero pages%s\n",
+            output.c_str(), pid, signal, stats.filtered, stats.segments, stats.dropped,
+            stats.read, stats.written, stats.holes, ok ? "" : ", truncated");
+    return ok ? 0 : 2;
+}
@@ -20,6 +20,7 @@ import android.os.Handler;
 import android.os.HandlerThread;
 import android.os.Looper;
 import android.os.Message;
+import android.os.ParcelFileDescriptor;
 import android.os.Process;
 import android.util.Log;
 
@@ -63,6 +64,30 @@ public class Coredump {
     public static final int FILTER_MINIDUMP = 1 << 6;
     public static final int FILTER_JAVAHEAP_VMA = 1 << 7;
     public static final int FILTER_JIT_CACHE_VMA = 1 << 8;
+    public static final int FILTER_MINIDUMP_WINDOW = 1 << 9;
+    public static final int FILTER_MINIDUMP_REACHABLE = 1 << 10;
+    public static final int FILTER_DEVICE_VMA = 1 << 11;
+    public static final int FILTER_NON_RESIDENT_VMA = 1 << 12;
+    public static final int FILTER_CLEAN_FILE_PAGE = 1 << 13;
+    public static final int FILTER_JIT_CACHE_PC = 1 << 14;
+
+    public static final int DEF_PAGE_WINDOW = 4;
+    public static final int DEF_REACH_DEPTH = 3;
+    public static final long DEF_REACH_BUDGET = 8 << 20;
+    public static final long DEF_SWAP_BUDGET = 32 << 20;
+
+    public static final int SWAP_INCLUDE = 0;
+    public static final int SWAP_SKIP = 1;
+    public static final int SWAP_BUDGET = 2;
+
+    public static final int REPEAT_FULL = 0;
+    public static final int REPEAT_MINIDUMP = 1;
+    public static final int REPEAT_SKIP = 2;
+
+    public static final int RULE_INCLUDE = 1;
+    public static final int RULE_EXCLUDE = 2;
+    public static final int RULE_STACK_TRIM = 3;
+    public static final int RULE_PAGE_WINDOW = 4;
 
     static {
         try {
@@ -158,6 +183,51 @@ public class Coredump {
         return waitCore();
     }
 
+    /**
+     * Write the core to a descriptor handed in by the caller instead of a
+     * file under the core dir. A regular file is written from offset 0,
+     * a pipe or socket gets a streamed core, laid out in file order with
+     * nothing rewritten afterwards. The reader must live in another process,
+     * every thread of this one is stopped while dumping. The descriptor
+     * stays owned by the caller.
+     */
+    public synchronized boolean doCoredump(ParcelFileDescriptor pfd) {
+        if (!isReady() || pfd == null)
+            return false;
+
+        mCondition &= ~COREDUMPED;
+        sendEvent(CODE_COREDUMP, pfd, mCoredumpWork);
+        return waitCore();
+    }
+
+    /**
+     * Dry run, stop the threads and compute the same layout a dump would,
+     * without writing anything. Returns a json with file size, per category
+     * (stack, java_heap, jit_cache, shared, file, anon) bytes, resident and
+     * swapped bytes, and the estimated dump time. measure times a short read
+     * of the selected pages instead of the default throughput. Incremental,
+     * baseline and working-set reductions are not predicted.
+     */
+    public String planCoredump(boolean measure) {
+        if (isReady()) {
+            return nativePlan(measure);
+        }
+        return null;
+    }
+
+    /**
+     * Numbers of the last finished dump as json, null before the first one:
+     * freeze_us (threads stopped), first_byte_us and total_us from the dump
+     * request, bytes and mb_per_s of the core, read and write syscalls,
+     * page faults and peak rss of the dumper process.
+     */
+    public String getLastDumpStats() {
+        if (isReady()) {
+            return nativeGetLastStats();
+        }
+        return null;
+    }
+
     private boolean waitCore() {
         try {
             synchronized (mLock) {
@@ -235,6 +305,59 @@ public class Coredump {
         }
     }
 
+    public void setCorePageWindow(int pages) {
+        if (isReady()) {
+            nativeSetPageWindow(pages);
+        }
+    }
+
+    public void setCoreReachDepth(int depth) {
+        if (isReady()) {
+            nativeSetReachDepth(depth);
+        }
+    }
+
+    public void setCoreReachBudget(long bytes) {
+        if (isReady()) {
+            nativeSetReachBudget(bytes);
+        }
+    }
+
+    public void setCoreReachRoots(String... libs) {
+        if (isReady()) {
+            StringBuilder sb = new StringBuilder();
+            if (libs != null) {
+                for (String lib : libs) {
+                    if (lib == null || lib.isEmpty())
+                        continue;
+                    if (sb.length() > 0) sb.append(',');
+                    sb.append(lib);
+                }
+            }
+            nativeSetReachRoots(sb.toString());
+        }
+    }
+
+    public boolean setCoreRules(Rule... rules) {
+        StringBuilder sb = new StringBuilder();
+        if (rules != null) {
+            for (Rule rule : rules) {
+                if (rule == null)
+                    continue;
+                sb.append(rule.toString());
+                sb.append('\n');
+            }
+        }
+        return setCoreRules(sb.toString());
+    }
+
+    public boolean setCoreRules(String rules) {
+        if (isReady()) {
+            return nativeSetRules(rules);
+        }
+        return false;
+    }
+
     public String getCoreDir() {
         if (isReady()) {
             return nativeGetDir();
@@ -263,6 +386,259 @@ public class Coredump {
         return FILTER_NONE;
     }
 
+    public int getCorePageWindow() {
+        if (isReady()) {
+            return nativeGetPageWindow();
+        }
+        return DEF_PAGE_WINDOW;
+    }
+
+    public int getCoreReachDepth() {
+        if (isReady()) {
+            return nativeGetReachDepth();
+        }
+        return DEF_REACH_DEPTH;
+    }
+
+    public long getCoreReachBudget() {
+        if (isReady()) {
+            return nativeGetReachBudget();
+        }
+        return DEF_REACH_BUDGET;
+    }
+
+    public String[] getCoreReachRoots() {
+        if (isReady()) {
+            String libs = nativeGetReachRoots();
+            if (libs != null && !libs.isEmpty())
+                return libs.split(",");
+        }
+        return new String[0];
+    }
+
+    /**
+     * SWAP_INCLUDE reads every page, swapped pages are faulted back in.
+     * SWAP_SKIP leaves swapped pages out, SWAP_BUDGET keeps them up to
+     * setCoreSwapBudget bytes. Skipped ranges are listed in an
+     * "OPENCORE" NT_OPENCORE_SWAP note.
+     */
+    public void setCoreSwapPolicy(int policy) {
+        if (isReady()) {
+            nativeSetSwapPolicy(policy);
+        }
+    }
+
+    public void setCoreSwapBudget(long bytes) {
+        if (isReady()) {
+            nativeSetSwapBudget(bytes);
+        }
+    }
+
+    public int getCoreSwapPolicy() {
+        if (isReady()) {
+            return nativeGetSwapPolicy();
+        }
+        return SWAP_INCLUDE;
+    }
+
+    public long getCoreSwapBudget() {
+        if (isReady()) {
+            return nativeGetSwapBudget();
+        }
+        return DEF_SWAP_BUDGET;
+    }
+
+    /**
+     * Store load segments in a page store shared by all dumps of the
+     * core dir, the core file then keeps only headers and notes.
+     * Rebuild a plain core on the host with tools/opencore-dedup.
+     */
+    public void setCoreDedup(boolean enable) {
+        if (isReady()) {
+            nativeSetDedup(enable);
+        }
+    }
+
+    public boolean isCoreDedup() {
+        if (isReady()) {
+            return nativeGetDedup();
+        }
+        return false;
+    }
+
+    /**
+     * The first dump after enabling is a full base core, later dumps keep
+     * only pages written since the previous one (soft-dirty), falling back
+     * to a full core when the kernel lacks CONFIG_MEM_SOFT_DIRTY or a core
+     * of the chain was removed. Rebuild on the host with tools/opencore-merge.
+     */
+    public void setCoreIncremental(boolean enable) {
+        if (isReady()) {
+            nativeSetIncremental(enable);
+        }
+    }
+
+    public boolean isCoreIncremental() {
+        if (isReady()) {
+            return nativeGetIncremental();
+        }
+        return false;
+    }
+
+    /**
+     * Leave out pages still mapped to the same frame as in process pid,
+     * e.g. the zygote (android.system.Os.getppid()). Those pages are taken
+     * from the separately captured baseline core, path relative to the
+     * core dir, when rebuilding on the host with tools/opencore-merge.
+     * Needs pagemap pfn (CAP_SYS_ADMIN), otherwise dumps stay full.
+     * pid 0 disables.
+     */
+    public void setCoreBaseline(int pid, String core) {
+        if (isReady()) {
+            nativeSetBaseline(pid, core);
+        }
+    }
+
+    public int getCoreBaselinePid() {
+        if (isReady()) {
+            return nativeGetBaselinePid();
+        }
+        return 0;
+    }
+
+    public String getCoreBaselineCore() {
+        if (isReady()) {
+            return nativeGetBaselineCore();
+        }
+        return "";
+    }
+
+    /**
+     * Working-set mode, let the process run ms milliseconds after the dump
+     * request and keep only pages it touched meanwhile: accessed pages with
+     * page_idle (root), else written pages with soft-dirty. Without either
+     * (soft-dirty is taken by incremental dumps) it only drops whole vmas
+     * smaps reports nothing referenced in, the rest is dumped in full. The
+     * per vma access histogram note is always written. The window counts
+     * into the timeout. 0 disables.
+     */
+    public void setCoreWorkingSet(int ms) {
+        if (isReady()) {
+            nativeSetWorkingSet(ms);
+        }
+    }
+
+    public int getCoreWorkingSet() {
+        if (isReady()) {
+            return nativeGetWorkingSet();
+        }
+        return 0;
+    }
+
+    /**
+     * What a native crash whose signature (signal, fault page, faulting
+     * module offset and the first return addresses on the stack) was seen
+     * before gets: REPEAT_FULL (default), REPEAT_MINIDUMP or REPEAT_SKIP.
+     * The history is kept in opencore.crashes of the core dir.
+     */
+    public void setCoreRepeatPolicy(int policy) {
+        if (isReady()) {
+            nativeSetRepeatPolicy(policy);
+        }
+    }
+
+    /**
+     * Crash dumps allowed per day, for one signature and for all of them.
+     * Crashes over either limit are not dumped. 0 is unlimited.
+     */
+    public void setCoreRateLimit(int perSignature, int global) {
+        if (isReady()) {
+            nativeSetRateLimit(perSignature, global);
+        }
+    }
+
+    public int getCoreRepeatPolicy() {
+        if (isReady()) {
+            return nativeGetRepeatPolicy();
+        }
+        return REPEAT_FULL;
+    }
+
+    public int getCoreSignatureLimit() {
+        if (isReady()) {
+            return nativeGetSignatureLimit();
+        }
+        return 0;
+    }
+
+    public int getCoreGlobalLimit() {
+        if (isReady()) {
+            return nativeGetGlobalLimit();
+        }
+        return 0;
+    }
+
+    /**
+     * Core dir retention, applied before every dump: cores older than
+     * maxAge seconds go first, then the oldest until maxFiles and quota
+     * bytes leave room for a new core the size of the newest one. With
+     * little of the quota left the dump is a minidump, with none it is
+     * skipped. 0 is unlimited.
+     */
+    public void setCoreRetention(long quota, int maxFiles, int maxAge) {
+        if (isReady()) {
+            nativeSetQuota(quota);
+            nativeSetMaxFiles(maxFiles);
+            nativeSetMaxAge(maxAge);
+        }
+    }
+
+    /**
+     * Gzip finished cores of the core dir on a low priority background
+     * thread, in seekable chunks that plain gunzip still reads. Runs on
+     * enable() and after each doCoredump().
+     */
+    public void setCoreCompact(boolean enable) {
+        if (isReady()) {
+            nativeSetCompact(enable);
+        }
+    }
+
+    public long getCoreQuota() {
+        if (isReady()) {
+            return nativeGetQuota();
+        }
+        return 0;
+    }
+
+    public int getCoreMaxFiles() {
+        if (isReady()) {
+            return nativeGetMaxFiles();
+        }
+        return 0;
+    }
+
+    public int getCoreMaxAge() {
+        if (isReady()) {
+            return nativeGetMaxAge();
+        }
+        return 0;
+    }
+
+    public boolean getCoreCompact() {
+        if (isReady()) {
+            return nativeGetCompact();
+        }
+        return false;
+    }
+
+    public String getCoreRules() {
+        if (isReady()) {
+            return nativeGetRules();
+        }
+        return "";
+    }
+
     public String getVersion() {
         if (isReady())
             return nativeVersion();
@@ -274,6 +650,7 @@ public class Coredump {
     private static native boolean nativeEnable();
     private static native boolean nativeDisable();
     private static native boolean nativeCoredump(int tid, String filename);
+    private static native boolean nativeCoredumpFd(int tid, int fd);
     private static native void nativeSetDir(String dir);
     private static native void nativeSetFlag(int flag);
     private static native void nativeSetTimeout(int sec);
@@ -283,6 +660,44 @@ public class Coredump {
     private static native int nativeGetFlag();
     private static native int nativeGetTimeout();
     private static native int nativeGetFilter();
+    private static native void nativeSetPageWindow(int pages);
+    private static native int nativeGetPageWindow();
+    private static native void nativeSetReachDepth(int depth);
+    private static native void nativeSetReachBudget(long bytes);
+    private static native void nativeSetReachRoots(String libs);
+    private static native int nativeGetReachDepth();
+    private static native long nativeGetReachBudget();
+    private static native String nativeGetReachRoots();
+    private static native boolean nativeSetRules(String rules);
+    private static native String nativeGetRules();
+    private static native void nativeSetSwapPolicy(int policy);
+    private static native void nativeSetSwapBudget(long bytes);
+    private static native int nativeGetSwapPolicy();
+    private static native long nativeGetSwapBudget();
+    private static native void nativeSetDedup(boolean enable);
+    private static native boolean nativeGetDedup();
+    private static native void nativeSetIncremental(boolean enable);
+    private static native boolean nativeGetIncremental();
+    private static native void nativeSetBaseline(int pid, String core);
+    private static native int nativeGetBaselinePid();
+    private static native String nativeGetBaselineCore();
+    private static native void nativeSetWorkingSet(int ms);
+    private static native int nativeGetWorkingSet();
+    private static native void nativeSetRepeatPolicy(int policy);
+    private static native void nativeSetRateLimit(int perSignature, int global);
+    private static native int nativeGetRepeatPolicy();
+    private static native int nativeGetSignatureLimit();
+    private static native int nativeGetGlobalLimit();
+    private static native void nativeSetQuota(long bytes);
+    private static native void nativeSetMaxFiles(int count);
+    private static native void nativeSetMaxAge(int sec);
+    private static native void nativeSetCompact(boolean enable);
+    private static native long nativeGetQuota();
+    private static native int nativeGetMaxFiles();
+    private static native int nativeGetMaxAge();
+    private static native boolean nativeGetCompact();
+    private static native String nativePlan(boolean measure);
+    private static native String nativeGetLastStats();
 
     private static final int CODE_COREDUMP = 1;
     private static final int CODE_COREDUMP_COMPLETED = 2;
@@ -299,6 +714,9 @@ public class Coredump {
                     if (isReady()) {
                         if (msg.obj instanceof String) {
                             Coredump.getInstance().nativeCoredump(msg.arg1, (String)msg.obj);
+                        } else if (msg.obj instanceof ParcelFileDescriptor) {
+                            int fd = ((ParcelFileDescriptor)msg.obj).getFd();
+                            Coredump.getInstance().nativeCoredumpFd(msg.arg1, fd);
                         } else {
                             Coredump.getInstance().nativeCoredump(msg.arg1, null);
                         }
@@ -331,8 +749,8 @@ public class Coredump {
         }
     }
 
-    private void sendEvent(int code, String filename, Handler handler) {
-        Message msg = Message.obtain(handler, code, Process.myTid(), 0, filename);
+    private void sendEvent(int code, Object obj, Handler handler) {
+        Message msg = Message.obtain(handler, code, Process.myTid(), 0, obj);
         msg.sendToTarget();
     }
 
@@ -382,6 +800,117 @@ public class Coredump {
         }
     }
 
+    /**
+     * Ordered vma policy rule, the first matched rule decides and
+     * unmatched vma fall back to the FILTER_* bits.
+     *
+     * exp:
+     *     new Coredump.Rule(Coredump.RULE_EXCLUDE).prefix("/dev/").shared()
+     */
+    public static class Rule {
+        private final int mAction;
+        private String mName;
+        private String mPrefix;
+        private String mPerms;
+        private long mMinSize = -1;
+        private long mMaxSize = -1;
+        private int mShared = -1;
+        private int mFileBacked = -1;
+
+        public Rule(int action) {
+            mAction = action;
+        }
+
+        /** glob on the vma name, '*' and '?' supported */
+        public Rule name(String glob) {
+            mName = checkValue(glob);
+            return this;
+        }
+
+        public Rule prefix(String prefix) {
+            mPrefix = checkValue(prefix);
+            return this;
+        }
+
+        /** up to 4 chars of /proc/pid/maps flags, '?' matches any */
+        public Rule perms(String perms) {
+            mPerms = checkValue(perms);
+            return this;
+        }
+
+        /** size range in bytes, a negative bound is unlimited */
+        public Rule size(long min, long max) {
+            mMinSize = min;
+            mMaxSize = max;
+            return this;
+        }
+
+        public Rule shared() {
+            mShared = 1;
+            return this;
+        }
+
+        public Rule notShared() {
+            mShared = 0;
+            return this;
+        }
+
+        public Rule file() {
+            mFileBacked = 1;
+            return this;
+        }
+
+        public Rule anon() {
+            mFileBacked = 0;
+            return this;
+        }
+
+        /**
+         * Values go out double quoted, so ';' and '#' stay part of them,
+         * the rule text has no escape for '"' itself.
+         */
+        private static String checkValue(String value) {
+            if (value != null && (value.indexOf('"') >= 0 || value.indexOf('\n') >= 0))
+                throw new IllegalArgumentException("rule value can't hold '\"' or a line break: " + value);
+            return value;
+        }
+
+        @Override
+        public String toString() {
+            StringBuilder sb = new StringBuilder();
+            switch (mAction) {
+                case RULE_INCLUDE: sb.append("include"); break;
+                case RULE_EXCLUDE: sb.append("exclude"); break;
+                case RULE_STACK_TRIM: sb.append("stack-trim"); break;
+                case RULE_PAGE_WINDOW: sb.append("page-window"); break;
+                default: sb.append("unknown"); break;
+            }
+
+            if (mName != null)
+                sb.append(" name=\"").append(mName).append('"');
+
+            if (mPrefix != null)
+                sb.append(" prefix=\"").append(mPrefix).append('"');
+
+            if (mPerms != null)
+                sb.append(" perms=\"").append(mPerms).append('"');
+
+            if (mMinSize >= 0 || mMaxSize >= 0) {
+                sb.append(" size=");
+                if (mMinSize >= 0) sb.append(mMinSize);
+                sb.append('-');
+                if (mMaxSize >= 0) sb.append(mMaxSize);
+            }
+
+            if (mShared >= 0)
+                sb.append(mShared > 0 ? " shared" : " private");
+
+            if (mFileBacked >= 0)
+                sb.append(mFileBacked > 0 ? " file" : " anon");
+            return sb.toString();
+        }
+    }
+
     public static String coreFlagToString(int flag) {
         StringBuilder sb = new StringBuilder();
         if (flag == 0) {
@@ -490,6 +1019,42 @@ public class Coredump {
             need_seq = true;
         }
 
+        if ((filter & FILTER_MINIDUMP_WINDOW) != 0) {
+            if (need_seq) sb.append('|');
+            sb.append("FILTER_MINIDUMP_WINDOW");
+            need_seq = true;
+        }
+
+        if ((filter & FILTER_MINIDUMP_REACHABLE) != 0) {
+            if (need_seq) sb.append('|');
+            sb.append("FILTER_MINIDUMP_REACHABLE");
+            need_seq = true;
+        }
+
+        if ((filter & FILTER_DEVICE_VMA) != 0) {
+            if (need_seq) sb.append('|');
+            sb.append("FILTER_DEVICE_VMA");
+            need_seq = true;
+        }
+
+        if ((filter & FILTER_NON_RESIDENT_VMA) != 0) {
+            if (need_seq) sb.append('|');
+            sb.append("FILTER_NON_RESIDENT_VMA");
+            need_seq = true;
+        }
+
+        if ((filter & FILTER_CLEAN_FILE_PAGE) != 0) {
+            if (need_seq) sb.append('|');
+            sb.append("FILTER_CLEAN_FILE_PAGE");
+            need_seq = true;
+        }
+
+        if ((filter & FILTER_JIT_CACHE_PC) != 0) {
+            if (need_seq) sb.append('|');
+            sb.append("FILTER_JIT_CACHE_PC");
+            need_seq = true;
+        }
+
         return sb.toString();
     }
 